@@ -0,0 +1,316 @@
+/*
+ * Bench:
+ * Microbenchmarks for the EV core functions, compared against a plain array.
+ *
+ * Each public operation is timed across a range of slot sizes and vector
+ * sizes. Results are written to stdout as JSON lines (one JSON object per
+ * line) so that runs can be diffed between versions. Build with EV_PEDANTIC
+ * set to 0 or 1 to compare the cost of pedantic checking. eg.
+ *
+ * ./bench 1000000 > bench_output.txt
+ *
+ * Usage: bench [max_count]
+ *  max_count:   The largest vector size to run (default 1000000). Sizes go
+ *               from 10 up to 100M in powers of 10.
+ *
+ * The latency of every single push is also measured at max_count, with and
+ * without incremental growth (see evinc()), and reported as a histogram with
+ * power of 2 buckets, to show the worst case cost of growing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define EV_FALL
+#include "evec.h"
+
+#define SLOT_MAX 256
+static const size_t slot_sizes[] = { 4, 16, 64, 256 };
+static const size_t counts[] = { 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+#define NUM(a) (sizeof(a) / sizeof(a[0]))
+
+//Run each measurement over at least this many operations, to smooth out noise
+#define MIN_OPS 1000000
+
+//Delete is O(n) per op, so only delete this many items from the front
+#define DEL_OPS 100
+
+//Copy at most this many bytes per push when growing incrementally
+#define INC_BYTES 4096
+
+//Latency histogram buckets, bucket b counts pushes that took < 2^b ns
+#define LAT_BUCKETS 40
+
+static volatile uint64_t sink; //Keep the compiler from optimising loops away
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char* op, const char* impl, size_t slt_size, size_t count,
+                   uint64_t ns, uint64_t ops)
+{
+    printf("{\"op\": \"%s\", \"impl\": \"%s\", \"pedantic\": %i, \"slot\": %zu, \"count\": %zu, "
+           "\"ops\": %" PRIu64 ", \"ns\": %" PRIu64 ", \"ns_per_op\": %.3f}\n",
+           op, impl, EV_PEDANTIC, slt_size, count, ops, ns, (double)ns / ops);
+}
+
+static int compare(const void* lhs, const void* rhs)
+{
+    const uint32_t a = *(const uint32_t*)lhs;
+    const uint32_t b = *(const uint32_t*)rhs;
+    return (a > b) - (a < b);
+}
+
+/*
+ * Plain array baseline, grown the same way as EV.
+ */
+typedef struct {
+    char* data;
+    size_t count;
+    size_t slots;
+} raw_t;
+
+static void raw_push(raw_t* r, const void* obj, size_t slt_size)
+{
+    if(r->count == r->slots){
+        r->slots = r->slots ? r->slots * EV_GROWTH_FACTOR : EV_INIT_COUNT;
+        r->data  = realloc(r->data, r->slots * slt_size);
+        if(!r->data){
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    memcpy(r->data + r->count * slt_size, obj, slt_size);
+    r->count++;
+}
+
+static void bench_evec(size_t slt_size, size_t count)
+{
+    const uint64_t reps = count >= MIN_OPS ? 1 : MIN_OPS / count;
+    char obj[SLOT_MAX] = {0};
+    uint64_t start, sum = 0;
+
+    //Push
+    void* v = NULL;
+    start = now_ns();
+    for(uint64_t r = 0; r < reps; r++){
+        v = evfree(v);
+        v = evini(slt_size, 0);
+        for(size_t i = 0; i < count; i++){
+            *(uint32_t*)obj = rand();
+            v = evpush(v, obj, slt_size);
+        }
+    }
+    report("push", "evec", slt_size, count, now_ns() - start, reps * count);
+
+    //Index
+    start = now_ns();
+    for(uint64_t r = 0; r < reps; r++){
+        for(size_t i = 0; i < count; i++){
+            sum += *(uint32_t*)evidx(v, i);
+        }
+    }
+    report("index", "evec", slt_size, count, now_ns() - start, reps * count);
+
+    //Iterate
+    start = now_ns();
+    for(uint64_t r = 0; r < reps; r++){
+        for(char* vi = evhead(v); vi; vi = evnext(v)){
+            sum += *(uint32_t*)vi;
+        }
+    }
+    report("iterate", "evec", slt_size, count, now_ns() - start, reps * count);
+
+    //Sum, with the numeric kernels
+    if(slt_size == sizeof(int32_t)){
+        start = now_ns();
+        for(uint64_t r = 0; r < reps; r++){
+            sum += evsum_i32(v);
+        }
+        report("sum", "evec", slt_size, count, now_ns() - start, reps * count);
+    }
+
+    //Copy
+    start = now_ns();
+    for(uint64_t r = 0; r < reps; r++){
+        void* c = evcpy(v);
+        sum += *(uint32_t*)c;
+        evfree(c);
+    }
+    report("copy", "evec", slt_size, count, now_ns() - start, reps);
+
+    //Sort
+    start = now_ns();
+    evsort(v, compare);
+    report("sort", "evec", slt_size, count, now_ns() - start, 1);
+
+    //Delete from the front, the worst case
+    const size_t dels = count < DEL_OPS ? count : DEL_OPS;
+    start = now_ns();
+    for(size_t i = 0; i < dels; i++){
+        evdel(v, 0);
+    }
+    report("delete", "evec", slt_size, count, now_ns() - start, dels);
+
+    evfree(v);
+    sink += sum;
+}
+
+static void report_latency(const char* impl, size_t slt_size, size_t count,
+                           const uint64_t* hist, uint64_t max_ns)
+{
+    //Percentiles are given as the upper bound of the bucket they land in
+    const double pcts[] = { 0.5, 0.99, 0.999, 0.9999 };
+    uint64_t pct_ns[NUM(pcts)] = {0};
+    uint64_t seen = 0;
+    for(size_t b = 0, p = 0; b < LAT_BUCKETS && p < NUM(pcts); b++){
+        seen += hist[b];
+        while(p < NUM(pcts) && seen >= pcts[p] * count){
+            pct_ns[p++] = 1ULL << b;
+        }
+    }
+
+    size_t top = LAT_BUCKETS;
+    while(top > 1 && !hist[top - 1]){
+        top--;
+    }
+
+    printf("{\"op\": \"push_latency\", \"impl\": \"%s\", \"pedantic\": %i, \"slot\": %zu, \"count\": %zu, "
+           "\"p50_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64 ", \"p999_ns\": %" PRIu64 ", \"p9999_ns\": %" PRIu64 ", "
+           "\"max_ns\": %" PRIu64 ", \"hist\": [",
+           impl, EV_PEDANTIC, slt_size, count, pct_ns[0], pct_ns[1], pct_ns[2], pct_ns[3], max_ns);
+    for(size_t b = 0; b < top; b++){
+        printf("%s%" PRIu64, b ? ", " : "", hist[b]);
+    }
+    printf("]}\n");
+}
+
+static void bench_latency(size_t slt_size, size_t count, size_t inc_bytes)
+{
+    char obj[SLOT_MAX] = {0};
+    uint64_t hist[LAT_BUCKETS] = {0};
+    uint64_t max_ns = 0;
+
+    void* v = evini(slt_size, 0);
+    evinc(v, inc_bytes);
+    for(size_t i = 0; i < count; i++){
+        *(uint32_t*)obj = i;
+        const uint64_t start = now_ns();
+        v = evpush(v, obj, slt_size);
+        const uint64_t ns = now_ns() - start;
+
+        size_t b = 0;
+        while(b < LAT_BUCKETS - 1 && (1ULL << b) <= ns){
+            b++;
+        }
+        hist[b]++;
+        max_ns = ns > max_ns ? ns : max_ns;
+    }
+    evfree(v);
+
+    report_latency(inc_bytes ? "evec_inc" : "evec", slt_size, count, hist, max_ns);
+}
+
+static void bench_raw(size_t slt_size, size_t count)
+{
+    const uint64_t reps = count >= MIN_OPS ? 1 : MIN_OPS / count;
+    char obj[SLOT_MAX] = {0};
+    uint64_t start, sum = 0;
+
+    //Push
+    raw_t v = {0};
+    start = now_ns();
+    for(uint64_t r = 0; r < reps; r++){
+        free(v.data);
+        v = (raw_t){0};
+        for(size_t i = 0; i < count; i++){
+            *(uint32_t*)obj = rand();
+            raw_push(&v, obj, slt_size);
+        }
+    }
+    report("push", "raw", slt_size, count, now_ns() - start, reps * count);
+
+    //Index
+    start = now_ns();
+    for(uint64_t r = 0; r < reps; r++){
+        for(size_t i = 0; i < count; i++){
+            sum += *(uint32_t*)(v.data + i * slt_size);
+        }
+    }
+    report("index", "raw", slt_size, count, now_ns() - start, reps * count);
+
+    //Iterate
+    start = now_ns();
+    for(uint64_t r = 0; r < reps; r++){
+        for(char* vi = v.data; vi < v.data + v.count * slt_size; vi += slt_size){
+            sum += *(uint32_t*)vi;
+        }
+    }
+    report("iterate", "raw", slt_size, count, now_ns() - start, reps * count);
+
+    //Sum
+    if(slt_size == sizeof(int32_t)){
+        start = now_ns();
+        for(uint64_t r = 0; r < reps; r++){
+            int64_t total = 0;
+            for(size_t i = 0; i < v.count; i++){
+                total += ((int32_t*)v.data)[i];
+            }
+            sum += total;
+        }
+        report("sum", "raw", slt_size, count, now_ns() - start, reps * count);
+    }
+
+    //Copy
+    start = now_ns();
+    for(uint64_t r = 0; r < reps; r++){
+        char* c = malloc(v.slots * slt_size);
+        memcpy(c, v.data, v.count * slt_size);
+        sum += *(uint32_t*)c;
+        free(c);
+    }
+    report("copy", "raw", slt_size, count, now_ns() - start, reps);
+
+    //Sort
+    start = now_ns();
+    qsort(v.data, v.count, slt_size, compare);
+    report("sort", "raw", slt_size, count, now_ns() - start, 1);
+
+    //Delete from the front, the worst case
+    const size_t dels = count < DEL_OPS ? count : DEL_OPS;
+    start = now_ns();
+    for(size_t i = 0; i < dels; i++){
+        memmove(v.data, v.data + slt_size, (v.count - 1) * slt_size);
+        v.count--;
+    }
+    report("delete", "raw", slt_size, count, now_ns() - start, dels);
+
+    free(v.data);
+    sink += sum;
+}
+
+int main(int argc, char** argv)
+{
+    const size_t max_count = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+
+    for(size_t c = 0; c < NUM(counts) && counts[c] <= max_count; c++){
+        for(size_t s = 0; s < NUM(slot_sizes); s++){
+            srand(c);
+            bench_raw(slot_sizes[s], counts[c]);
+            srand(c);
+            bench_evec(slot_sizes[s], counts[c]);
+        }
+    }
+
+    for(size_t s = 0; s < NUM(slot_sizes); s++){
+        bench_latency(slot_sizes[s], max_count, 0);
+        bench_latency(slot_sizes[s], max_count, INC_BYTES);
+    }
+
+    return 0;
+}
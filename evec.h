@@ -49,6 +49,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 #include <inttypes.h>
@@ -57,6 +58,10 @@
 #include <libgen.h>
 #include <unistd.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*
  * Build Time Parameters
  * ===========================================================================
@@ -83,10 +88,171 @@
 #define EV_DEBUG 0 //If this is set, debug printing is enabled
 #endif
 
+#ifndef EV_STATS
+#define EV_STATS 0 //If this is set, vectors keep runtime statistics
+#endif
+
+#ifndef EV_TRACE
+#define EV_TRACE 0 //If this is set, vectors remember the call site that made them
+#endif
+
+//Both statistics and tracing need to find every live vector
+#define EV_REGISTRY (EV_STATS || EV_TRACE)
+
+#ifndef EV_COMPACT
+#define EV_COMPACT 0 //If this is set, vectors have a 16 byte header (see below)
+#endif
+
+#if EV_COMPACT
+//Compact headers have no room for anything but the counts and the flags
+#if defined EV_FALL || defined EV_FGROW || defined EV_FALIGN || defined EV_FINCR || \
+    defined EV_FNUMA || defined EV_FHUGE || defined EV_FBITS || defined EV_FSHM
+#error "EV_COMPACT cannot be used with EV_FALL, EV_FGROW, EV_FALIGN, EV_FINCR, EV_FNUMA, EV_FHUGE, EV_FBITS or EV_FSHM"
+#endif
+#if EV_REGISTRY
+#error "EV_COMPACT cannot be used with EV_STATS or EV_TRACE"
+#endif
+#endif
+
 #define EV_MAJOR 1
 #define EV_MINOR 3
 #define EV_RELEASE 0 //If release is 1, this is an offical release version
 
+/*
+ * Vector header layout
+ * ===========================================================================
+ * The header lives immediately before the first slot of the vector. It is
+ * visible outside of the implementation so that callers can size buffers for
+ * vectors that live in their own storage (see evinibuf()).
+ */
+
+//Round up to the strictest alignment that malloc() gives us, so that the slots
+//are as well aligned as a plain malloc() block would be.
+typedef max_align_t align;
+#ifdef __cplusplus
+#define EV_ALIGNOF(t) alignof(t)
+#else
+#define EV_ALIGNOF(t) _Alignof(t)
+#endif
+#define EV_HDR_BYTES (( (sizeof(evhd_t) + EV_ALIGNOF(align) - 1) / EV_ALIGNOF(align)) * EV_ALIGNOF(align))
+#define EV_HDR(v) ((evhd_t*)( ((char*)v) - EV_HDR_BYTES ))
+
+//Round sz up to the next multiple of a
+#define EV_ALIGN_UP(sz, a) ((((sz) + (a) - 1) / (a)) * (a))
+#define EV_VER 1.1
+
+/*
+ * Magic values are included so that it's easy to spot the memory segment in
+ * a hexdump, and to protect from any violations that might happen by accident
+ */
+#define EV_MAGIC1 "EVMAGIC"
+#define EV_MAGIC2 "MAGICEV"
+#define EV_MAGIC_COMPACT 0x7645 //"Ev" in a little endian hexdump, see EV_COMPACT
+
+/*
+ * Runtime statistics kept for each vector, and in total for all vectors.
+ * Only filled in when EV_STATS is set.
+ */
+typedef struct {
+    int64_t pushes;     //Number of items pushed
+    int64_t grows;      //Number of times the storage has grown
+    int64_t copy_bytes; //Bytes copied when growing moved the storage
+    int64_t del_bytes;  //Bytes shifted down when deleting items
+    int64_t peak_objs;  //Largest number of items held at once
+    int64_t peak_slots; //Largest number of slots allocated at once
+} evstats_t;
+
+struct evhd;
+
+/*
+ * Per feature state for a vector. Every field is always declared, the EV_F*
+ * macros only decide which code uses them. Caller owned (inline) and shared
+ * memory vectors only get one if a policy is set on them.
+ */
+typedef struct evext {
+    double grw_factor;    //Grow by this factor when space runs out
+    int64_t grw_limit;    //Above this many slots grow by grw_step instead
+    int64_t grw_step;
+    int64_t align;        //Slots start on a multiple of this (0 for default)
+    int64_t base_off;     //Offset of the header from the start of the allocation
+    int64_t inc_bytes;    //Copy at most this many bytes per push when growing (0 for off)
+    struct evhd* inc_hdr; //Storage being grown into, or NULL
+    int64_t inc_slt_count;//Slots in the storage being grown into
+    int64_t inc_split;    //Items from here on are copied to it as they change
+    int64_t inc_moved;    //Items below here have been copied to it, and are too
+    int64_t inc_base_off; //base_off and map_bytes of the storage being grown into
+    int64_t inc_map_bytes;
+    int64_t numa_policy;  //EV_NUMA_DEFAULT, EV_NUMA_INTERLEAVE or EV_NUMA_BIND
+    int64_t numa_node;    //Node to bind to for EV_NUMA_BIND
+    int64_t hp_limit;     //Map storage at least this big with huge pages (0 for off)
+    int64_t map_bytes;    //Length of the mapping holding the storage, or 0 if malloc()'d
+    int64_t bit_count;    //Number of bits held, if this is a bit vector
+    evstats_t stats;      //See EV_STATS
+    const char* tr_file;  //Call site that made the vector, see EV_TRACE
+    int64_t tr_line;
+    int64_t tr_grows;
+    struct evhd* st_hdr;  //Registry of live vectors, see EV_STATS and EV_TRACE
+    struct evext* st_prev;
+    struct evext* st_next;
+} evext_t;
+
+#if EV_COMPACT
+/*
+ * The compact header is 16 bytes, for programs with millions of tiny vectors
+ * where the full header would cost more than the items. The counts are 32
+ * bits, and the storage of each vector is limited to EV_COMPACT_MAX bytes.
+ * There is one short magic value, right next to the first slot, and no room
+ * for the evnext() iterator. See evlayout().
+ */
+#define EV_COMPACT_MAX INT32_MAX
+
+typedef struct evhd {
+    int32_t slt_size;
+    int32_t obj_count;
+    int32_t slt_count;
+    uint16_t flags;
+    uint16_t magic;
+} evhd_t;
+#else
+/*
+ * The full header has the same layout whichever EV_F* features are compiled
+ * in, so that code built with different options agrees on where the slots
+ * are. Anything a feature needs to remember about a vector lives in the
+ * extension block (evext_t) above, which is allocated the first time it is needed.
+ */
+typedef struct evhd {
+    char magic1[8];
+    int64_t slt_size;
+    int64_t obj_count;
+    int64_t slt_count;
+    int64_t index;
+    int64_t flags;
+    struct evext* ext;  //Per feature state, or NULL if no feature has been used
+    char magic2[8];
+} evhd_t;
+#endif
+
+//Read a field of the extension block, or 0 if the vector does not have one
+#if EV_COMPACT
+#define EV_EXTGET(hdr, field) 0
+#else
+#define EV_EXTGET(hdr, field) ((hdr)->ext ? (hdr)->ext->field : 0)
+#endif
+#define EV_BASE(hdr) ((char*)(hdr) - EV_EXTGET(hdr, base_off))
+#define EV_ALIGN(hdr) ((size_t)EV_EXTGET(hdr, align))
+
+/*
+ * Header flags
+ */
+#define EV_FLAG_INLINE (1 << 0) //Storage is owned by the caller, never free() it
+#define EV_FLAG_GRW_PAGE (1 << 1) //Round growth up to a whole number of pages
+#define EV_FLAG_GRW_USABLE (1 << 2) //Claim any slack the allocator hands back
+#define EV_FLAG_HUGETLB (1 << 3) //Try explicit (MAP_HUGETLB) huge pages first
+#define EV_FLAG_SHM (1 << 4) //Storage is a shared memory segment, see evshini()
+#define EV_FLAG_RCU (1 << 5) //Storage may be seen by readers of an epoch vector, see evrcini()
+#define EV_FLAG_HEAP4 (1 << 6) //Heap items have 4 children rather than 2, see evheap_arity()
+
+
 /*
  * Forward declarations of the the EV interface functions
  * ===========================================================================
@@ -124,6 +290,39 @@
 void* evini(size_t slt_size, size_t count);
 
 
+#ifndef EV_CACHE_LINE
+#define EV_CACHE_LINE 64 //Cache line size in bytes
+#endif
+
+#if defined EV_FALIGN || defined EV_FALL
+
+/**
+ * Allocate a new vector and initialize it, so that the first slot starts on a
+ * multiple of alignment bytes (eg. EV_CACHE_LINE, or 64 for AVX-512). The
+ * alignment is kept when the vector grows and when it is copied with evcpy().
+ * slt_size:    The size of each slot in the vector typically the size of
+ *              the type that is being stored.
+ * count:       The number of initial elements (of size slt_size) to be
+ *              allocated.
+ * alignment:   The alignment of the first slot in bytes. Must be a power of 2.
+ * return:      A pointer to the memory region, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evini_aligned(size_t slt_size, size_t count, size_t alignment);
+
+
+/**
+ * As evini_aligned(), but also round the slot size up to a multiple of
+ * alignment so that every slot is aligned, not just the first one.
+ *
+ * **Note** the slots are then larger than the type stored in them, so use
+ * evidx() rather than array notation to access them.
+ */
+#define evini_aligned_slots(slt_size, count, alignment) \
+    evini_aligned(EV_ALIGN_UP(slt_size, alignment), count, alignment)
+#endif
+
+
 /**
  * Easy push a new value onto the tail of a vector. If the vector is NULL,
  * memory will be automatically allocated for INIT_COUNT elements, based on the
@@ -149,7 +348,7 @@ void* evini(size_t slt_size, size_t count);
 #ifdef __GNUC__
 #define evpsh(vec, obj) do { \
          __extension__ __typeof__(obj) __OBJ__ = obj; \
-         vec = evpush(vec, &__OBJ__, sizeof(__OBJ__)); \
+         vec = (__typeof__(vec))evpush(vec, &__OBJ__, sizeof(__OBJ__)); \
      }while(0)
 #else
 #define evpsh(vec, obj) do { \
@@ -175,6 +374,18 @@ void* evini(size_t slt_size, size_t count);
  */
 void* evpush(void* vec, void* obj, size_t obj_size);
 
+
+/**
+ * Make sure that the vector has room for at least count items, growing the
+ * storage at most once. If the vector has to grow, it grows to count slots, or
+ * by its growth policy if that gives more.
+ * vec:         Pointer to the vector
+ * count:       The number of slots needed
+ * return:      A pointer to the vector, which may have moved, or NULL
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evrsv(void* vec, size_t count);
+
 /**
  * Macro to help iterate over each element of the vector, putting a pointer to
  * the element in var.
@@ -189,8 +400,14 @@ void* evpush(void* vec, void* obj, size_t obj_size);
  * return:      A pointer to the memory region, or NULL.
  * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
  */
+#if EV_COMPACT
+//Compact headers have no iterator, so step through the slots directly
+#define eveach(vec,ivar) \
+    for(typeof(vec) ivar = evhead(vec); ivar && ivar < (vec) + evcnt(vec); ivar++)
+#else
 #define eveach(vec,ivar) \
     for(typeof(vec) ivar = evhead(vec); ivar; ivar = evnext(vec))
+#endif
 
 
 /**
@@ -216,11 +433,15 @@ void* evhead(void* vec);
  * A vector operation (such as `evpsh()`) may cause a memory reallocation which
  * can make this pointer undefined.
  *
+ * Not available with EV_COMPACT, which has no room for the iterator.
+ *
  * vec:         Pointer to the vector
  * return:      A pointer to next slot in the vector, or NULL
  * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
  */
+#if !EV_COMPACT
 void* evnext(void* vec);
+#endif
 
 
 
@@ -247,6 +468,19 @@ void* evtail(void* vec);
 size_t evcnt(void* vec);
 
 
+#define EV_LAYOUT_FULL    1 //The default header, see evhd_t
+#define EV_LAYOUT_COMPACT 2 //The 16 byte header of an EV_COMPACT build
+
+/**
+ * Find out which header layout a vector has. This looks for the magic values
+ * of both layouts, so it also spots vectors made by code that was built with
+ * a different EV_COMPACT setting, which the other functions cannot use.
+ * vec:         Pointer to the vector
+ * return:      EV_LAYOUT_FULL, EV_LAYOUT_COMPACT, or -1 if neither is found
+ */
+int evlayout(void* vec);
+
+
 /**
  * Return a the pointer to the slot at a given index
  *
@@ -272,6 +506,176 @@ void* evidx(void* vec, size_t idx);
 void* evfree(void* vec);
 
 
+/**
+ * Number of bytes of caller supplied storage needed to hold a vector header
+ * and count slots of slt_size bytes each.
+ */
+#define EV_BUF_BYTES(slt_size, count) (EV_HDR_BYTES + (slt_size) * (count))
+
+
+/**
+ * Easy allocate a new vector of count slots, based on type information, in
+ * storage local to the enclosing block (ie. on the stack). No memory is
+ * allocated until the vector grows beyond count items, at which point it is
+ * transparently moved to the heap.
+ *
+ * **Note** the storage only lives as long as the enclosing block. Do not use
+ * the vector outside of the block it was created in.
+ *
+ * type:        A fully specified C type.
+ * count:       The number of slots to keep in local storage.
+ * return:      A pointer to the memory region, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+#if defined EV_FBUF || defined EV_FALL
+#define evinistk(type, count) \
+    evinibuf((align[(EV_BUF_BYTES(sizeof(type), count) + sizeof(align) - 1) / sizeof(align)]){{0}}, \
+             EV_BUF_BYTES(sizeof(type), count), sizeof(type))
+
+
+/**
+ * Initialise a new vector in caller supplied storage (eg. a stack or static
+ * buffer). The vector uses as many slots as fit in the buffer. No memory is
+ * allocated until the vector grows beyond that, at which point it is
+ * transparently moved to the heap. evfree() will never free() the buffer.
+ * Setting a policy on the vector (eg. evgrw()) allocates a small block to
+ * hold it, so in that case the vector must be freed with evfree().
+ * buf:         Pointer to the storage. Must be aligned at least as well as
+ *              malloc() would align it.
+ * buf_bytes:   The size of the storage, see EV_BUF_BYTES().
+ * slt_size:    The size of each slot in the vector typically the size of
+ *              the type that is being stored.
+ * return:      A pointer to the memory region, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evinibuf(void* buf, size_t buf_bytes, size_t slt_size);
+#endif
+
+
+#if defined EV_FADOPT || defined EV_FALL
+/**
+ * The items of a buffer that is to be adopted with evadopt(). A buffer of
+ * EV_BUF_BYTES(slt_size, capacity) bytes leaves room in front of the items
+ * for the vector header, so that the vector can be made without a copy. eg.
+ *
+ * char* buf = malloc(EV_BUF_BYTES(sizeof(int), 1024));
+ * size_t n = read(fd, EV_ADOPT_ITEMS(buf), 1024 * sizeof(int)) / sizeof(int);
+ * int* vec = evadopt(buf, sizeof(int), n, 1024);
+ */
+#define EV_ADOPT_ITEMS(buf) ((void*)((char*)(buf) + EV_HDR_BYTES))
+
+
+/**
+ * Make a vector out of a heap buffer without copying the items. The vector
+ * takes ownership of the buffer, which is realloc()'d as it grows, and
+ * free()'d by evfree(). The items must already be at EV_ADOPT_ITEMS(buf), and
+ * the header is written into the room in front of them.
+ * buf:         Pointer to a block from malloc(), calloc() or realloc(), of at
+ *              least EV_BUF_BYTES(slt_size, capacity) bytes.
+ * slt_size:    The size of each item.
+ * count:       The number of items already in the buffer.
+ * capacity:    The number of items the buffer has room for, at least count.
+ * return:      A pointer to the vector, or NULL, in which case the caller
+ *              still owns the buffer.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evadopt(void* buf, size_t slt_size, size_t count, size_t capacity);
+
+
+/**
+ * Take the items out of a vector as a plain heap block that can be passed to
+ * free(). The items slide down over the header to the start of the block, so
+ * nothing is allocated or freed. The vector is gone afterwards. Vectors in
+ * caller supplied storage are copied into a new block.
+ * vec:         Pointer to the vector. Cannot be in huge pages, shared memory,
+ *              or an epoch vector.
+ * return:      A pointer to the items, to be free()'d by the caller, or NULL.
+ *              There are evcnt(vec) items, read it before the call.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evrelease(void* vec);
+#endif
+
+
+/**
+ * Set the growth policy of a vector. By default vectors grow by
+ * EV_GROWTH_FACTOR each time they run out of slots. The policy is kept with
+ * the vector, so different vectors can grow in different ways.
+ * vec:         Pointer to the vector
+ * factor:      Grow by this factor when space runs out. Must be > 1.0.
+ * limit:       Once the vector has this many slots, grow by a fixed number of
+ *              slots (step) instead. 0 means always grow by factor.
+ * step:        The number of slots to add once above limit.
+ * flags:       EV_FLAG_GRW_PAGE to round growth up to a whole number of pages.
+ *              EV_FLAG_GRW_USABLE to use any extra space the allocator
+ *              returned (see malloc_usable_size()).
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+#if defined EV_FGROW || defined EV_FALL
+void evgrw(void* vec, double factor, size_t limit, size_t step, int64_t flags);
+
+/**
+ * Find how many slots the vector will have after it next grows, by its growth
+ * policy (see evgrw()). With EV_FLAG_GRW_USABLE, the allocator may give it a
+ * few more. Use this to size new storage when moving the items by hand.
+ * vec:         Pointer to the vector
+ * return:      The slot count, or 0 on failure.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evgrwslts(void* vec);
+#endif
+
+/**
+ * Give a vector the same policies as another: growth (evgrw()), incremental
+ * growth (evinc()), NUMA placement (evnuma()), huge pages (evhuge()) and heap
+ * arity (evheap_arity()). Use this when moving the items of a vector into new
+ * storage by hand. A NUMA policy also moves the pages dst already has, and
+ * EV_FLAG_GRW_USABLE lets dst use any slack in its allocation.
+ * dst:         Pointer to the vector to change
+ * src:         Pointer to the vector to copy the policies from
+ * return:      0 on success, -1 if there is no memory for them.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int evpolicy(void* dst, void* src);
+
+
+#if defined EV_FINCR || defined EV_FALL
+/**
+ * Turn on incremental growth. The new storage is allocated a little before the
+ * vector runs out of space, and each push from then on copies a few items
+ * across, so that no single push copies much more than max_bytes. The items
+ * stay where they are until the push that finds the old storage full, which
+ * copies whatever is left and hands over. The vector pointer changes then, so
+ * always use `vec = evpush(vec, ...)`.
+ *
+ * Array notation (eg. `vec[i]`) and evidx() work as normal throughout, as do
+ * the functions that change items in place. **Note** items changed through
+ * array notation or evidx() pointers while the vector is growing may have
+ * been copied already, so call evincfin() first. With EV_PEDANTIC, the hand
+ * over checks for this, which reads every item. If the growth step (see
+ * evgrw()) leaves too few new slots to copy every item within max_bytes per
+ * push, the vector grows by more than the step.
+ *
+ * vec:         Pointer to the vector
+ * max_bytes:   The most bytes to copy in one push. 0 turns incremental growth
+ *              off.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evinc(void* vec, size_t max_bytes);
+
+/**
+ * Finish any incremental growth that is in progress, by copying all of the
+ * remaining items into the new storage.
+ * vec:         Pointer to the vector
+ * return:      A pointer to the vector, which may have moved, or NULL
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evincfin(void* vec);
+#endif
+
+
 /**
  * Remove the last value from the vector tail.
  * vec:         Pointer to the vector
@@ -356,209 +760,6692 @@ void evsort(void* vec, int (*compar)(const void* a, const void* b));
 void* evcpy(void* src);
 #endif
 
+
+#if defined EV_FSEG  || defined EV_FALL
 /*
- * Implementation!
- * ============================================================================
+ * Segmented vectors
+ * ===========================================================================
+ * A segmented vector keeps its slots in a small directory of blocks, each
+ * twice the size of the one before. Growing adds a new block and never moves
+ * existing slots, so (unlike a normal vector) pointers to slots stay valid
+ * until the item is popped or the vector is freed. Index lookup is still O(1).
  */
+#ifndef EV_SEG_MAX_BLKS
+#define EV_SEG_MAX_BLKS 48 //Enough blocks for 2^48 x base slots
+#endif
 
+#define EV_SEG_MAGIC1 "EVSEGMG"
+#define EV_SEG_MAGIC2 "MGSEGEV"
+typedef struct {
+    char magic1[8];
+    int64_t slt_size;
+    int64_t obj_count;
+    int64_t slt_count;
+    int64_t blk_count;
+    int64_t base_bits; //The first block has 2^base_bits slots
+    void* blks[EV_SEG_MAX_BLKS];
+    char magic2[8];
+} evsg_t;
 
-#if EV_PEDANTIC
-#define ifp(p,e) if(p){e}
+
+/**
+ * Allocate a new, empty segmented vector.
+ * slt_size:    The size of each slot in the vector typically the size of
+ *              the type that is being stored.
+ * return:      A pointer to the segmented vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evsg_t* evsgini(size_t slt_size);
+
+
+/**
+ * Easy push a new value onto the tail of a segmented vector. If the vector is
+ * NULL, it will be automatically allocated based on the object size as
+ * returned by sizeof(obj).
+ *
+ * sg:          Pointer to the segmented vector, or NULL.
+ * obj:         The value to push into the vector.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+#ifdef __GNUC__
+#define evsgpsh(sg, obj) do { \
+         __extension__ __typeof__(obj) __OBJ__ = obj; \
+         if(!(sg)) sg = evsgini(sizeof(__OBJ__)); \
+         evsgpush(sg, &__OBJ__, sizeof(__OBJ__)); \
+     }while(0)
 #else
-#define ifp(p,e)
+#define evsgpsh(sg, obj) do { \
+         if(!(sg)) sg = evsgini(sizeof(obj)); \
+         evsgpush(sg, &obj, sizeof(obj)); \
+     }while(0)
 #endif
 
 
-#ifndef EV_HONLY
-/*
- * When building with multiple .c files, you only need one instance of the EV
- * function implementations. For all other instances, you only need the forwad
- * declaration headers. In these cases, be sure to define EV_HONLY before
- * including evec.h. This will keep the compiler happy for you. e.g.
- *
- * #define EV_FHONLY
- * #include "evec.h"
+/**
+ * Push a new value onto the tail of a segmented vector. Existing slots are
+ * never moved.
+ * sg:          Pointer to the segmented vector
+ * obj:         Pointer to the value to push into the vector.
+ * obj_size:    The size of the value to be pushed into the vector.
+ * return:      A pointer to the slot that the value was copied into. This
+ *              pointer is stable until the value is popped or the vector is
+ *              freed.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
  */
+void* evsgpush(evsg_t* sg, void* obj, size_t obj_size);
 
 
-//Round up to the nearest long. Just a bit of memory safety paranoia
-typedef long align;
-#define EV_HDR_BYTES (( (sizeof(evhd_t) + sizeof(align) - 1) / sizeof(align)) * sizeof(align))
-#define EV_HDR(v) ((evhd_t*)( ((char*)v) - EV_HDR_BYTES ))
-#define EV_VER 1.1
+/**
+ * Remove the last value from the segmented vector tail.
+ * sg:          Pointer to the segmented vector
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evsgpop(evsg_t* sg);
+
+
+/**
+ * Get the number of items in the segmented vector.
+ * sg:          Pointer to the segmented vector
+ * return:      The number of objects in the vector, 0 if the vector is NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evsgcnt(evsg_t* sg);
+
+
+/**
+ * Return a pointer to the slot at a given index. This pointer is stable until
+ * the value is popped or the vector is freed.
+ * sg:          Pointer to the segmented vector
+ * idx:         The index value. Cannot be <0 or greater than the object count
+ * return:      Pointer to the value.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evsgidx(evsg_t* sg, size_t idx);
 
+
+/**
+ * Get the number of blocks that hold items in the segmented vector. Use this
+ * with evsgblk() to scan the vector sequentially, one block at a time.
+ * sg:          Pointer to the segmented vector
+ * return:      The number of blocks holding items, 0 if the vector is NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evsgblks(evsg_t* sg);
+
+
+/**
+ * Return a pointer to the first slot of a block. The slots in a block are
+ * contiguous, so they can be scanned like a normal array.
+ * sg:          Pointer to the segmented vector
+ * blk:         The block index. Must be less than evsgblks().
+ * count:       Set to the number of items held in the block.
+ * return:      Pointer to the first slot in the block, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evsgblk(evsg_t* sg, size_t blk, size_t* count);
+
+
+/**
+ * Free the memory used to hold the segmented vector and its accounting.
+ * sg:          Pointer to the segmented vector
+ * return:      NULL. Use sg = evsgfree(sg) to ensure there are no dangling
+ *              pointers.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evsg_t* evsgfree(evsg_t* sg);
+#endif
+
+
+#if defined EV_FVAR  || defined EV_FALL
 /*
- * Magic values are included so that it's easy to spot the memory segment in
- * a hexdump, and to protect from any violations that might happen by accident
+ * Variable length vectors
+ * ===========================================================================
+ * A variable length vector packs records of any size end to end into a single
+ * byte pool, with a compact array of (offset, length) pairs for O(1) indexing.
+ * This avoids sizing every slot for the largest record (eg. strings in 128B
+ * slots). Duplicate records can optionally be interned, so that they are only
+ * stored in the pool once.
  */
-#define EV_MAGIC1 "EVMAGIC"
-#define EV_MAGIC2 "MAGICEV"
+#ifndef EV_VAR_OFF_T
+#define EV_VAR_OFF_T uint32_t //Limits the pool to 4GB, use uint64_t for more
+#endif
+
+#define EV_FLAG_VAR_INTERN (1 << 0) //Store duplicate records only once
+
+typedef struct {
+    EV_VAR_OFF_T off;
+    EV_VAR_OFF_T len;
+} evvrrec_t;
+
+#define EV_VAR_MAGIC1 "EVVARMG"
+#define EV_VAR_MAGIC2 "MGVAREV"
 typedef struct {
     char magic1[8];
-    int64_t slt_size;
     int64_t obj_count;
-    int64_t slt_count;
+    int64_t rec_count;  //Number of records there is space for
+    int64_t pool_used;
+    int64_t pool_size;
     int64_t index;
+    int64_t flags;
+    evvrrec_t* recs;
+    char* pool;
+    uint32_t* itab;     //Intern hash table of (record index + 1), 0 is empty
+    int64_t itab_size;
+    int64_t itab_used;
     char magic2[8];
-} evhd_t;
+} evvr_t;
 
 
-#define EV_DU_HDR(hdr) _evdumphdr(__LINE__, __FILE__, __FUNCTION__, hdr)
+/**
+ * Allocate a new, empty variable length vector.
+ * flags:       EV_FLAG_VAR_INTERN to store duplicate records only once.
+ * return:      A pointer to the variable length vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evvr_t* evvrini(int64_t flags);
+
+
+/**
+ * Easy push a C string (including the null terminator) onto the tail of a
+ * variable length vector. If the vector is NULL, it will be automatically
+ * allocated.
+ * vr:          Pointer to the variable length vector, or NULL.
+ * str:         The string to push into the vector.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+#define evvrpsh(vr, str) do { \
+         const char* __STR__ = str; \
+         if(!(vr)) vr = evvrini(0); \
+         evvrpush(vr, __STR__, strlen(__STR__) + 1); \
+     }while(0)
+
+
+/**
+ * Push a new record onto the tail of a variable length vector.
+ * vr:          Pointer to the variable length vector
+ * obj:         Pointer to the record to push into the vector.
+ * obj_size:    The size of the record, in bytes.
+ * return:      A pointer to the record in the pool, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evvrpush(evvr_t* vr, const void* obj, size_t obj_size);
+
+
+/**
+ * Get the number of records in the variable length vector.
+ * vr:          Pointer to the variable length vector
+ * return:      The number of records in the vector, 0 if the vector is NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evvrcnt(evvr_t* vr);
+
+
+/**
+ * Return a pointer to the record at a given index.
+ *
+ * **Note** this pointer is only valid until the next vector operation.
+ * A vector operation (such as `evvrpsh()`) may cause a memory reallocation
+ * which can make this pointer undefined.
+ *
+ * vr:          Pointer to the variable length vector
+ * idx:         The index value. Cannot be <0 or greater than the record count
+ * size:        If not NULL, set to the size of the record in bytes.
+ * return:      Pointer to the record.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evvridx(evvr_t* vr, size_t idx, size_t* size);
+
+
+/**
+ * Iterate over each record of a variable length vector, putting a (char)
+ * pointer to the record in ivar. See eveach().
+ */
+#define evvreach(vr,ivar) \
+    for(char* ivar = evvrhead(vr); ivar; ivar = evvrnext(vr))
+
+
+/**
+ * Return a pointer to the first record, and reset the iterator. See evhead().
+ * vr:          Pointer to the variable length vector
+ * return:      A pointer to the first record in the vector, or NULL
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evvrhead(evvr_t* vr);
+
+
+/**
+ * Return a pointer to the next record. See evnext().
+ * vr:          Pointer to the variable length vector
+ * return:      A pointer to the next record in the vector, or NULL
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evvrnext(evvr_t* vr);
+
+
+/**
+ * Remove the last record from the variable length vector tail.
+ * vr:          Pointer to the variable length vector
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evvrpop(evvr_t* vr);
+
+
+/**
+ * Get the total memory used by the variable length vector, including the pool,
+ * the record index, the intern table and accounting overheads.
+ * vr:          Pointer to the variable length vector
+ * return:      The total amount of memory consumed by the vector.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evvrmem(evvr_t* vr);
+
+
+/**
+ * Free the memory used to hold the variable length vector and its accounting.
+ * vr:          Pointer to the variable length vector
+ * return:      NULL. Use vr = evvrfree(vr) to ensure there are no dangling
+ *              pointers.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evvr_t* evvrfree(evvr_t* vr);
+#endif
+
+
+#if defined EV_FCOL  || defined EV_FALL
+/*
+ * Columnar vectors
+ * ===========================================================================
+ * A columnar (struct-of-arrays) vector stores each field of a record in its
+ * own contiguous column. A scan that only reads one field then only touches
+ * the memory for that field, and each column can be handed directly to a SIMD
+ * loop. Records are pushed and read back whole, and push, pop, delete, sort
+ * and growth keep all the columns in step.
+ */
+#ifndef EV_COL_MAX
+#define EV_COL_MAX 16 //Maximum number of columns (fields) in a record
+#endif
+
+#define EV_COL_MAGIC1 "EVCOLMG"
+#define EV_COL_MAGIC2 "MGCOLEV"
+typedef struct {
+    char magic1[8];
+    int64_t obj_count;
+    int64_t slt_count;
+    int64_t col_count;
+    int64_t row_size;
+    size_t col_size[EV_COL_MAX];
+    size_t col_off[EV_COL_MAX];  //Offset of the field in the record
+    char* cols[EV_COL_MAX];      //Each one aligned to EV_CACHE_LINE
+    double grw_factor;           //Growth policy, see evclgrw()
+    int64_t grw_limit;
+    int64_t grw_step;
+    char magic2[8];
+} evcl_t;
+
+
+/**
+ * Allocate a new, empty columnar vector.
+ * col_count:   The number of columns. Cannot be more than EV_COL_MAX.
+ * col_sizes:   The size of each column's field.
+ * col_offs:    The offset of each field in a record, or NULL if the fields
+ *              are packed one after the other.
+ * return:      A pointer to the columnar vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evcl_t* evclini(size_t col_count, const size_t* col_sizes, const size_t* col_offs);
+
+
+//Internal macros, apply m(type, field) to each field in a list of up to 16
+#define _EV_MAP1(m,t,a)      m(t,a)
+#define _EV_MAP2(m,t,a,...)  m(t,a), _EV_MAP1(m,t,__VA_ARGS__)
+#define _EV_MAP3(m,t,a,...)  m(t,a), _EV_MAP2(m,t,__VA_ARGS__)
+#define _EV_MAP4(m,t,a,...)  m(t,a), _EV_MAP3(m,t,__VA_ARGS__)
+#define _EV_MAP5(m,t,a,...)  m(t,a), _EV_MAP4(m,t,__VA_ARGS__)
+#define _EV_MAP6(m,t,a,...)  m(t,a), _EV_MAP5(m,t,__VA_ARGS__)
+#define _EV_MAP7(m,t,a,...)  m(t,a), _EV_MAP6(m,t,__VA_ARGS__)
+#define _EV_MAP8(m,t,a,...)  m(t,a), _EV_MAP7(m,t,__VA_ARGS__)
+#define _EV_MAP9(m,t,a,...)  m(t,a), _EV_MAP8(m,t,__VA_ARGS__)
+#define _EV_MAP10(m,t,a,...) m(t,a), _EV_MAP9(m,t,__VA_ARGS__)
+#define _EV_MAP11(m,t,a,...) m(t,a), _EV_MAP10(m,t,__VA_ARGS__)
+#define _EV_MAP12(m,t,a,...) m(t,a), _EV_MAP11(m,t,__VA_ARGS__)
+#define _EV_MAP13(m,t,a,...) m(t,a), _EV_MAP12(m,t,__VA_ARGS__)
+#define _EV_MAP14(m,t,a,...) m(t,a), _EV_MAP13(m,t,__VA_ARGS__)
+#define _EV_MAP15(m,t,a,...) m(t,a), _EV_MAP14(m,t,__VA_ARGS__)
+#define _EV_MAP16(m,t,a,...) m(t,a), _EV_MAP15(m,t,__VA_ARGS__)
+#define _EV_MAPN(_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16,N,...) N
+#define _EV_MAP(m,t,...) _EV_MAPN(__VA_ARGS__, \
+    _EV_MAP16,_EV_MAP15,_EV_MAP14,_EV_MAP13,_EV_MAP12,_EV_MAP11,_EV_MAP10,_EV_MAP9, \
+    _EV_MAP8,_EV_MAP7,_EV_MAP6,_EV_MAP5,_EV_MAP4,_EV_MAP3,_EV_MAP2,_EV_MAP1)(m,t,__VA_ARGS__)
+#define _EV_COL_SIZE(t,f) sizeof(((t*)0)->f)
+#define _EV_COL_OFF(t,f) offsetof(t,f)
+
+
+/**
+ * Easy allocate a new columnar vector from a record type and a list of its
+ * fields. Each field becomes a column, in the order given. eg.
+ *
+ * evcl_t* c = evclinit(rec_t, id, score);
+ *
+ * type:        A fully specified C struct type.
+ * ...:         The names of the fields to store, up to 16 of them.
+ * return:      A pointer to the columnar vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+#define evclinit(type, ...) \
+    evclini(sizeof((size_t[]){ _EV_MAP(_EV_COL_SIZE, type, __VA_ARGS__) }) / sizeof(size_t), \
+            (size_t[]){ _EV_MAP(_EV_COL_SIZE, type, __VA_ARGS__) }, \
+            (size_t[]){ _EV_MAP(_EV_COL_OFF, type, __VA_ARGS__) })
+
+
+/**
+ * Easy push a record onto the tail of a columnar vector. Use evclpush() to
+ * find out whether the push worked.
+ * cl:          Pointer to the columnar vector
+ * row:         The record to push. Its fields are copied into the columns.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+#ifdef __GNUC__
+#define evclpsh(cl, row) do { \
+         __extension__ __typeof__(row) __ROW__ = row; \
+         evclpush(cl, &__ROW__); \
+     }while(0)
+#else
+#define evclpsh(cl, row) do { \
+         evclpush(cl, &row); \
+     }while(0)
+#endif
+
+
+/**
+ * Push a record onto the tail of a columnar vector, copying each field into
+ * its column.
+ * cl:          Pointer to the columnar vector
+ * row:         Pointer to the record to push.
+ * return:      0 on success, -1 if the columns could not grow. The vector is
+ *              unchanged on failure.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int evclpush(evcl_t* cl, const void* row);
+
+
+/**
+ * Set the growth policy of a columnar vector, which applies to every column.
+ * By default columns grow by EV_GROWTH_FACTOR, as vectors do.
+ * cl:          Pointer to the columnar vector
+ * factor:      Grow by this factor when space runs out. Must be > 1.0.
+ * limit:       Once the columns have this many slots, grow by a fixed number
+ *              of slots (step) instead. 0 means always grow by factor.
+ * step:        The number of slots to add once above limit.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evclgrw(evcl_t* cl, double factor, size_t limit, size_t step);
+
+
+/**
+ * Copy the record at a given index out of the columns.
+ * cl:          Pointer to the columnar vector
+ * idx:         The index value. Cannot be <0 or greater than the object count
+ * row:         Pointer to where the record should be written.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evclget(evcl_t* cl, size_t idx, void* row);
+
+
+/**
+ * Return a pointer to the first item in a column. The column is contiguous,
+ * so it can be used as a plain array of evclcnt() items.
+ *
+ * **Note** this pointer is only valid until the next vector operation.
+ * A vector operation (such as `evclpsh()`) may cause a memory reallocation
+ * which can make this pointer undefined.
+ *
+ * cl:          Pointer to the columnar vector
+ * col:         The column index, in the order the fields were given.
+ * return:      Pointer to the column.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evclcol(evcl_t* cl, size_t col);
+
+
+/**
+ * Return a pointer to one field of the record at a given index.
+ *
+ * **Note** this pointer is only valid until the next vector operation.
+ *
+ * cl:          Pointer to the columnar vector
+ * col:         The column index.
+ * idx:         The index value. Cannot be <0 or greater than the object count
+ * return:      Pointer to the field.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evclidx(evcl_t* cl, size_t col, size_t idx);
+
+
+/**
+ * Get the number of records in the columnar vector.
+ * cl:          Pointer to the columnar vector
+ * return:      The number of records in the vector, 0 if the vector is NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evclcnt(evcl_t* cl);
+
+
+/**
+ * Remove the last record from the columnar vector tail.
+ * cl:          Pointer to the columnar vector
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evclpop(evcl_t* cl);
+
+
+/**
+ * Remove the record at the given index from every column.
+ * cl:          Pointer to the columnar vector
+ * idx:         The index into the vector. Must be >0 and < count.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evcldel(evcl_t* cl, size_t idx);
+
+
+/**
+ * Sort the records by the values in one column. Every column is reordered.
+ * The sort is stable.
+ * cl:          Pointer to the columnar vector
+ * col:         The column to sort by.
+ * compar:      Function pointer which implements the comparison function,
+ *              called with pointers to two items in the column.
+ *              This function returns +ve if a > b, -ve if a < b and 0 if a==b.
+ * return:      None. The vector will be sorted if this function succeeds.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evclsort(evcl_t* cl, size_t col, int (*compar)(const void* a, const void* b));
+
+
+/**
+ * Free the memory used to hold the columnar vector and its accounting.
+ * cl:          Pointer to the columnar vector
+ * return:      NULL. Use cl = evclfree(cl) to ensure there are no dangling
+ *              pointers.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evcl_t* evclfree(evcl_t* cl);
+#endif
+
+
+#if EV_STATS
+/*
+ * Runtime statistics
+ * ===========================================================================
+ * When EV_STATS is set, every vector counts pushes, grows, bytes copied when
+ * growing, bytes shifted when deleting and its peak size. Live vectors are
+ * kept in a global registry, which can be dumped on demand or at exit. Vectors
+ * in caller supplied storage only count towards the totals until they grow
+ * onto the heap. When EV_STATS is not set, none of this is compiled in.
+ */
+
+/**
+ * Get the runtime statistics of a vector.
+ * vec:         Pointer to the vector, or NULL to get the totals over every
+ *              vector, live or freed.
+ * stats:       Set to the statistics.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evstats(void* vec, evstats_t* stats);
+
+
+/**
+ * Write the totals, and the statistics of every live vector.
+ * fd:          The file descriptor to write to, eg. STDERR_FILENO.
+ * json:        If non zero, write JSON rather than text.
+ * return:      None
+ */
+void evstdump(int fd, int json);
+
+
+/**
+ * Write the statistics as evstdump() does when the program exits.
+ * fd:          The file descriptor to write to, eg. STDERR_FILENO.
+ * json:        If non zero, write JSON rather than text.
+ * return:      None
+ */
+void evstexit(int fd, int json);
+#endif
+
+#if EV_TRACE
+/*
+ * Allocation site tracing
+ * ===========================================================================
+ * When EV_TRACE is set, evini(), evpush() (and the macros built on them),
+ * evini_aligned(), evcpy() and evadopt() record the __FILE__ and __LINE__ of
+ * the call that made each vector. evtrdump() reports the live bytes, unused
+ * (slack) bytes and number of grows of the vectors made at each call site.
+ * Vectors in caller supplied storage are traced from the push that moves
+ * them onto the heap.
+ * Only pointers are stored, so it is cheap enough to leave on.
+ */
+
+/**
+ * Write the live bytes, slack bytes and grow count of the vectors made at
+ * each call site, biggest first.
+ * fd:          The file descriptor to write to, eg. STDERR_FILENO.
+ * json:        If non zero, write JSON rather than text.
+ * return:      None
+ */
+void evtrdump(int fd, int json);
+
+
+//Internal functions used by the tracing macros at the end of this file
+void* _evtrsite(void* vec, const char* file, int line);
+void* _evtrpush(void* vec, void* obj, size_t obj_size, const char* file, int line);
+#endif
+
+//Internal macro, apply m(suffix, type, accumulator type) to each numeric type,
+//to generate the typed versions of functions
+#define _EV_NUM_TYPES(m) \
+    m(i32, int32_t, int64_t) \
+    m(i64, int64_t, int64_t) \
+    m(f32, float,   double)  \
+    m(f64, double,  double)
+
+#if defined EV_FMATH || defined EV_FALL
+/*
+ * Numeric kernels
+ * ===========================================================================
+ * Typed reductions and element wise operations over vectors of int32_t,
+ * int64_t, float and double. Each kernel checks the vector header once, then
+ * runs a tight loop over the slots, with several independent lanes so that the
+ * compiler can vectorize it (build with -O3, and -march=native to use the
+ * widest SIMD that the machine has). Above EV_PAR_CUTOFF items, the work is
+ * split over up to EV_PAR_THREADS threads. The threads are started the first
+ * time a kernel is split, then wait for the next one, so later splits only pay
+ * to wake them (a few microseconds, against about a millisecond to scan the
+ * EV_PAR_CUTOFF items).
+ *
+ * Kernels are named by a type suffix: _i32, _i64, _f32 and _f64. Integer sums
+ * and dot products are returned as int64_t, and floating point ones as double.
+ */
+#ifndef EV_PAR_CUTOFF
+#define EV_PAR_CUTOFF (1 << 20) //Split kernels over threads above this many items
+#endif
+
+#ifndef EV_PAR_THREADS
+#define EV_PAR_THREADS 8 //Most threads to split a kernel over
+#endif
+
+/**
+ * For each type suffix S (i32, i64, f32, f64) with item type T and
+ * accumulator type A:
+ *
+ * A evsum_S(T* vec)              Sum of the items, or 0 if there are none.
+ * A evdot_S(T* a, T* b)          Dot product of two vectors of equal length.
+ * T evmin_S(T* vec)              Smallest item.
+ * T evmax_S(T* vec)              Largest item.
+ * size_t evargmin_S(T* vec)      Index of the first smallest item, or -1.
+ * size_t evargmax_S(T* vec)      Index of the first largest item, or -1.
+ * void evscale_S(T* vec, T k)    Multiply every item by k.
+ * void evadd_S(T* vec, T* src)   Add each item of src to the same item of vec.
+ * void evprefix_S(T* vec)        Replace each item with the sum of it and all
+ *                                of the items before it (inclusive scan).
+ *
+ * The slot size of each vector must be sizeof(T). The results of min, max,
+ * argmin and argmax are undefined if a floating point vector holds NaNs.
+ * failure:     If EV_HARD_EXIT is enabled, these functions may cause exit();
+ */
+#define _EV_NUM_DECL(S, T, A) \
+    A evsum_##S(T* vec); \
+    A evdot_##S(T* a, T* b); \
+    T evmin_##S(T* vec); \
+    T evmax_##S(T* vec); \
+    size_t evargmin_##S(T* vec); \
+    size_t evargmax_##S(T* vec); \
+    void evscale_##S(T* vec, T k); \
+    void evadd_##S(T* vec, T* src); \
+    void evprefix_##S(T* vec);
+_EV_NUM_TYPES(_EV_NUM_DECL)
+
+/**
+ * Map each item of src through fn, and push the results onto dst. dst grows at
+ * most once, to make room for all of the results up front.
+ * dst:         Pointer to the destination vector, or NULL to make a new one
+ * src:         Pointer to the source vector. Cannot be the same as dst.
+ * slt_size:    The slot size to use if dst is NULL, otherwise ignored
+ * fn:          Called as fn(out, in, arg) for each item in order, with in
+ *              pointing to the source item and out to the (zeroed) destination
+ *              slot.
+ * arg:         Passed through to fn
+ * return:      A pointer to dst, which may have moved, or NULL
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evmap(void* dst, void* src, size_t slt_size,
+            void (*fn)(void* out, const void* in, void* arg), void* arg);
+#endif
+
+
+#if defined EV_FNUMA || defined EV_FALL
+/*
+ * NUMA placement
+ * ===========================================================================
+ * By default the pages of a vector land on the NUMA node of the thread that
+ * first touches them, which for a vector built by one thread is one node. A
+ * NUMA policy set with evnuma() spreads the pages over every node, or binds
+ * them to one node. The policy is kept with the vector and applied again
+ * each time the vector grows. On a machine with one node (or without NUMA
+ * support) the policy has no effect.
+ */
+#define EV_NUMA_DEFAULT    0 //Pages go to the node of the thread that touches them
+#define EV_NUMA_INTERLEAVE 1 //Pages are spread round robin over every node
+#define EV_NUMA_BIND       2 //Pages are put on one node
+
+/**
+ * Set the NUMA policy of a vector. Pages already in the vector are moved to
+ * match the policy (as far as the kernel allows).
+ * vec:         Pointer to the vector
+ * policy:      EV_NUMA_DEFAULT, EV_NUMA_INTERLEAVE or EV_NUMA_BIND
+ * node:        The node to bind to for EV_NUMA_BIND, otherwise ignored
+ * return:      0 on success, or -1
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int evnuma(void* vec, int policy, int node);
+
+/**
+ * Return the number of NUMA nodes that are online. This is 1 if the machine
+ * has no NUMA support.
+ */
+int evnumanodes(void);
+
+/**
+ * Find out where the pages of the vector's storage are.
+ * vec:         Pointer to the vector
+ * pages:       Filled in with the number of pages on each node
+ * max_nodes:   The number of entries in pages
+ * return:      The total number of pages that are resident, or -1. If the
+ *              system has no NUMA support, every page is counted on node 0.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int64_t evnumaplace(void* vec, size_t* pages, size_t max_nodes);
+#endif
+
+
+#if defined EV_FHUGE || defined EV_FALL
+/*
+ * Huge pages
+ * ===========================================================================
+ * Random access into a vector of many GB is dominated by TLB misses. Once a
+ * vector's storage grows past a threshold set with evhuge(), it is moved into
+ * its own mapping, aligned to a huge page and marked with MADV_HUGEPAGE so the
+ * kernel backs it with transparent huge pages. Later growth keeps the
+ * alignment, and remaps the pages rather than copying them where it can.
+ */
+#ifndef EV_HUGE_PAGE
+#define EV_HUGE_PAGE (2 * 1024 * 1024) //Huge page size in bytes
+#endif
+
+/**
+ * Set the size above which the vector's storage uses huge pages. This takes
+ * effect the next time the vector grows.
+ * vec:         Pointer to the vector
+ * threshold:   Use huge pages once the storage is at least this many bytes.
+ *              0 turns huge pages off for future growth.
+ * flags:       EV_FLAG_HUGETLB to try explicit huge pages (MAP_HUGETLB) first.
+ *              These must be reserved by the administrator (see
+ *              /proc/sys/vm/nr_hugepages), otherwise transparent huge pages
+ *              are used. Or 0.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evhuge(void* vec, size_t threshold, int64_t flags);
+
+/**
+ * Return how many bytes of the vector's storage are actually backed by huge
+ * pages, as reported by /proc/self/smaps.
+ * vec:         Pointer to the vector
+ * return:      The number of bytes, or -1.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int64_t evhugebytes(void* vec);
+#endif
+
+
+#if defined EV_FSHM || defined EV_FALL
+/*
+ * Shared memory vectors
+ * ===========================================================================
+ * A shared memory vector lives in a named POSIX shared memory segment (see
+ * shm_open()), so that another process can attach to it by name and read the
+ * items in place, without copying them through a pipe. The segment starts with
+ * a small block that gives the offset of the vector header, so each process
+ * can map the segment at a different address. One process writes to the
+ * vector with evshpush(). Every time that grows the segment it bumps a
+ * generation number, and the other processes pick up the bigger segment when
+ * they next call evshvec(). Both sides must be built with the same EV_F* and
+ * EV_STATS / EV_TRACE options, so that they agree on the header layout.
+ */
+#ifndef EV_SHM_MODE
+#define EV_SHM_MODE 0600 //Permissions for new segments
+#endif
+
+#define EV_FLAG_SHM_RDWR (1 << 0) //Attach for reading and writing
+
+#define EV_SHM_SEG_MAGIC1 "EVSHMSG"
+#define EV_SHM_SEG_MAGIC2 "SGSHMEV"
+typedef struct {
+    char magic1[8];
+    int64_t hdr_bytes;  //EV_HDR_BYTES of the creator, attaching needs the same
+    int64_t hdr_off;    //Offset of the vector header from the start of the segment
+    int64_t seg_bytes;  //Length of the segment
+    int64_t gen;        //Bumped every time the segment grows
+    char magic2[8];
+} evshhd_t;
+
+#define EV_SHM_MAGIC1 "EVSHMMG"
+#define EV_SHM_MAGIC2 "MGSHMEV"
+typedef struct {
+    char magic1[8];
+    int64_t fd;
+    int64_t flags;
+    char* base;         //This process's mapping of the segment
+    int64_t map_bytes;  //Length of the mapping
+    int64_t gen;        //Generation of the segment when it was mapped
+    char magic2[8];
+} evsh_t;
+
+
+/**
+ * Create a new, empty vector in a new shared memory segment. The caller can
+ * then push into it with evshpush().
+ * name:        The segment name, "/name" as for shm_open(). This must not
+ *              already exist.
+ * slt_size:    The size of each slot in the vector typically the size of
+ *              the type that is being stored.
+ * count:       The initial number of slots. This is rounded up to fill
+ *              whole pages.
+ * return:      A pointer to the shared memory vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evsh_t* evshini(const char* name, size_t slt_size, size_t count);
+
+
+/**
+ * Attach to a shared memory vector that was made by another process.
+ * name:        The segment name given to evshini().
+ * flags:       EV_FLAG_SHM_RDWR to be able to write to the vector, or 0 for
+ *              read only. Only one process should write at a time.
+ * return:      A pointer to the shared memory vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evsh_t* evshopen(const char* name, int64_t flags);
+
+
+/**
+ * Return the vector in a shared memory segment. This is a normal vector that
+ * can be used with evcnt(), evidx() etc. If the segment has grown since it
+ * was last mapped, it is mapped again first, so the vector may move. Read
+ * only vectors cannot be iterated with evhead() / evnext(), as these write to
+ * the header.
+ * sh:          Pointer to the shared memory vector
+ * return:      Pointer to the vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evshvec(evsh_t* sh);
+
+
+/**
+ * Get the number of items that can be read through this process's mapping of
+ * the segment. This is safe to call while another process pushes.
+ * sh:          Pointer to the shared memory vector
+ * return:      The number of objects, 0 if the vector is NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evshcnt(evsh_t* sh);
+
+
+/**
+ * Get the generation of the segment. This goes up every time the segment
+ * grows. Compare it with an earlier value to see if the vector has moved.
+ * sh:          Pointer to the shared memory vector
+ * return:      The generation, or -1.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int64_t evshgen(evsh_t* sh);
+
+
+/**
+ * Easy push a new value onto the tail of a shared memory vector.
+ * sh:          Pointer to the shared memory vector
+ * obj:         The value to push into the vector.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+#ifdef __GNUC__
+#define evshpsh(sh, obj) do { \
+         __extension__ __typeof__(obj) __OBJ__ = obj; \
+         evshpush(sh, &__OBJ__, sizeof(__OBJ__)); \
+     }while(0)
+#else
+#define evshpsh(sh, obj) evshpush(sh, &obj, sizeof(obj))
+#endif
+
+
+/**
+ * Push a new value onto the tail of a shared memory vector, growing the
+ * segment if needed. Readers see the item once it has been fully copied in.
+ * sh:          Pointer to the shared memory vector. It must have been made
+ *              with evshini() or attached with EV_FLAG_SHM_RDWR.
+ * obj:         Pointer to the value to push into the vector.
+ * obj_size:    The size of the value to be pushed into the vector.
+ * return:      Pointer to the vector, which may have moved, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evshpush(evsh_t* sh, void* obj, size_t obj_size);
+
+
+/**
+ * Unmap the shared memory vector from this process. The segment itself stays
+ * until it is removed with evshunlink() and every process has let it go.
+ * sh:          Pointer to the shared memory vector
+ * return:      NULL. Use sh = evshfree(sh) to ensure there are no dangling
+ *              pointers.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evsh_t* evshfree(evsh_t* sh);
+
+
+/**
+ * Remove the name of a shared memory segment, so no more processes can attach.
+ * name:        The segment name given to evshini().
+ * return:      0 on success, or -1.
+ */
+int evshunlink(const char* name);
+#endif
+
+
+#if defined EV_FRCU || defined EV_FALL
+/*
+ * Epoch vectors
+ * ===========================================================================
+ * An epoch vector has one writer thread that pushes, and any number of reader
+ * threads that read, with no locks. A reader enters an epoch and gets a
+ * snapshot of the vector and its count, which stays valid until it exits.
+ * When the writer runs out of room, it copies the items into new storage and
+ * publishes that. The old storage is only freed once every reader that might
+ * still see it has exited.
+ */
+#ifndef EV_RCU_READERS
+#define EV_RCU_READERS 64 //Most reader threads at once
+#endif
+
+typedef struct {
+    int64_t used;       //1 if a reader has claimed this slot
+    int64_t epoch;      //Epoch the reader entered, or 0 if it is not reading
+    char pad[64 - 2 * sizeof(int64_t)]; //One reader per cache line
+} evrcrd_t;
+
+#define EV_RCU_MAGIC1 "EVRCUMG"
+#define EV_RCU_MAGIC2 "MGRCUEV"
+typedef struct {
+    char magic1[8];
+    void* vec;          //The published vector
+    int64_t epoch;      //Bumped every time the vector is replaced
+    void* retired;      //Vector of replaced storage, waiting to be freed
+    char pad[64 - 8 - 2 * sizeof(void*) - sizeof(int64_t)]; //Readers start on their own cache line
+    evrcrd_t readers[EV_RCU_READERS];
+    char magic2[8];
+} evrc_t;
+
+
+/**
+ * Allocate a new, empty epoch vector.
+ * slt_size:    The size of each slot in the vector typically the size of
+ *              the type that is being stored.
+ * count:       The initial number of slots.
+ * return:      A pointer to the epoch vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evrc_t* evrcini(size_t slt_size, size_t count);
+
+
+/**
+ * Easy push a new value onto the tail of an epoch vector. Only one thread
+ * may push.
+ * rc:          Pointer to the epoch vector
+ * obj:         The value to push into the vector.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+#ifdef __GNUC__
+#define evrcpsh(rc, obj) do { \
+         __extension__ __typeof__(obj) __OBJ__ = obj; \
+         evrcpush(rc, &__OBJ__, sizeof(__OBJ__)); \
+     }while(0)
+#else
+#define evrcpsh(rc, obj) evrcpush(rc, &obj, sizeof(obj))
+#endif
+
+
+/**
+ * Push a new value onto the tail of an epoch vector. Only one thread may
+ * push. Readers see the item once it has been fully copied in. If the vector
+ * has to grow, storage that no reader can see any more is freed.
+ * rc:          Pointer to the epoch vector
+ * obj:         Pointer to the value to push into the vector.
+ * obj_size:    The size of the value to be pushed into the vector.
+ * return:      Pointer to the current vector, for the writer to read, or NULL.
+ *              This must not be grown or freed with the normal functions.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evrcpush(evrc_t* rc, void* obj, size_t obj_size);
+
+
+/**
+ * Claim a reader slot, for one reader thread to use with evrcenter().
+ * rc:          Pointer to the epoch vector
+ * return:      The reader slot, or -1 if all EV_RCU_READERS are taken.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int evrcreg(evrc_t* rc);
+
+
+/**
+ * Give back a reader slot claimed with evrcreg().
+ * rc:          Pointer to the epoch vector
+ * reader:      The reader slot. The reader must not be in an epoch.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evrcunreg(evrc_t* rc, int reader);
+
+
+/**
+ * Enter an epoch and take a snapshot of the vector. The items in the snapshot
+ * do not change, and the storage is not freed, until evrcexit() is called.
+ * rc:          Pointer to the epoch vector
+ * reader:      The reader slot from evrcreg()
+ * count:       Set to the number of items in the snapshot.
+ * return:      Pointer to the vector, or NULL. Use it as a plain array of
+ *              count items, the header must not be changed.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evrcenter(evrc_t* rc, int reader, size_t* count);
+
+
+/**
+ * Leave the epoch entered by evrcenter(). The snapshot must not be used after
+ * this.
+ * rc:          Pointer to the epoch vector
+ * reader:      The reader slot from evrcreg()
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evrcexit(evrc_t* rc, int reader);
+
+
+/**
+ * Free any replaced storage that no reader can see any more. This is done
+ * every time the vector grows, so it is only needed to give the memory back
+ * sooner. It must be called by the writer thread.
+ * rc:          Pointer to the epoch vector
+ * return:      The number of old copies of the storage still waiting for
+ *              readers to exit.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evrcsync(evrc_t* rc);
+
+
+/**
+ * Free the epoch vector and all of its storage. No reader may be in an epoch.
+ * rc:          Pointer to the epoch vector
+ * return:      NULL. Use rc = evrcfree(rc) to ensure there are no dangling
+ *              pointers.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evrc_t* evrcfree(evrc_t* rc);
+#endif
+
+
+#if defined EV_FBITS || defined EV_FALL
+/*
+ * Bit vectors
+ * ===========================================================================
+ * A bit vector packs one flag per bit into an EV vector of 64 bit words, so
+ * it has the usual header, growth policy and memory sizing functions. The
+ * words can be read directly, bit i is (bits[i / 64] >> (i % 64)) & 1. The
+ * number of bits is kept with the vector, and bits past the end of the last
+ * word are always zero. Bit vectors cannot be grown incrementally (evinc()).
+ */
+
+/**
+ * Allocate a new, empty bit vector.
+ * count:       The initial number of bits to make room for.
+ * return:      A pointer to the bit vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+uint64_t* evbitsini(size_t count);
+
+
+/**
+ * Push a new bit onto the tail of the bit vector. If the vector is NULL, it
+ * will be automatically allocated.
+ * bits:        Pointer to the bit vector, or NULL.
+ * bit:         The value of the bit, 0 or not 0.
+ * return:      Pointer to the bit vector, which may have moved, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+uint64_t* evbitspush(uint64_t* bits, int bit);
+
+
+/**
+ * Get the number of bits in the bit vector.
+ * bits:        Pointer to the bit vector
+ * return:      The number of bits, 0 if the vector is NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evbitscnt(uint64_t* bits);
+
+
+/**
+ * Get, set or clear one bit.
+ * bits:        Pointer to the bit vector
+ * idx:         The index of the bit. Must be less than evbitscnt().
+ * return:      evbitsget() returns the bit, 0 or 1.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int evbitsget(uint64_t* bits, size_t idx);
+void evbitsset(uint64_t* bits, size_t idx);
+void evbitsclr(uint64_t* bits, size_t idx);
+
+
+/**
+ * Count the bits that are set.
+ * bits:        Pointer to the bit vector
+ * return:      The number of bits that are 1.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evbitspopcnt(uint64_t* bits);
+
+
+/**
+ * Find the first bit that is set, at or after a given index. To visit every
+ * set bit, use for(i = evbitsffs(b, 0); i >= 0; i = evbitsffs(b, i + 1))
+ * bits:        Pointer to the bit vector
+ * from:        The index to start looking at.
+ * return:      The index of the bit, or -1 if there are no more set bits.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int64_t evbitsffs(uint64_t* bits, size_t from);
+
+
+/**
+ * Combine two bit vectors of the same length a word at a time, dst = dst & src,
+ * dst = dst | src or dst = dst ^ src.
+ * dst:         Pointer to the bit vector to update
+ * src:         Pointer to a bit vector with the same number of bits
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evbitsand(uint64_t* dst, uint64_t* src);
+void evbitsor(uint64_t* dst, uint64_t* src);
+void evbitsxor(uint64_t* dst, uint64_t* src);
+#endif
+
+
+#if defined EV_FPACK || defined EV_FALL
+/*
+ * Packed integer vectors
+ * ===========================================================================
+ * A packed integer vector stores 64 bit integers in blocks of EV_PK_BLOCK.
+ * Each block keeps its first value and the smallest difference between
+ * neighbours in a block index. The rest of each difference is bit packed
+ * with just enough bits for the biggest one in the block. Sorted IDs and
+ * timestamps, where neighbours are close, take a byte or two per value
+ * rather than eight. Items can be read at random through the block index,
+ * but evpkdecode() is much faster for reading runs of items.
+ */
+#define EV_PK_BLOCK 128 //Values per packed block
+
+typedef struct {
+    int64_t first;       //First value in the block
+    int64_t min_delta;   //Smallest difference between neighbours in the block
+    uint64_t off_width;  //Word offset of the packed differences << 8 | bit width
+} evpkbk_t;
+
+#define EV_PK_MAGIC1 "EVPAKMG"
+#define EV_PK_MAGIC2 "MGPAKEV"
+typedef struct {
+    char magic1[8];
+    int64_t obj_count;
+    evpkbk_t* blks;               //Block index, an EV vector
+    uint64_t* words;              //Packed differences, an EV vector
+    int64_t tail[EV_PK_BLOCK];    //Values that do not fill a block yet
+    char magic2[8];
+} evpk_t;
+
+
+/**
+ * Allocate a new, empty packed integer vector.
+ * return:      A pointer to the packed integer vector, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evpk_t* evpkini(void);
+
+
+/**
+ * Push a new value onto the tail of a packed integer vector. Values are packed
+ * a block at a time, as each block fills up.
+ * pk:          Pointer to the packed integer vector
+ * value:       The value to push
+ * return:      0 on success, or -1.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int evpkpush(evpk_t* pk, int64_t value);
+
+
+/**
+ * Get the number of values in the packed integer vector.
+ * pk:          Pointer to the packed integer vector
+ * return:      The number of values, 0 if the vector is NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evpkcnt(evpk_t* pk);
+
+
+/**
+ * Get the value at a given index. This unpacks part of one block.
+ * pk:          Pointer to the packed integer vector
+ * idx:         The index value. Must be less than evpkcnt().
+ * return:      The value.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int64_t evpkget(evpk_t* pk, size_t idx);
+
+
+/**
+ * Unpack a run of values into a plain array.
+ * pk:          Pointer to the packed integer vector
+ * start:       The index of the first value to unpack.
+ * out:         Array to unpack the values into.
+ * count:       The most values to unpack.
+ * return:      The number of values unpacked, which is less than count if
+ *              the end of the vector is reached.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evpkdecode(evpk_t* pk, size_t start, int64_t* out, size_t count);
+
+
+/**
+ * Get the total memory used by the packed integer vector, including the block
+ * index and the handle.
+ * pk:          Pointer to the packed integer vector
+ * return:      The number of bytes.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+size_t evpkmem(evpk_t* pk);
+
+
+/**
+ * Free the memory used to hold the packed integer vector.
+ * pk:          Pointer to the packed integer vector
+ * return:      NULL. Use pk = evpkfree(pk) to ensure there are no dangling
+ *              pointers.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+evpk_t* evpkfree(evpk_t* pk);
+#endif
+
+
+#if defined EV_FHEAP || defined EV_FALL
+/*
+ * Heaps
+ * ===========================================================================
+ * Keep a vector in heap order, so that the item that would sort first with
+ * evsort() is always at the top (index 0), in O(log n) per push and pop rather
+ * than a sort each time. By default a heap is binary. A 4-ary heap (see
+ * evheap_arity()) is shallower and keeps each item's children together in a
+ * cache line or two, which is faster for big heaps.
+ */
+
+/**
+ * Push a new value onto a heap. If the vector is NULL, it will be
+ * automatically allocated based on the object size.
+ * vec:         Pointer to the vector, or NULL.
+ * obj:         Pointer to the value to push.
+ * obj_size:    The size of the value to push.
+ * compar:      Comparison function, as for evsort(). The smallest item is on
+ *              top.
+ * return:      Pointer to the vector, which may have moved, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evheap_push(void* vec, void* obj, size_t obj_size, int (*compar)(const void* a, const void* b));
+
+
+/**
+ * Get the item at the top of the heap, without removing it.
+ * vec:         Pointer to the vector
+ * return:      Pointer to the top item, or NULL if the heap is empty.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evheap_top(void* vec);
+
+
+/**
+ * Remove the item at the top of the heap.
+ * vec:         Pointer to the vector
+ * obj:         If not NULL, the top item is copied here first. This must have
+ *              room for one slot.
+ * compar:      Comparison function, the same as the heap was built with.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evheap_pop(void* vec, void* obj, int (*compar)(const void* a, const void* b));
+
+
+/**
+ * Put every item of a vector into heap order, in O(n).
+ * vec:         Pointer to the vector
+ * compar:      Comparison function, as for evsort().
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evheapify(void* vec, int (*compar)(const void* a, const void* b));
+
+
+/**
+ * Set the number of children per item in a heap. This changes the layout, so
+ * set it while the vector is empty, or call evheapify() afterwards.
+ * vec:         Pointer to the vector
+ * arity:       2 or 4.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evheap_arity(void* vec, int arity);
+
+
+/**
+ * Typed heaps, for each type suffix S (i32, i64, f32, f64) with item type T.
+ * These compare items inline, rather than calling a comparison function. The
+ * smallest item is on top, at vec[0].
+ *
+ * T* evheap_push_S(T* vec, T value)  Push a value, the vector may be NULL and
+ *                                    may move.
+ * T evheap_pop_S(T* vec)             Remove the top item and return it.
+ * void evheapify_S(T* vec)           Put every item into heap order.
+ *
+ * The slot size of each vector must be sizeof(T). The order is undefined if a
+ * floating point vector holds NaNs.
+ * failure:     If EV_HARD_EXIT is enabled, these functions may cause exit();
+ */
+#define _EV_HEAP_DECL(S, T, A) \
+    T* evheap_push_##S(T* vec, T value); \
+    T evheap_pop_##S(T* vec); \
+    void evheapify_##S(T* vec);
+_EV_NUM_TYPES(_EV_HEAP_DECL)
+#endif
+
+
+#if defined EV_FSET || defined EV_FALL
+/*
+ * Sorted set operations
+ * ===========================================================================
+ * Combine two vectors that are already sorted (with evsort() or similar) into
+ * a third, in one linear pass. The results are pushed onto the destination,
+ * which grows at most once, to fit the most results the operation can give.
+ * When one input has EV_SET_GALLOP times as many items as the other, each item
+ * of the smaller one is found in the bigger one with an exponential then
+ * binary search, and the runs of items in between are copied in bulk, so the
+ * cost follows the smaller input.
+ *
+ * evmerge() keeps every item. The others treat their inputs as sets, which
+ * must be sorted with no duplicates, and give a set back.
+ */
+#define EV_SET_GALLOP 32 //Search the bigger input when it has this many times the items
+
+/**
+ * Combine two sorted vectors and push the results onto dst, in sorted order.
+ * evmerge:     Every item of a and b, with items of a first when they are equal
+ * evunion:     Items in a or b (or both), taken from a when they are in both
+ * evinter:     Items in both a and b, taken from a
+ * evdiff:      Items in a that are not in b
+ * dst:         Pointer to the destination vector, or NULL to make a new one.
+ *              Cannot be the same as a or b.
+ * a, b:        Pointers to the sorted input vectors, with the same slot size.
+ *              NULL is taken as empty.
+ * compar:      Comparison function, the same as the inputs were sorted with.
+ * return:      A pointer to dst, which may have moved, or NULL
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evmerge(void* dst, void* a, void* b, int (*compar)(const void* a, const void* b));
+void* evunion(void* dst, void* a, void* b, int (*compar)(const void* a, const void* b));
+void* evinter(void* dst, void* a, void* b, int (*compar)(const void* a, const void* b));
+void* evdiff(void* dst, void* a, void* b, int (*compar)(const void* a, const void* b));
+
+
+/**
+ * Typed set operations, for each type suffix S (i32, i64, f32, f64) with item
+ * type T. These compare items inline, rather than calling a comparison
+ * function, and the inputs must be sorted in ascending order.
+ * evinter_i32() compares blocks of 4 items against 4 with SSE2, where the
+ * machine has it.
+ *
+ * T* evmerge_S(T* dst, T* a, T* b)
+ * T* evunion_S(T* dst, T* a, T* b)
+ * T* evinter_S(T* dst, T* a, T* b)
+ * T* evdiff_S(T* dst, T* a, T* b)
+ *
+ * The slot size of each vector must be sizeof(T). The results are undefined if
+ * a floating point vector holds NaNs.
+ * failure:     If EV_HARD_EXIT is enabled, these functions may cause exit();
+ */
+#define _EV_SET_DECL(S, T, A) \
+    T* evmerge_##S(T* dst, T* a, T* b); \
+    T* evunion_##S(T* dst, T* a, T* b); \
+    T* evinter_##S(T* dst, T* a, T* b); \
+    T* evdiff_##S(T* dst, T* a, T* b);
+_EV_NUM_TYPES(_EV_SET_DECL)
+#endif
+
+
+#if defined EV_FGATHER || defined EV_FALL
+/*
+ * Gather and scatter
+ * ===========================================================================
+ * Copy items to or from a list of indices (a permutation, or the row IDs that
+ * matched a query, for example). A loop over evidx() checks the header once
+ * per item, and then waits for each cache miss in turn. These check the header
+ * and the bounds of the whole batch once, and prefetch EV_GATHER_AHEAD items
+ * in front, so that many misses are in flight at the same time.
+ */
+#define EV_GATHER_AHEAD 16 //Items to prefetch in front of the copy
+
+/**
+ * Copy the items of src at each index in a list, and push them onto dst, in
+ * the order of the list. dst grows at most once.
+ * dst:         Pointer to the destination vector, or NULL to make a new one.
+ *              Cannot be the same as src.
+ * src:         Pointer to the source vector
+ * idx:         Array of n indices into src. Indices may repeat.
+ * n:           The number of indices
+ * return:      A pointer to dst, which may have moved, or NULL
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evgather(void* dst, void* src, const size_t* idx, size_t n);
+
+
+/**
+ * Copy the first n items of src over the items of dst at each index in a
+ * list, so that item k of src goes to index idx[k] of dst. If an index
+ * repeats, the last item copied to it stays.
+ * dst:         Pointer to the destination vector
+ * idx:         Array of n indices into dst
+ * src:         Pointer to the source vector, with at least n items
+ * n:           The number of indices
+ * return:      0 on success, or -1
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+int evscatter(void* dst, const size_t* idx, void* src, size_t n);
+#endif
+
+
+#if defined EV_FCACHE || defined EV_FALL
+/*
+ * Block cache
+ * ===========================================================================
+ * Programs that make and free the same shapes of vectors over and over spend
+ * much of their time in malloc() and free(). The block cache keeps the blocks
+ * of freed vectors on per thread free lists, one for each power of 2 size
+ * class, and hands them back out to evini() and to vectors that grow. It is
+ * off until evcache_limits() turns it on for a thread.
+ *
+ * While the cache is on, new blocks are rounded up to their size class, and
+ * the vector gets the extra slots (so evvsz() may be more than was asked for).
+ * Blocks freed on one thread go to that thread's cache. Blocks of vectors in
+ * huge pages, with aligned slots, with a NUMA policy, in the caller's storage,
+ * or part way through growing incrementally are never cached.
+ */
+#define EV_CACHE_CLASSES 48 //Power of 2 size classes, up to 128TB
+
+/*
+ * Counters for the calling thread's cache
+ */
+typedef struct {
+    uint64_t hits;      //Blocks handed out of the cache
+    uint64_t misses;    //Blocks wanted, but not in the cache
+    uint64_t puts;      //Freed blocks kept in the cache
+    uint64_t drops;     //Freed blocks that were over the limits, so free()'d
+    size_t blocks;      //Blocks held now
+    size_t bytes;       //Bytes held now
+} evcache_stats_t;
+
+/**
+ * Set the limits of the calling thread's cache, which turns it on. Setting
+ * either limit to 0 turns it off and flushes it. The cache is flushed when the
+ * thread exits.
+ * max_blocks:  The most blocks to keep in each size class
+ * max_bytes:   The most bytes to keep in total. Blocks bigger than this are
+ *              never cached, or rounded up.
+ * return:      None
+ */
+void evcache_limits(size_t max_blocks, size_t max_bytes);
+
+
+/**
+ * Free every block in the calling thread's cache. The cache stays on.
+ * return:      The number of bytes freed
+ */
+size_t evcache_flush(void);
+
+
+/**
+ * Get the counters of the calling thread's cache.
+ * stats:       Filled in with the counters
+ * return:      None
+ */
+void evcache_stats(evcache_stats_t* stats);
+#endif
+
+
+#if defined EV_FSELECT || defined EV_FALL
+/*
+ * Selection
+ * ===========================================================================
+ * Find the first k items of a vector in sorted order, without paying for a
+ * full sort. evnth() puts one item in its sorted place in O(n) on average
+ * (introselect, a quickselect that falls back to a heap if the pivots go
+ * badly, so the worst case is O(n log n)). evpartial_sort() sorts only the
+ * first k items, in O(n + k log k). For items that arrive one at a time,
+ * evtopk_push() keeps the first k seen so far in a bounded heap, where most
+ * items are turned away with one compare once the heap is full.
+ */
+#define EV_SELECT_SMALL 16 //Ranges this small are finished with an insertion sort
+
+/**
+ * Reorder a vector so that the item at index k is the one that would be there
+ * after evsort(). No item before it sorts after it, and no item after it sorts
+ * before it. The order on either side is unspecified.
+ * vec:         Pointer to the vector
+ * k:           The index to select, less than evcnt(vec).
+ * compar:      Comparison function, as for evsort().
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evnth(void* vec, size_t k, int (*compar)(const void* a, const void* b));
+
+
+/**
+ * Reorder a vector so that its first k items are the ones that would be there
+ * after evsort(), in the same order. The order of the rest is unspecified.
+ * vec:         Pointer to the vector
+ * k:           The number of items to sort. If this is more than evcnt(vec),
+ *              the whole vector is sorted.
+ * compar:      Comparison function, as for evsort().
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evpartial_sort(void* vec, size_t k, int (*compar)(const void* a, const void* b));
+
+
+/**
+ * Offer a value to a top k accumulator, which keeps the k items that sort
+ * first of all the values it has been offered. The items are kept in a heap
+ * with the one that sorts last on top, so a value that sorts after it is
+ * turned away straight away. If the vector is NULL, it will be automatically
+ * allocated based on the object size.
+ * vec:         Pointer to the vector, or NULL.
+ * obj:         Pointer to the value to offer.
+ * obj_size:    The size of the value to offer.
+ * k:           The most items to keep. Use the same k for every call.
+ * compar:      Comparison function, as for evsort().
+ * return:      Pointer to the vector, which may have moved, or NULL.
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void* evtopk_push(void* vec, void* obj, size_t obj_size, size_t k, int (*compar)(const void* a, const void* b));
+
+
+/**
+ * Sort the items of a top k accumulator into order, in place, with heapsort.
+ * The vector is no longer a heap afterwards, so it cannot be offered any more
+ * values.
+ * vec:         Pointer to the vector
+ * compar:      Comparison function, the same as the items were offered with.
+ * return:      None
+ * failure:     If EV_HARD_EXIT is enabled, this function may cause exit();
+ */
+void evtopk_sort(void* vec, int (*compar)(const void* a, const void* b));
+
+
+/**
+ * Typed selection, for each type suffix S (i32, i64, f32, f64) with item type
+ * T. These compare items inline, rather than calling a comparison function,
+ * and sort in ascending order.
+ *
+ * void evnth_S(T* vec, size_t k)           As evnth().
+ * void evpartial_sort_S(T* vec, size_t k)  As evpartial_sort().
+ * T* evtopk_push_S(T* vec, T value, size_t k)
+ *                                          As evtopk_push(), the vector may be
+ *                                          NULL and may move.
+ * void evtopk_sort_S(T* vec)               As evtopk_sort().
+ *
+ * The slot size of each vector must be sizeof(T). The order is undefined if a
+ * floating point vector holds NaNs.
+ * failure:     If EV_HARD_EXIT is enabled, these functions may cause exit();
+ */
+#define _EV_SELECT_DECL(S, T, A) \
+    void evnth_##S(T* vec, size_t k); \
+    void evpartial_sort_##S(T* vec, size_t k); \
+    T* evtopk_push_##S(T* vec, T value, size_t k); \
+    void evtopk_sort_##S(T* vec);
+_EV_NUM_TYPES(_EV_SELECT_DECL)
+#endif
+
+
+/*
+ * Implementation!
+ * ============================================================================
+ */
+
+
+#if EV_PEDANTIC
+#define ifp(p,e) if(p){e}
+#else
+#define ifp(p,e)
+#endif
+
+
+#ifndef EV_HONLY
+/*
+ * When building with multiple .c files, you only need one instance of the EV
+ * function implementations. For all other instances, you only need the forwad
+ * declaration headers. In these cases, be sure to define EV_HONLY before
+ * including evec.h. This will keep the compiler happy for you. e.g.
+ *
+ * #define EV_FHONLY
+ * #include "evec.h"
+ */
+
+
+#define EV_DU_HDR(hdr) _evdumphdr(__LINE__, __FILE__, __FUNCTION__, hdr)
 void _evdumphdr(int ln, char* fn, const char* fu, evhd_t* hdr)
 {
-    dprintf(STDERR_FILENO,"[HEADER :   %s:%i:%s()] ", basename(fn), ln, fu);
-    dprintf(STDERR_FILENO,"magic1: %s, ", hdr->magic1);
-    dprintf(STDERR_FILENO,"slt_size: %" PRId64 ", ", hdr->slt_size);
-    dprintf(STDERR_FILENO,"slt_count: %" PRId64 ", ", hdr->slt_count);
-    dprintf(STDERR_FILENO,"obj_count: %" PRId64 ", ", hdr->obj_count);
-    dprintf(STDERR_FILENO,"magic2: %s\n", hdr->magic2);
+    dprintf(STDERR_FILENO,"[HEADER :   %s:%i:%s()] ", basename(fn), ln, fu);
+#if EV_COMPACT
+    dprintf(STDERR_FILENO,"slt_size: %" PRId32 ", ", hdr->slt_size);
+    dprintf(STDERR_FILENO,"slt_count: %" PRId32 ", ", hdr->slt_count);
+    dprintf(STDERR_FILENO,"obj_count: %" PRId32 ", ", hdr->obj_count);
+    dprintf(STDERR_FILENO,"flags: 0x%" PRIx16 ", ", hdr->flags);
+    dprintf(STDERR_FILENO,"magic: 0x%" PRIx16 "\n", hdr->magic);
+#else
+    dprintf(STDERR_FILENO,"magic1: %s, ", hdr->magic1);
+    dprintf(STDERR_FILENO,"slt_size: %" PRId64 ", ", hdr->slt_size);
+    dprintf(STDERR_FILENO,"slt_count: %" PRId64 ", ", hdr->slt_count);
+    dprintf(STDERR_FILENO,"obj_count: %" PRId64 ", ", hdr->obj_count);
+    dprintf(STDERR_FILENO,"flags: 0x%" PRIx64 ", ", hdr->flags);
+    dprintf(STDERR_FILENO,"magic2: %s\n", hdr->magic2);
+#endif
+}
+
+/*
+ * This debugging code liberally borrowed and adapted from libchaste by
+ * M.Grosvenor BSD 3 clause license. https://github.com/mgrosvenor/libchaste
+ */
+typedef enum {
+    EV_MSG_DBG,
+    EV_MSG_WARN,
+    EV_MSG_ERR,
+} evdbg_e;
+
+#define EV_FAIL( /*format, args*/...)  everr_helper(__VA_ARGS__, "")
+#define everr_helper(format, ...) _evmsg(EV_MSG_ERR, __LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
+#define EV_WARN( /*format, args*/...)  evwarn_helper(__VA_ARGS__, "")
+#define evwarn_helper(format, ...) _evmsg(EV_MSG_WARN,__LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
+
+#if EV_DEBUG
+#define EV_DBG( /*format, args*/...)  evdebug_helper(__VA_ARGS__, "")
+    #define evdebug_helper(format, ...) _evmsg(EV_MSG_DBG,__LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
+#else
+#define EV_DBG( /*format, args*/...)
+#endif
+
+
+static inline void _evmsg(evdbg_e mode, int ln, char* fn, const char* fu, const char* msg, ... )
+{
+    va_list args;
+    va_start(args,msg);
+    char* mode_str = NULL;
+    switch(mode){
+        case EV_MSG_ERR:   mode_str = "Error  :"; break;
+        case EV_MSG_DBG:   mode_str = "Debug  :"; break;
+        case EV_MSG_WARN:  mode_str = "Warning:"; break;
+    }
+    dprintf(STDERR_FILENO,"[%s %s:%i:%s()]  ", mode_str, basename(fn), ln, fu);
+    vdprintf(STDERR_FILENO,msg,args);
+
+    if(mode == EV_MSG_ERR && EV_HARD_EXIT){
+        exit(0xDEAD);
+    }
+    va_end(args);
+}
+
+
+#if EV_REGISTRY
+#include <pthread.h>
+
+evext_t* _evst_head;
+pthread_mutex_t _evst_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#if !EV_COMPACT
+//Internal function, find the extension block of a vector, making it if needed
+static inline evext_t* _evext(evhd_t* hdr)
+{
+    if(hdr->ext){
+        return hdr->ext;
+    }
+
+    //Other processes would see a pointer into this one
+    ifp(hdr->flags & EV_FLAG_SHM,
+        EV_FAIL("Shared memory vectors cannot have per vector state\n");
+        return NULL;
+    );
+
+    evext_t* ext = (evext_t*)calloc(1, sizeof(evext_t));
+    ifp(!ext,
+        EV_FAIL("No memory for the extension block, %zuB\n", sizeof(evext_t));
+        return NULL;
+    );
+    ext->grw_factor = EV_GROWTH_FACTOR;
+    hdr->ext = ext;
+    return ext;
+}
+#endif
+
+#if EV_STATS
+evstats_t _evst_total;
+int _evst_fd;
+int _evst_json;
+
+#ifdef __GNUC__
+#define _EV_STAT_TOTAL(field, n) __atomic_fetch_add(&_evst_total.field, (n), __ATOMIC_RELAXED)
+
+//Internal function, raise a peak in the totals, which any thread may be
+//raising at the same time
+static inline void _evstmax(int64_t* peak, int64_t v)
+{
+    int64_t seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+    while(v > seen){
+        //On failure seen is updated to the peak another thread set
+        if(__atomic_compare_exchange_n(peak, &seen, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+            return;
+        }
+    }
+}
+#define _EV_STAT_PEAK(field, v) _evstmax(&_evst_total.field, (v))
+#else
+#define _EV_STAT_TOTAL(field, n) (_evst_total.field += (n))
+#define _EV_STAT_PEAK(field, v) do { \
+        if((v) > _evst_total.field) _evst_total.field = (v); \
+    } while(0)
+#endif
+//Vectors without an extension block (caller owned and shared) only count in
+//the totals
+#define EV_STAT_ADD(hdr, field, n) do { \
+        if((hdr)->ext) (hdr)->ext->stats.field += (n); \
+        _EV_STAT_TOTAL(field, n); \
+    } while(0)
+#define EV_STAT_MAX(hdr, field, v) do { \
+        if((hdr)->ext && (v) > (hdr)->ext->stats.field) (hdr)->ext->stats.field = (v); \
+        _EV_STAT_PEAK(field, v); \
+    } while(0)
+#else
+#define EV_STAT_ADD(hdr, field, n)
+#define EV_STAT_MAX(hdr, field, v)
+#endif
+
+#if EV_REGISTRY
+//Internal function, add a vector to the registry of live vectors. Caller owned
+//storage may be gone before the vector is freed, so it is only registered once
+//it moves to the heap.
+static void _evstreg(evhd_t* hdr)
+{
+    if(hdr->flags & (EV_FLAG_INLINE | EV_FLAG_SHM)){
+        return;
+    }
+
+    evext_t* ext = _evext(hdr);
+    if(!ext){
+        return;
+    }
+
+    pthread_mutex_lock(&_evst_lock);
+    ext->st_hdr  = hdr;
+    ext->st_prev = NULL;
+    ext->st_next = _evst_head;
+    if(_evst_head){
+        _evst_head->st_prev = ext;
+    }
+    _evst_head = ext;
+    pthread_mutex_unlock(&_evst_lock);
+}
+
+//Internal function, remove a vector from the registry of live vectors
+static void _evstunreg(evhd_t* hdr)
+{
+    evext_t* ext = hdr->ext;
+    if(!ext || !ext->st_hdr){
+        return;
+    }
+
+    pthread_mutex_lock(&_evst_lock);
+    if(ext->st_prev){
+        ext->st_prev->st_next = ext->st_next;
+    }
+    else{
+        _evst_head = ext->st_next;
+    }
+    if(ext->st_next){
+        ext->st_next->st_prev = ext->st_prev;
+    }
+    ext->st_hdr  = NULL;
+    ext->st_prev = NULL;
+    ext->st_next = NULL;
+    pthread_mutex_unlock(&_evst_lock);
+}
+#else
+#define _evstreg(hdr)
+#define _evstunreg(hdr)
+#endif
+
+#if !EV_COMPACT
+//Internal function, drop the extension block of a vector that is going away
+static inline void _evextfree(evhd_t* hdr)
+{
+    _evstunreg(hdr);
+    free(hdr->ext);
+    hdr->ext = NULL;
+}
+#else
+#define _evextfree(hdr)
+#endif
+
+//Flags that say how a vector behaves, rather than where it lives
+#define EV_FLAG_POLICY (EV_FLAG_GRW_PAGE | EV_FLAG_GRW_USABLE | EV_FLAG_HUGETLB | EV_FLAG_HEAP4)
+
+//Internal function, give dst the same growth, incremental, NUMA and huge page
+//policy as src. Returns non-zero if there is no memory for it.
+static inline int _evextcpy(evhd_t* dst, const evhd_t* src)
+{
+    dst->flags = (dst->flags & ~EV_FLAG_POLICY) | (src->flags & EV_FLAG_POLICY);
+#if !EV_COMPACT
+    const evext_t* s = src->ext;
+    if(!s){
+        return 0;
+    }
+
+    evext_t* d = _evext(dst);
+    if(!d){
+        return -1;
+    }
+    d->grw_factor  = s->grw_factor;
+    d->grw_limit   = s->grw_limit;
+    d->grw_step    = s->grw_step;
+    d->inc_bytes   = s->inc_bytes;
+    d->numa_policy = s->numa_policy;
+    d->numa_node   = s->numa_node;
+    d->hp_limit    = s->hp_limit;
+#endif
+    return 0;
+}
+
+//Internal function, find where the header goes in a block starting at base so
+//that the slots following it are aligned
+static inline evhd_t* _evplace(char* base, size_t alignment)
+{
+    if(!alignment){
+        return (evhd_t*)base;
+    }
+
+    const uintptr_t slots = ((uintptr_t)base + EV_HDR_BYTES + alignment - 1) / alignment * alignment;
+    return (evhd_t*)(slots - EV_HDR_BYTES);
+}
+
+//Internal function, fill in a zeroed header
+static inline void _evhdrinit(evhd_t* hdr, size_t slt_size, size_t count, int64_t flags)
+{
+    hdr->slt_size   = slt_size;
+    hdr->slt_count  = count;
+    hdr->obj_count  = 0;
+    hdr->flags      = flags;
+#if EV_COMPACT
+    hdr->magic      = EV_MAGIC_COMPACT;
+#else
+    memcpy(hdr->magic1,EV_MAGIC1,sizeof(hdr->magic1));
+    memcpy(hdr->magic2,EV_MAGIC2,sizeof(hdr->magic2));
+#endif
+
+    _evstreg(hdr);
+    EV_STAT_MAX(hdr, peak_slots, (int64_t)count);
+}
+
+#if defined EV_FCACHE || defined EV_FALL
+#include <pthread.h>
+
+//Internal struct, a free block in the cache
+typedef struct _evcblk {
+    struct _evcblk* next;
+} _evcblk_t;
+
+//Internal struct, one thread's cache
+typedef struct {
+    _evcblk_t* heads[EV_CACHE_CLASSES];
+    size_t counts[EV_CACHE_CLASSES];
+    size_t max_blocks;
+    size_t max_bytes;
+    evcache_stats_t stats;
+} _evcache_t;
+
+static __thread _evcache_t _evcache;
+static pthread_key_t _evcache_key;
+static pthread_once_t _evcache_once = PTHREAD_ONCE_INIT;
+
+//Internal function, the smallest size class that holds bytes
+static inline size_t _evcacheceil(size_t bytes)
+{
+    size_t c = 0;
+    while(c < EV_CACHE_CLASSES - 1 && ((size_t)1 << c) < bytes){
+        c++;
+    }
+    return c;
+}
+
+//Internal function, get a block of at least *bytes from the cache, or NULL.
+//While the cache is on, *bytes is rounded up to its size class, so that the
+//block comes back to the same class when it is freed, even on a miss.
+static void* _evcacheget(size_t* bytes)
+{
+    _evcache_t* cache = &_evcache;
+    if(!cache->max_blocks){
+        return NULL;
+    }
+
+    const size_t c = _evcacheceil(*bytes);
+    if(((size_t)1 << c) > cache->max_bytes || ((size_t)1 << c) < *bytes){
+        return NULL;
+    }
+    *bytes = (size_t)1 << c;
+
+    _evcblk_t* blk = cache->heads[c];
+    if(!blk){
+        cache->stats.misses++;
+        return NULL;
+    }
+
+    cache->heads[c] = blk->next;
+    cache->counts[c]--;
+    cache->stats.hits++;
+    cache->stats.blocks--;
+    cache->stats.bytes -= *bytes;
+    return blk;
+}
+
+//Internal function, keep a block of at least bytes in the cache. Returns 0 if
+//it was kept, or -1 if the caller should free() it.
+static int _evcacheput(void* base, size_t bytes)
+{
+    _evcache_t* cache = &_evcache;
+    if(!cache->max_blocks){
+        return -1;
+    }
+
+    //Blocks can be any size, so round down to the class they can fill
+    size_t c = _evcacheceil(bytes);
+    c -= ((size_t)1 << c) > bytes && c ? 1 : 0;
+    const size_t class_bytes = (size_t)1 << c;
+    if(cache->counts[c] >= cache->max_blocks ||
+       cache->stats.bytes + class_bytes > cache->max_bytes ||
+       class_bytes < sizeof(_evcblk_t)){
+        cache->stats.drops++;
+        return -1;
+    }
+
+    _evcblk_t* blk = base;
+    blk->next = cache->heads[c];
+    cache->heads[c] = blk;
+    cache->counts[c]++;
+    cache->stats.puts++;
+    cache->stats.blocks++;
+    cache->stats.bytes += class_bytes;
+    return 0;
+}
+
+//Internal function, the block of a vector, if it can go in the cache
+static inline int _evcacheable(evhd_t* hdr)
+{
+    if(hdr->flags & EV_FLAG_INLINE || (char*)hdr != EV_BASE(hdr) || EV_ALIGN(hdr)){
+        return 0;
+    }
+#if defined EV_FHUGE || defined EV_FALL
+    if(EV_EXTGET(hdr, map_bytes)){
+        return 0;
+    }
+#endif
+#if defined EV_FINCR || defined EV_FALL
+    if(EV_EXTGET(hdr, inc_hdr)){
+        return 0;
+    }
+#endif
+#if defined EV_FNUMA || defined EV_FALL
+    //The pages are bound by the policy, which the next user would inherit
+    if(EV_EXTGET(hdr, numa_policy)){
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+size_t evcache_flush(void)
+{
+    _evcache_t* cache = &_evcache;
+    const size_t bytes = cache->stats.bytes;
+    for(size_t c = 0; c < EV_CACHE_CLASSES; c++){
+        while(cache->heads[c]){
+            _evcblk_t* blk = cache->heads[c];
+            cache->heads[c] = blk->next;
+            free(blk);
+        }
+        cache->counts[c] = 0;
+    }
+    cache->stats.blocks = 0;
+    cache->stats.bytes  = 0;
+    return bytes;
+}
+
+//Internal function, flush the cache of a thread that is exiting
+static void _evcacheexit(void* arg)
+{
+    (void)arg;
+    evcache_flush();
+}
+
+static void _evcacheinit(void)
+{
+    pthread_key_create(&_evcache_key, _evcacheexit);
+}
+
+void evcache_limits(size_t max_blocks, size_t max_bytes)
+{
+    _evcache_t* cache = &_evcache;
+    if(!max_blocks || !max_bytes){
+        cache->max_blocks = 0;
+        cache->max_bytes  = 0;
+        evcache_flush();
+        return;
+    }
+
+    //Lower limits may not hold what is there now
+    if(max_blocks < cache->max_blocks || max_bytes < cache->max_bytes){
+        evcache_flush();
+    }
+
+    //Anything to hold means there is something to flush at exit
+    pthread_once(&_evcache_once, _evcacheinit);
+    pthread_setspecific(_evcache_key, cache);
+
+    cache->max_blocks = max_blocks;
+    cache->max_bytes  = max_bytes;
+}
+
+void evcache_stats(evcache_stats_t* stats)
+{
+    ifp(!stats,
+        EV_FAIL("Cannot get cache stats into NULL\n");
+        return;
+    );
+
+    *stats = _evcache.stats;
+}
+#endif
+
+#if EV_COMPACT
+//Internal function, the most slots of slt_size that a compact vector can hold
+static inline size_t _evcompactslts(size_t slt_size)
+{
+    return slt_size ? EV_COMPACT_MAX / slt_size : EV_COMPACT_MAX;
+}
+#endif
+
+//Internal function, make a vector. With fresh set, the block always comes from
+//malloc() and only the header is zeroed, so that the slots are first touched
+//by the caller (eg. after setting a NUMA policy), who must fill all of them.
+static void* _evini(size_t slt_size, size_t count, int fresh)
+{
+#if EV_COMPACT
+    if(count > _evcompactslts(slt_size)){
+        EV_FAIL("Compact vectors hold at most %" PRId32 "B, not %zu slots of %zuB\n",
+                EV_COMPACT_MAX, count, slt_size);
+        return NULL;
+    }
+#endif
+
+    size_t store_bytes  = count * slt_size;
+    size_t full_bytes = EV_HDR_BYTES + store_bytes;
+
+    evhd_t *hdr = NULL;
+#if defined EV_FCACHE || defined EV_FALL
+    if(!fresh){
+        hdr = _evcacheget(&full_bytes);
+    }
+    if(slt_size){
+        //The block may have been rounded up, so use all of it
+        count = (full_bytes - EV_HDR_BYTES) / slt_size;
+#if EV_COMPACT
+        count = count < _evcompactslts(slt_size) ? count : _evcompactslts(slt_size);
+#endif
+    }
+    if(!hdr)
+#endif
+    hdr = (evhd_t*)malloc(full_bytes);
+    ifp(!hdr,
+        EV_FAIL("No memory to init vector with %" PRId64 "B\n", full_bytes);
+                return NULL;
+    );
+
+
+    memset(hdr,0x00,fresh ? EV_HDR_BYTES : full_bytes);
+    _evhdrinit(hdr, slt_size, count, 0);
+
+    void *vec_start = (char*)hdr + EV_HDR_BYTES;
+    return vec_start;
+}
+
+void* evini(size_t slt_size, size_t count)
+{
+    return _evini(slt_size, count, 0);
+}
+
+#if defined EV_FALIGN || defined EV_FALL
+//Internal function, make an aligned vector, with fresh as for _evini()
+static void* _evini_aligned(size_t slt_size, size_t count, size_t alignment, int fresh)
+{
+    ifp(!alignment || (alignment & (alignment - 1)),
+        EV_FAIL("Alignment (%zu) must be a power of 2\n", alignment);
+        return NULL;
+    );
+
+    if(alignment <= EV_ALIGNOF(align)){
+        //malloc() already does this for us
+        return _evini(slt_size, count, fresh);
+    }
+
+    const size_t store_bytes  = count * slt_size;
+    const size_t full_bytes   = EV_HDR_BYTES + store_bytes;
+
+    char* base = malloc(full_bytes + alignment - 1);
+    ifp(!base,
+        EV_FAIL("No memory to init vector with %" PRId64 "B\n", full_bytes + alignment - 1);
+        return NULL;
+    );
+
+    evhd_t *hdr = _evplace(base, alignment);
+    memset(hdr,0x00,fresh ? EV_HDR_BYTES : full_bytes);
+    _evhdrinit(hdr, slt_size, count, 0);
+    evext_t* ext = _evext(hdr);
+    if(!ext){
+        free(base);
+        return NULL;
+    }
+    ext->align      = alignment;
+    ext->base_off   = (char*)hdr - base;
+
+    void *vec_start = (char*)hdr + EV_HDR_BYTES;
+    return vec_start;
+}
+
+void* evini_aligned(size_t slt_size, size_t count, size_t alignment)
+{
+    return _evini_aligned(slt_size, count, alignment, 0);
+}
+#endif
+
+#if defined EV_FBUF || defined EV_FALL
+void* evinibuf(void* buf, size_t buf_bytes, size_t slt_size)
+{
+    ifp(!buf,
+        EV_FAIL("Cannot init vector in a NULL buffer\n");
+        return NULL;
+    );
+
+    ifp((uintptr_t)buf % EV_ALIGNOF(align),
+        EV_FAIL("Buffer must be aligned to %zuB\n", EV_ALIGNOF(align));
+        return NULL;
+    );
+
+    ifp(buf_bytes < EV_HDR_BYTES,
+        EV_FAIL("Buffer (%zuB) is too small to hold vector header (%zuB)\n",
+                buf_bytes, EV_HDR_BYTES);
+        return NULL;
+    );
+
+    ifp(slt_size == 0,
+        EV_FAIL("Slot size cannot be zero\n");
+        return NULL;
+    );
+
+    size_t count = (buf_bytes - EV_HDR_BYTES) / slt_size;
+#if EV_COMPACT
+    count = count < _evcompactslts(slt_size) ? count : _evcompactslts(slt_size);
+#endif
+
+    evhd_t *hdr = (evhd_t*)buf;
+    memset(hdr,0x00,EV_HDR_BYTES);
+    _evhdrinit(hdr, slt_size, count, EV_FLAG_INLINE);
+
+    void *vec_start = (char*)hdr + EV_HDR_BYTES;
+    return vec_start;
+}
+#endif
+
+//Check that the EV header is sane
+int _evhdrcheck(evhd_t* hdr)
+{
+#if EV_COMPACT
+    if(hdr->magic != EV_MAGIC_COMPACT){
+        EV_FAIL("Header magic should be 0x%x but found 0x%x\n", EV_MAGIC_COMPACT, hdr->magic);
+        return -1;
+    }
+#else
+    if(strncmp(hdr->magic1, EV_MAGIC1, sizeof(EV_MAGIC1)) != 0){
+        EV_FAIL("Header magic 1 should be '%s' but found '%.*s'\n", EV_MAGIC1, sizeof(EV_MAGIC1), hdr->magic1);
+        return -1;
+    };
+    if(strncmp(hdr->magic2, EV_MAGIC2, sizeof(EV_MAGIC2)) != 0){
+        EV_FAIL("Header magic 2 should be '%s' but found '%.*s'\n", EV_MAGIC2, sizeof(EV_MAGIC2), hdr->magic2);
+        return -1;
+    };
+
+    if(hdr->index < 0){
+        EV_FAIL("Index value cannot be less than zero!\n");
+        return -1;
+    }
+#endif
+
+    if(hdr->obj_count < 0){
+        EV_FAIL("Object count cannot be less than zero!\n");
+        return -1;
+    }
+
+    if(hdr->slt_count < 0){
+        EV_FAIL("Slot count cannot be less than zero\n");
+        return -1;
+    }
+
+    if(hdr->obj_count > hdr->slt_count){
+        EV_FAIL("More items in vector (%" PRId64 ") than there is space (%" PRId64 ")\n",
+                (int64_t)hdr->obj_count,
+                (int64_t)hdr->slt_count);
+        return -1;
+    }
+
+    if(hdr->slt_size < 0){
+        EV_FAIL("Slot size cannot be less than zero\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+#if defined EV_FGROW || defined EV_FALL
+#if defined __linux__
+#include <malloc.h>
+#define _evusable(p) malloc_usable_size(p)
+#elif defined __APPLE__
+#include <malloc/malloc.h>
+#define _evusable(p) malloc_size(p)
+#else
+#define _evusable(p) 0 //No way to ask, so assume there is no slack
+#endif
+#endif
+
+//Internal function, the slot count to grow to from slt_count, by a growth
+//policy (see evgrw())
+static inline size_t _evgrwnext(int64_t slt_count, double factor, int64_t limit, int64_t step)
+{
+    if(!slt_count){
+        return EV_INIT_COUNT;
+    }
+
+    if(limit && slt_count >= limit){
+        return slt_count + step;
+    }
+
+    const size_t slts = (size_t)(slt_count * factor);
+    return slts > (size_t)slt_count ? slts : (size_t)slt_count + 1;
+}
+
+//Internal function, work out how many slots the vector should grow to
+static inline size_t _evgrwslts(evhd_t* hdr)
+{
+#if defined EV_FGROW || defined EV_FALL
+    const evext_t* ext = hdr->ext;
+    if(ext){
+        return _evgrwnext(hdr->slt_count, ext->grw_factor, ext->grw_limit, ext->grw_step);
+    }
+#endif
+    return _evgrwnext(hdr->slt_count, EV_GROWTH_FACTOR, 0, 0);
+}
+
+//Internal function, the bytes that slts slots take with the header, rounded up
+//to whole pages if the growth policy asks for that
+static inline size_t _evgrwbytes(evhd_t* hdr, size_t slts)
+{
+    size_t full_bytes = EV_HDR_BYTES + slts * hdr->slt_size;
+#if defined EV_FGROW || defined EV_FALL
+    if(hdr->flags & EV_FLAG_GRW_PAGE){
+        const size_t page = sysconf(_SC_PAGESIZE);
+        full_bytes = (full_bytes + page - 1) / page * page;
+    }
+#endif
+    return full_bytes;
+}
+
+#if defined EV_FHUGE || defined EV_FALL
+#include <sys/mman.h>
+#if defined __linux__
+#include <sys/syscall.h>
+
+//mremap() is only declared with _GNU_SOURCE, so go straight to the kernel
+#define EV_MREMAP_MAYMOVE 1
+#define EV_MREMAP_FIXED   2
+#define _evmremap(old, old_bytes, bytes, flags, addr) \
+    ((void*)syscall(SYS_mremap, old, old_bytes, bytes, flags, addr))
+#endif
+
+//Internal function, is this many bytes of storage big enough for huge pages
+static inline int _evhugewant(evhd_t* hdr, size_t bytes)
+{
+    const int64_t limit = EV_EXTGET(hdr, hp_limit);
+    return limit && bytes >= (size_t)limit;
+}
+
+//Internal function, map at least bytes of memory, aligned to a huge page
+static char* _evhugemap(evhd_t* hdr, size_t bytes, size_t* map_bytes)
+{
+    const size_t len = EV_ALIGN_UP(bytes, EV_HUGE_PAGE);
+
+#if defined MAP_HUGETLB
+    if(hdr->flags & EV_FLAG_HUGETLB){
+        void* p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p != MAP_FAILED){
+            *map_bytes = len;
+            return p;
+        }
+        //No huge pages reserved, so fall back to transparent huge pages
+    }
+#endif
+
+    //Map an extra huge page, so there is an aligned run inside, then trim
+    char* raw = mmap(NULL, len + EV_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED){
+        return NULL;
+    }
+
+    char* p = (char*)EV_ALIGN_UP((uintptr_t)raw, EV_HUGE_PAGE);
+    if(p > raw){
+        munmap(raw, p - raw);
+    }
+    if(raw + EV_HUGE_PAGE > p){
+        munmap(p + len, raw + EV_HUGE_PAGE - p);
+    }
+
+#if defined MADV_HUGEPAGE
+    madvise(p, len, MADV_HUGEPAGE);
+#endif
+    *map_bytes = len;
+    return p;
+}
+
+//Internal function, move the storage of a vector into a bigger huge page
+//mapping. The pages are remapped rather than copied where the kernel allows.
+//Returns the base of the new mapping, with the header in place, or NULL.
+static char* _evhugegrow(evhd_t* hdr, size_t storage_bytes, size_t bytes)
+{
+    char* const  old_base  = EV_BASE(hdr);
+    size_t map_bytes       = 0;
+
+    //Only vectors with a huge page limit get here, so they have an extension
+    evext_t* ext = hdr->ext;
+
+#if defined __linux__
+    if(ext->map_bytes){
+        const size_t old_bytes = ext->map_bytes;
+        const size_t len = EV_ALIGN_UP(bytes, EV_HUGE_PAGE);
+
+        //Grow in place if there is room after the mapping
+        if(_evmremap(old_base, old_bytes, len, 0, NULL) != MAP_FAILED){
+            ext->map_bytes = len;
+#if defined MADV_HUGEPAGE
+            madvise(old_base, len, MADV_HUGEPAGE);
+#endif
+            return old_base;
+        }
+
+        //Otherwise move the pages to a new aligned range, keeping the offset
+        char* base = _evhugemap(hdr, bytes, &map_bytes);
+        if(base && _evmremap(old_base, old_bytes, map_bytes,
+                             EV_MREMAP_MAYMOVE | EV_MREMAP_FIXED, base) != MAP_FAILED){
+            ext->map_bytes = map_bytes;
+#if defined MADV_HUGEPAGE
+            madvise(base, map_bytes, MADV_HUGEPAGE);
+#endif
+            return base;
+        }
+        if(base){
+            munmap(base, map_bytes);
+        }
+    }
+#endif
+
+    //Copy into a new mapping
+    char* base = _evhugemap(hdr, bytes, &map_bytes);
+    if(!base){
+        return NULL;
+    }
+
+    evhd_t* new_hdr = _evplace(base, EV_ALIGN(hdr));
+    memcpy(new_hdr, hdr, EV_HDR_BYTES + storage_bytes);
+    EV_STAT_ADD(new_hdr, copy_bytes, EV_HDR_BYTES + storage_bytes);
+
+    if(ext->map_bytes){
+        munmap(old_base, ext->map_bytes);
+    }
+    else if(!(hdr->flags & EV_FLAG_INLINE)){
+        free(old_base);
+    }
+
+    new_hdr->flags &= ~EV_FLAG_INLINE;
+    ext->map_bytes  = map_bytes;
+    return base;
+}
+#endif
+
+//Internal function, give back a block of memory that held a vector
+static inline void _evfreeblk(char* base, size_t map_bytes)
+{
+#if defined EV_FHUGE || defined EV_FALL
+    if(map_bytes){
+        munmap(base, map_bytes);
+        return;
+    }
+#endif
+    (void)map_bytes;
+    free(base);
+}
+
+//Internal function, give back the memory that holds a vector
+static inline void _evfreebase(evhd_t* hdr)
+{
+    _evfreeblk(EV_BASE(hdr), EV_EXTGET(hdr, map_bytes));
+}
+
+#if defined EV_FNUMA || defined EV_FALL
+#if defined __linux__
+#include <sys/syscall.h>
+#include <errno.h>
+#endif
+
+//From <numaif.h>, which is not always installed
+#define EV_MPOL_DEFAULT    0
+#define EV_MPOL_BIND       2
+#define EV_MPOL_INTERLEAVE 3
+#define EV_MPOL_MF_MOVE    (1 << 1)
+
+//Internal function, bit mask of the NUMA nodes that are online
+static uint64_t _evnumamask(void)
+{
+    static uint64_t mask = 0;
+    if(mask){
+        return mask;
+    }
+
+    uint64_t nodes = 0;
+    FILE* f = fopen("/sys/devices/system/node/online", "r");
+    if(f){
+        //A list of ranges, eg. "0-1,4"
+        char buf[256] = {0};
+        char* p = fgets(buf, sizeof(buf), f);
+        while(p && isdigit((unsigned char)*p)){
+            long lo = strtol(p, &p, 10);
+            long hi = lo;
+            if(*p == '-'){
+                hi = strtol(p + 1, &p, 10);
+            }
+            for(long n = lo; n <= hi && n < 64; n++){
+                nodes |= 1ULL << n;
+            }
+            p = *p == ',' ? p + 1 : NULL;
+        }
+        fclose(f);
+    }
+
+    //No NUMA information, so everything is on node 0
+    mask = nodes ? nodes : 1;
+    return mask;
+}
+
+//Internal function, apply the NUMA policy of a vector to part of its storage.
+//Only whole pages are bound, since the rest may belong to someone else.
+static void _evnumabind(evhd_t* hdr, void* start, size_t bytes, int flags)
+{
+#if defined __linux__
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    const uintptr_t lo   = ((uintptr_t)start + page - 1) / page * page;
+    const uintptr_t hi   = ((uintptr_t)start + bytes) / page * page;
+    if(hi <= lo){
+        return;
+    }
+
+    unsigned long mask = 0;
+    int mode = EV_MPOL_DEFAULT;
+    switch(EV_EXTGET(hdr, numa_policy)){
+    case EV_NUMA_INTERLEAVE: mode = EV_MPOL_INTERLEAVE; mask = _evnumamask(); break;
+    case EV_NUMA_BIND:       mode = EV_MPOL_BIND;       mask = 1UL << hdr->ext->numa_node; break;
+    }
+
+    if(syscall(SYS_mbind, lo, hi - lo, mode, mode ? &mask : NULL, sizeof(mask) * 8, mode ? flags : 0)){
+        //Most likely no NUMA support, in which case there is nothing to do
+        EV_DBG("mbind() failed (%s), pages stay where they are\n", strerror(errno));
+    }
+#endif
+}
+#endif
+
+#if defined EV_FINCR || defined EV_FALL
+//Internal function, copy the items in [lo, hi) that were copied into the new
+//storage already into it again, after they changed in place. The rest are
+//copied later anyway.
+static void _evincsync(evhd_t* hdr, void* vec, int64_t lo, int64_t hi)
+{
+    const evext_t* ext = hdr->ext;
+    if(!EV_EXTGET(hdr, inc_hdr)){
+        return;
+    }
+
+    char* const new_data = (char*)ext->inc_hdr + EV_HDR_BYTES;
+    hi = hi < hdr->obj_count ? hi : hdr->obj_count;
+    const int64_t ranges[2][2] = {
+        { lo, hi < ext->inc_moved ? hi : ext->inc_moved },
+        { lo > ext->inc_split ? lo : ext->inc_split, hi },
+    };
+    for(int r = 0; r < 2; r++){
+        const int64_t n = ranges[r][1] - ranges[r][0];
+        if(n > 0){
+            memcpy(new_data + hdr->slt_size * ranges[r][0],
+                   (char*)vec + hdr->slt_size * ranges[r][0],
+                   hdr->slt_size * n);
+            EV_STAT_ADD(hdr, copy_bytes, hdr->slt_size * n);
+        }
+    }
+}
+
+//Internal function, sync item i of a heap with d children per item and its
+//parents up to item top, which are the only ones that sifting changes
+static inline void _evincpath(evhd_t* hdr, void* vec, size_t i, size_t top, size_t d)
+{
+    if(!EV_EXTGET(hdr, inc_hdr)){
+        return;
+    }
+
+    for(;;){
+        _evincsync(hdr, vec, i, i + 1);
+        if(i <= top){
+            return;
+        }
+        i = (i - 1) / d;
+    }
+}
+
+//Internal function, copy up to items more items into the new storage
+static void _evincmove(evhd_t* hdr, void* vec, int64_t items)
+{
+    evext_t* ext = hdr->ext;
+    const int64_t end  = ext->inc_split < hdr->obj_count ? ext->inc_split : hdr->obj_count;
+    const int64_t todo = end - ext->inc_moved;
+    if(todo <= 0){
+        return;
+    }
+
+    const int64_t n = todo < items ? todo : items;
+    memcpy((char*)ext->inc_hdr + EV_HDR_BYTES + hdr->slt_size * ext->inc_moved,
+           (char*)vec + hdr->slt_size * ext->inc_moved,
+           hdr->slt_size * n);
+    ext->inc_moved += n;
+    EV_STAT_ADD(hdr, copy_bytes, hdr->slt_size * n);
+}
+
+//Internal function, copy whatever is left and hand over to the new storage.
+//Returns the new vector pointer.
+static void* _evincfinish(evhd_t* hdr, void* vec)
+{
+    evext_t* ext = hdr->ext;
+    evhd_t* new_hdr = ext->inc_hdr;
+    char* const old_base = EV_BASE(hdr);
+    const int64_t old_map_bytes = ext->map_bytes;
+    const int64_t old_inline = hdr->flags & EV_FLAG_INLINE;
+
+    _evincmove(hdr, vec, INT64_MAX);
+
+    //Array notation and evidx() write straight to the old storage, so an item
+    //changed that way after it was copied would be lost here
+    ifp(memcmp((char*)new_hdr + EV_HDR_BYTES, vec, hdr->slt_size * hdr->obj_count),
+        EV_FAIL("Items were changed without the ev functions while growing incrementally\n");
+        memcpy((char*)new_hdr + EV_HDR_BYTES, vec, hdr->slt_size * hdr->obj_count);
+    );
+
+    _evstunreg(hdr);
+    memcpy(new_hdr, hdr, EV_HDR_BYTES);
+    new_hdr->flags    &= ~EV_FLAG_INLINE;
+    new_hdr->slt_count = ext->inc_slt_count;
+    ext->base_off      = ext->inc_base_off;
+    ext->map_bytes     = ext->inc_map_bytes;
+    ext->inc_hdr       = NULL;
+    ext->inc_slt_count = 0;
+    ext->inc_split     = 0;
+    ext->inc_moved     = 0;
+    ext->inc_base_off  = 0;
+    ext->inc_map_bytes = 0;
+    _evstreg(new_hdr);
+    EV_STAT_MAX(new_hdr, peak_slots, new_hdr->slt_count);
+
+    if(!old_inline){
+        _evfreeblk(old_base, old_map_bytes);
+    }
+
+    return (char*)new_hdr + EV_HDR_BYTES;
+}
+
+//Internal function, make the storage to grow into. The vector itself does not
+//change, the new storage only takes over in _evincfinish().
+static int _evincgrow(evhd_t* hdr)
+{
+    //Only vectors with an incremental limit get here, so they have an extension
+    evext_t* ext = hdr->ext;
+    const size_t alignment = EV_ALIGN(hdr);
+    const size_t pad_bytes = alignment ? alignment - 1 : 0;
+
+    //The next growth starts once the free slots are only just enough to copy
+    //every item at the per push limit, so leave at least that many. A small
+    //step (eg. from evgrw() with a step of 1) would not.
+    const size_t per_push = ext->inc_bytes / hdr->slt_size ? ext->inc_bytes / hdr->slt_size : 1;
+    const size_t min_slts = hdr->slt_count + (hdr->slt_count + per_push - 1) / per_push;
+    size_t new_slt_count  = _evgrwslts(hdr);
+    new_slt_count         = new_slt_count > min_slts ? new_slt_count : min_slts;
+    size_t full_bytes     = _evgrwbytes(hdr, new_slt_count);
+
+    //No memset() here. Touching all of the new memory up front is exactly the
+    //stall that this is meant to avoid.
+    char* base = NULL;
+    size_t map_bytes = 0;
+#if defined EV_FHUGE || defined EV_FALL
+    if(_evhugewant(hdr, full_bytes + pad_bytes)){
+        base = _evhugemap(hdr, full_bytes + pad_bytes, &map_bytes);
+    }
+    else
+#endif
+    base = malloc(full_bytes + pad_bytes);
+    if(!base){
+        EV_FAIL("No memory to grow vector up to %" PRId64 "B\n", full_bytes + pad_bytes);
+        return -1;
+    }
+
+    evhd_t* new_hdr = _evplace(base, alignment);
+    ext->inc_base_off  = (char*)new_hdr - base;
+    ext->inc_map_bytes = map_bytes;
+#if defined EV_FNUMA || defined EV_FALL
+    if(ext->numa_policy){
+        _evnumabind(hdr, (char*)new_hdr + EV_HDR_BYTES, full_bytes - EV_HDR_BYTES, 0);
+    }
+#endif
+
+#if defined EV_FHUGE || defined EV_FALL
+    if(map_bytes){
+        //Use the rest of the last huge page
+        full_bytes = map_bytes - ((char*)new_hdr - base);
+    }
+    else
+#endif
+#if defined EV_FGROW || defined EV_FALL
+    if(hdr->flags & EV_FLAG_GRW_USABLE){
+        const size_t usable_bytes = _evusable(base) - ((char*)new_hdr - base);
+        full_bytes = usable_bytes > full_bytes ? usable_bytes : full_bytes;
+    }
+#endif
+
+    ext->inc_hdr       = new_hdr;
+    ext->inc_slt_count = (full_bytes - EV_HDR_BYTES) / hdr->slt_size;
+    ext->inc_split     = hdr->obj_count;
+    ext->inc_moved     = 0;
+
+    EV_STAT_ADD(hdr, grows, 1);
+#if EV_TRACE
+    ext->tr_grows++;
+#endif
+
+    return 0;
+}
+
+//Internal function, after items from lo on were added to the end, sync them,
+//and pay off a little more of the copying. Without a growth in progress, start
+//one if the free slots only just leave enough pushes to copy every item.
+static void _evincpush(evhd_t* hdr, void* vec, int64_t lo)
+{
+    evext_t* ext = hdr->ext;
+    if(!ext || hdr->flags & (EV_FLAG_RCU | EV_FLAG_SHM)){
+        return;
+    }
+
+    const int64_t by_bytes = ext->inc_bytes / hdr->slt_size;
+    const int64_t per_push = by_bytes > 0 ? by_bytes : 1;
+    if(ext->inc_hdr){
+        _evincsync(hdr, vec, lo, hdr->obj_count);
+    }
+    else{
+        //Vectors that fit in one push's worth of copying just grow normally
+        const int64_t free_slts = hdr->slt_count - hdr->obj_count;
+        if(!ext->inc_bytes || hdr->slt_count <= per_push ||
+           (free_slts - 1) * per_push > hdr->obj_count || _evincgrow(hdr)){
+            return;
+        }
+    }
+
+    _evincmove(hdr, vec, per_push * (hdr->obj_count - lo));
+}
+#else
+#define _evincsync(hdr, vec, lo, hi) ((void)(hdr), (void)(vec), (void)(lo), (void)(hi))
+#define _evincpath(hdr, vec, i, top, d) ((void)(hdr), (void)(vec), (void)(i), (void)(top), (void)(d))
+#define _evincpush(hdr, vec, lo) ((void)(hdr), (void)(vec), (void)(lo))
+#endif
+
+//Internal function, grow the vector backing store memory to at least min_slts
+//slots, or by the growth policy if that is more
+static void* _evgrowto(void* vec, size_t min_slts)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot grow an empty vector!\n");
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+                return NULL;
+    );
+
+    if(hdr->flags & EV_FLAG_SHM){
+        EV_FAIL("Shared memory vectors can only grow with evshpush()\n");
+        return NULL;
+    }
+
+    if(hdr->flags & EV_FLAG_RCU){
+        EV_FAIL("Epoch vectors can only grow with evrcpush()\n");
+        return NULL;
+    }
+
+#if defined EV_FINCR || defined EV_FALL
+    if(EV_EXTGET(hdr, inc_hdr)){
+        //The pushes so far have copied most of the items already
+        vec = _evincfinish(hdr, vec);
+        hdr = EV_HDR(vec);
+        if(hdr->slt_count >= (int64_t)min_slts && hdr->obj_count < hdr->slt_count){
+            return vec;
+        }
+    }
+#endif
+
+    const size_t storage_bytes      = hdr->slt_size * hdr->slt_count;
+    size_t new_slt_count            = _evgrwslts(hdr);
+    new_slt_count                   = new_slt_count > min_slts ? new_slt_count : min_slts;
+#if EV_COMPACT
+    const size_t max_slts           = _evcompactslts(hdr->slt_size);
+    new_slt_count                   = new_slt_count < max_slts ? new_slt_count : max_slts;
+    if(new_slt_count <= (size_t)hdr->slt_count || new_slt_count < min_slts){
+        EV_FAIL("Compact vectors hold at most %" PRId32 "B\n", EV_COMPACT_MAX);
+        return NULL;
+    }
+#endif
+    size_t full_bytes               = _evgrwbytes(hdr, new_slt_count);
+
+    //Aligned vectors need some extra room to slide the header along
+    const size_t alignment  = EV_ALIGN(hdr);
+    const size_t pad_bytes  = alignment ? alignment - 1 : 0;
+    char* base              = NULL;
+
+    //The header may move, so take it out of the registry while that happens
+    _evstunreg(hdr);
+
+#if defined EV_FHUGE || defined EV_FALL
+    if(EV_EXTGET(hdr, map_bytes) || _evhugewant(hdr, full_bytes + pad_bytes)){
+        base = _evhugegrow(hdr, storage_bytes, full_bytes + pad_bytes);
+        if (!base){
+            EV_FAIL("No memory to map vector up to %" PRId64 "B\n", full_bytes + pad_bytes);
+            _evstreg(hdr);
+            return NULL;
+        }
+        hdr = _evplace(base, alignment);
+    }
+    else
+#endif
+    if(hdr->flags & EV_FLAG_INLINE){
+        //Move out of the caller's storage and onto the heap
+#if defined EV_FCACHE || defined EV_FALL
+        if(!alignment){
+            base = _evcacheget(&full_bytes);
+        }
+        if(!base)
+#endif
+        base = malloc(full_bytes + pad_bytes);
+        if (!base){
+            EV_FAIL("No memory to grow vector up to %" PRId64 "B\n", full_bytes + pad_bytes);
+            _evstreg(hdr);
+            return NULL;
+        }
+        evhd_t* heap_hdr = _evplace(base, alignment);
+        memcpy(heap_hdr, hdr, EV_HDR_BYTES + storage_bytes);
+        hdr = heap_hdr;
+        hdr->flags &= ~EV_FLAG_INLINE;
+        EV_STAT_ADD(hdr, copy_bytes, EV_HDR_BYTES + storage_bytes);
+    }
+    else{
+        const size_t base_off = (char*)hdr - EV_BASE(hdr);
+        char* const old_base  = EV_BASE(hdr);
+#if defined EV_FCACHE || defined EV_FALL
+        //Swap blocks with the cache if it has one of the right size, which
+        //saves the realloc()
+        if(_evcacheable(hdr)){
+            base = _evcacheget(&full_bytes);
+            if(base){
+                memcpy(base, old_base, EV_HDR_BYTES + storage_bytes);
+                if(_evcacheput(old_base, EV_HDR_BYTES + storage_bytes)){
+                    free(old_base);
+                }
+            }
+        }
+        if(!base)
+#endif
+        base = realloc(old_base, full_bytes + pad_bytes);
+        if (!base){
+            EV_FAIL("No memory to grow vector up to %" PRId64 "B\n", full_bytes + pad_bytes);
+            _evstreg(hdr);
+            return NULL;
+        }
+
+        //realloc() only keeps malloc() alignment, so the slots may need to move
+        hdr = _evplace(base, alignment);
+        if((char*)hdr != base + base_off){
+            memmove(hdr, base + base_off, EV_HDR_BYTES + storage_bytes);
+            EV_STAT_ADD(hdr, copy_bytes, EV_HDR_BYTES + storage_bytes);
+        }
+        if(base != old_base){
+            EV_STAT_ADD(hdr, copy_bytes, base_off + EV_HDR_BYTES + storage_bytes);
+        }
+    }
+#if !EV_COMPACT
+    if(hdr->ext){
+        hdr->ext->base_off = (char*)hdr - base;
+    }
+#endif
+
+#if defined EV_FHUGE || defined EV_FALL
+    if(EV_EXTGET(hdr, map_bytes)){
+        //Use the rest of the last huge page
+        full_bytes = hdr->ext->map_bytes - ((char*)hdr - base);
+    }
+    else
+#endif
+#if defined EV_FGROW || defined EV_FALL
+    if(hdr->flags & EV_FLAG_GRW_USABLE){
+        const size_t usable_bytes = _evusable(base) - ((char*)hdr - base);
+        full_bytes = usable_bytes > full_bytes ? usable_bytes : full_bytes;
+    }
+#endif
+    new_slt_count = (full_bytes - EV_HDR_BYTES) / hdr->slt_size;
+#if EV_COMPACT
+    new_slt_count = new_slt_count < max_slts ? new_slt_count : max_slts;
+#endif
+
+#if defined EV_FNUMA || defined EV_FALL
+    if(EV_EXTGET(hdr, numa_policy)){
+        //Before the memset(), so that the new pages are first touched in place
+        _evnumabind(hdr, (char*)hdr + EV_HDR_BYTES, full_bytes - EV_HDR_BYTES, EV_MPOL_MF_MOVE);
+    }
+#endif
+
+#if defined EV_FHUGE || defined EV_FALL
+    if(!EV_EXTGET(hdr, map_bytes)) //Fresh mappings are zero already
+#endif
+    memset((char*)hdr + EV_HDR_BYTES + storage_bytes, 0x00, full_bytes - EV_HDR_BYTES - storage_bytes);
+
+    hdr->slt_count  = new_slt_count;
+
+    _evstreg(hdr);
+    EV_STAT_ADD(hdr, grows, 1);
+    EV_STAT_MAX(hdr, peak_slots, hdr->slt_count);
+#if EV_TRACE
+    if(hdr->ext){
+        hdr->ext->tr_grows++;
+    }
+#endif
+
+    void *vec_start = (char*)hdr + EV_HDR_BYTES;
+
+    return vec_start;
+}
+
+//Internal function, grow the vector backing store memory
+void* _evgrow(void* vec)
+{
+    return _evgrowto(vec, 0);
+}
+
+
+void* evpush(void* vec, void* obj, size_t obj_size)
+{
+    void* result = vec;
+    if(!vec){
+        //Get some memory
+        result = evinisz(obj_size);
+    }
+
+    evhd_t* hdr = EV_HDR(result);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+                return NULL;
+    );
+
+    //Sanity check
+    ifp(obj_size > hdr->slt_size,
+        EV_FAIL("Object size (%" PRId64 ") is larger than there is space (%" PRId64 ")\n",
+                obj_size,
+                (int64_t)hdr->slt_size);
+                return NULL;
+    );
+
+    //Enough space?
+    if(hdr->obj_count == hdr->slt_count){
+        //Get some more
+        result = _evgrow(result);
+        hdr = EV_HDR(result);
+    }
+
+    void* next_obj = ((char*)result) + hdr->slt_size * hdr->obj_count;
+    memcpy(next_obj,obj,obj_size);
+    hdr->obj_count++;
+
+    EV_STAT_ADD(hdr, pushes, 1);
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count);
+    _evincpush(hdr, result, hdr->obj_count - 1);
+
+    return result;
+}
+
+
+void* evrsv(void* vec, size_t count)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot reserve space in a NULL vector\n");
+        return NULL;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    if(count <= hdr->slt_count){
+        return vec;
+    }
+
+    return _evgrowto(vec, count);
+}
+
+
+int evpolicy(void* dst, void* src)
+{
+    ifp(!dst || !src,
+        EV_FAIL("Cannot copy the policy of a NULL vector\n");
+        return -1;
+    );
+
+    evhd_t* hdr = EV_HDR(dst);
+    evhd_t* src_hdr = EV_HDR(src);
+    ifp(_evhdrcheck(hdr) || _evhdrcheck(src_hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    if(_evextcpy(hdr, src_hdr)){
+        return -1;
+    }
+#if defined EV_FGROW || defined EV_FALL
+    //Claim the slack in dst's allocation, as growing would have done
+    if(hdr->flags & EV_FLAG_GRW_USABLE && hdr->slt_size &&
+       !(hdr->flags & (EV_FLAG_INLINE | EV_FLAG_SHM | EV_FLAG_RCU)) && !EV_EXTGET(hdr, map_bytes)){
+        const size_t usable_bytes = _evusable(EV_BASE(hdr)) - ((char*)hdr - EV_BASE(hdr));
+        const int64_t usable_slts = (usable_bytes - EV_HDR_BYTES) / hdr->slt_size;
+        hdr->slt_count = usable_slts > hdr->slt_count ? usable_slts : hdr->slt_count;
+    }
+#endif
+#if defined EV_FNUMA || defined EV_FALL
+    if(EV_EXTGET(hdr, numa_policy)){
+        _evnumabind(hdr, dst, hdr->slt_size * hdr->slt_count, EV_MPOL_MF_MOVE);
+    }
+#endif
+    return 0;
+}
+
+
+size_t evcnt(void* vec)
+{
+    if(!vec){
+        return 0;
+    };
+
+    evhd_t *hdr =  EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+                return -1;
+    );
+
+    return hdr->obj_count;
+}
+
+
+int evlayout(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot find the layout of a NULL vector\n");
+        return -1;
+    );
+
+    //The compact magic is in the last 2 bytes before the first slot. The full
+    //header ends with magic 2, then up to 8 bytes of padding.
+    const char* slots = vec;
+    uint16_t magic;
+    memcpy(&magic, slots - sizeof(magic), sizeof(magic));
+    const int compact = magic == EV_MAGIC_COMPACT;
+    const int full = !memcmp(slots - 8, EV_MAGIC2, sizeof(EV_MAGIC2)) ||
+                     !memcmp(slots - 16, EV_MAGIC2, sizeof(EV_MAGIC2));
+
+#if EV_COMPACT
+    if(compact){
+        return EV_LAYOUT_COMPACT;
+    }
+    return full ? EV_LAYOUT_FULL : -1;
+#else
+    if(full){
+        return EV_LAYOUT_FULL;
+    }
+    return compact ? EV_LAYOUT_COMPACT : -1;
+#endif
+}
+
+
+void* evidx(void* vec, size_t idx)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot get index of a NULL vector\n");
+                return NULL;
+    );
+
+    evhd_t *hdr =  EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+                return NULL;
+    );
+
+    ifp(hdr->obj_count == 0,
+        EV_FAIL("Cannot get index of empty vector\n");
+                return NULL;
+    );
+
+    ifp(idx < 0,
+        EV_FAIL("Index cannot be <0 (idx=%" PRId64 ")\n", idx);
+    );
+
+    ifp(idx > hdr->obj_count - 1,
+        EV_FAIL("Index cannot be greater than number of objects (idx=%" PRId64 " > %" PRId64 ")\n" ,
+                idx,
+                (int64_t)hdr->obj_count -1);
+    );
+
+    return (char*)vec + hdr->slt_size * idx;
+}
+
+
+void* evtail(void* vec)
+{
+    return evidx(vec,evcnt(vec) -1);
+}
+
+void* evhead(void* vec)
+{
+    ifp(!vec,
+    return NULL;
+    );
+
+    evhd_t *hdr =  EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(hdr->obj_count == 0,
+        return NULL;
+    );
+
+#if EV_COMPACT
+    return vec;
+#else
+    hdr->index = 0;
+
+    return evidx(vec,hdr->index);
+#endif
+}
+
+#if !EV_COMPACT
+void* evnext(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot get next item in a NULL vector\n");
+                return NULL;
+    );
+
+    evhd_t *hdr =  EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+                return NULL;
+    );
+
+    ifp(hdr->obj_count == 0,
+        EV_FAIL("Cannot get next item in an empty vector\n");
+                return NULL;
+    );
+
+    hdr->index++;
+    if(hdr->index >= hdr->obj_count){
+        return NULL;
+    }
+
+    return evidx(vec,hdr->index);
+
+}
+#endif
+
+void* evfree(void* vec)
+{
+    if(!vec){
+        return NULL;
+    };
+
+    if(vec){
+        evhd_t *hdr =  EV_HDR(vec);
+        ifp(_evhdrcheck(hdr),
+            EV_FAIL("Header sanity check failed\n");
+                    return NULL;
+        );
+        if(hdr->flags & EV_FLAG_SHM){
+            EV_FAIL("Shared memory vectors are freed with evshfree()\n");
+            return NULL;
+        }
+        if(hdr->flags & EV_FLAG_RCU){
+            EV_FAIL("Epoch vectors are freed with evrcfree()\n");
+            return NULL;
+        }
+        _evstunreg(hdr);
+#if !EV_COMPACT
+        evext_t* ext = hdr->ext;
+#endif
+#if defined EV_FINCR || defined EV_FALL
+        if(EV_EXTGET(hdr, inc_hdr)){
+            _evfreeblk((char*)ext->inc_hdr - ext->inc_base_off, ext->inc_map_bytes);
+        }
+#endif
+        if(!(hdr->flags & EV_FLAG_INLINE)){
+#if defined EV_FCACHE || defined EV_FALL
+            if(!_evcacheable(hdr) || _evcacheput(hdr, EV_HDR_BYTES + hdr->slt_size * hdr->slt_count))
+#endif
+            _evfreebase(hdr);
+        }
+#if !EV_COMPACT
+        free(ext);
+#endif
+    }
+
+    return NULL;
+}
+
+
+#if defined EV_FADOPT || defined EV_FALL
+void* evadopt(void* buf, size_t slt_size, size_t count, size_t capacity)
+{
+    ifp(!buf,
+        EV_FAIL("Cannot adopt a NULL buffer\n");
+        return NULL;
+    );
+
+    ifp(slt_size == 0,
+        EV_FAIL("Slot size cannot be zero\n");
+        return NULL;
+    );
+
+    ifp(count > capacity,
+        EV_FAIL("Buffer cannot hold %zu items in room for %zu\n", count, capacity);
+        return NULL;
+    );
+
+#if EV_COMPACT
+    if(capacity > _evcompactslts(slt_size)){
+        EV_FAIL("Compact vectors hold at most %" PRId32 "B, not %zu slots of %zuB\n",
+                EV_COMPACT_MAX, capacity, slt_size);
+        return NULL;
+    }
+#endif
+
+    //The items are already in place, so only the header is written
+    evhd_t* hdr = (evhd_t*)buf;
+    memset(hdr, 0x00, EV_HDR_BYTES);
+    _evhdrinit(hdr, slt_size, capacity, 0);
+    hdr->obj_count = count;
+    EV_STAT_MAX(hdr, peak_objs, (int64_t)count);
+
+    return (char*)hdr + EV_HDR_BYTES;
+}
+
+void* evrelease(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot release a NULL vector\n");
+        return NULL;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    if(hdr->flags & (EV_FLAG_SHM | EV_FLAG_RCU)){
+        EV_FAIL("Shared memory and epoch vectors cannot be released\n");
+        return NULL;
+    }
+
+#if defined EV_FHUGE || defined EV_FALL
+    if(EV_EXTGET(hdr, map_bytes)){
+        EV_FAIL("Vectors in huge pages cannot be released to free()\n");
+        return NULL;
+    }
+#endif
+
+#if defined EV_FINCR || defined EV_FALL
+    if(EV_EXTGET(hdr, inc_hdr)){
+        vec = evincfin(vec);
+        if(!vec){
+            return NULL;
+        }
+        hdr = EV_HDR(vec);
+    }
+#endif
+
+    const size_t bytes = hdr->obj_count * hdr->slt_size;
+    char* items = NULL;
+    if(hdr->flags & EV_FLAG_INLINE){
+        //The storage belongs to the caller, so it has to be copied out
+        items = malloc(bytes ? bytes : 1);
+        if(!items){
+            EV_FAIL("No memory to release vector of %zuB\n", bytes);
+            return NULL;
+        }
+        memcpy(items, vec, bytes);
+        _evextfree(hdr);
+        return items;
+    }
+
+    items = EV_BASE(hdr);
+    _evextfree(hdr);
+    memmove(items, vec, bytes);
+    return items;
+}
+#endif
+
+
+
+#if defined EV_FGROW || defined EV_FALL
+void evgrw(void* vec, double factor, size_t limit, size_t step, int64_t flags)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot set growth policy of a NULL vector\n");
+        return;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    ifp(factor <= 1.0,
+        EV_FAIL("Growth factor (%f) must be greater than 1.0\n", factor);
+        return;
+    );
+
+    ifp(limit && !step,
+        EV_FAIL("Growth step must be greater than 0 when a limit is set\n");
+        return;
+    );
+
+    ifp(flags & ~(EV_FLAG_GRW_PAGE | EV_FLAG_GRW_USABLE),
+        EV_FAIL("Unknown growth flags (0x%" PRIx64 ")\n", flags);
+        return;
+    );
+
+    evext_t* ext = _evext(hdr);
+    if(!ext){
+        return;
+    }
+
+    ext->grw_factor = factor;
+    ext->grw_limit  = limit;
+    ext->grw_step   = step;
+    hdr->flags      = (hdr->flags & ~(EV_FLAG_GRW_PAGE | EV_FLAG_GRW_USABLE)) | flags;
+}
+
+
+size_t evgrwslts(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot find the growth of a NULL vector\n");
+        return 0;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
+    );
+
+    return (_evgrwbytes(hdr, _evgrwslts(hdr)) - EV_HDR_BYTES) / hdr->slt_size;
+}
+#endif
+
+
+#if defined EV_FINCR || defined EV_FALL
+void evinc(void* vec, size_t max_bytes)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot set incremental growth on a NULL vector\n");
+        return;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    evext_t* ext = _evext(hdr);
+    if(!ext){
+        return;
+    }
+
+    ext->inc_bytes = max_bytes;
+}
+
+
+void* evincfin(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot finish growing a NULL vector\n");
+        return NULL;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    if(!EV_EXTGET(hdr, inc_hdr)){
+        return vec;
+    }
+
+    return _evincfinish(hdr, vec);
+}
+#endif
+
+
+#if defined EV_FPOP || defined EV_FALL
+void evpop(void *vec)
+{
+    ifp(!vec,
+        //Uh ohhh....
+        EV_FAIL("Cannot pop a NULL vector\n");
+        return;
+    );
+
+    evhd_t* hdr =  EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    if(hdr->obj_count)
+        hdr->obj_count--;
+
+}
+#endif
+
+
+#if defined EV_FDEL || defined EV_FALL
+void evdel(void *vec, size_t idx)
+{
+    ifp(!vec,
+        //Uh ohhh....
+        EV_FAIL("Cannot pop an empty vector\n");
+        return;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    if(hdr->obj_count == 0){
+        //Nothing to delete
+        return;
+    }
+
+    //Sanity check
+    ifp(idx < 0,
+        EV_FAIL("Vector index cannot be less than 0\n");
+        return;
+    )
+
+    ifp(idx > hdr->obj_count - 1,
+        EV_FAIL("Vector index (%lu) too large (%" PRId64")\n", idx, hdr->obj_count -1);
+        return;
+    );
+
+    void* curr_obj = (char*)vec + hdr->slt_size * (idx + 0);
+    void* next_obj = (char*)vec + hdr->slt_size * (idx + 1);
+    const size_t to_move = hdr->slt_size * (hdr->obj_count - idx - 1);
+
+    //The source and destination overlap, so this must be a memmove()
+    memmove(curr_obj,next_obj,to_move);
+    EV_STAT_ADD(hdr, del_bytes, to_move);
+
+    hdr->obj_count--;
+    _evincsync(hdr, vec, idx, hdr->obj_count);
+}
+#endif
+
+
+#if defined EV_FMEMSZ  || defined EV_FALL
+
+size_t evvsz(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot get size of a NULL vector\n");
+        return -1;
+    );
+
+    evhd_t *hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    return hdr->slt_count;
+}
+
+
+size_t evvmem(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot get size of a NULL vector\n");
+        return -1;
+    );
+
+    evhd_t *hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    return hdr->slt_count * hdr->slt_size;
+}
+
+
+size_t evomem(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot get size of a NULL vector\n");
+        return -1;
+    );
+
+    evhd_t *hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    return hdr->obj_count * hdr->slt_size;
+}
+
+
+size_t evtmem(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot get size of a NULL vector\n");
+        return -1;
+    );
+
+    return evvmem(vec) + EV_HDR_BYTES;
+}
+
+#endif
+
+
+#if defined EV_FSORT  | defined EV_FALL
+void evsort(void* vec, int (*compar)(const void* a, const void* b))
+{
+    ifp(!vec,
+        EV_FAIL("Cannot sort a NULL vector\n");
+        return;
+    );
+
+    evhd_t *hdr =  EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    qsort(vec,hdr->obj_count,hdr->slt_size,compar);
+    _evincsync(hdr, vec, 0, hdr->obj_count);
+}
+#endif
+
+
+#if defined EV_FCOPY  | defined EV_FALL
+void* evcpy(void* src)
+{
+    ifp(!src,
+        EV_FAIL("Cannot copy a NULL vector\n");
+        return NULL;
+    );
+    evhd_t *src_hdr = EV_HDR(src);
+    ifp(_evhdrcheck(src_hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+
+    //A vector with a NUMA policy gets untouched memory, which is bound before
+    //the copy places its pages
+    const int fresh = EV_EXTGET(src_hdr, numa_policy) != 0;
+    void* result = NULL;
+#if defined EV_FALIGN || defined EV_FALL
+    if(EV_ALIGN(src_hdr)){
+        result = _evini_aligned(src_hdr->slt_size, src_hdr->slt_count, EV_ALIGN(src_hdr), fresh);
+    }
+    else
+#endif
+    result = _evini(src_hdr->slt_size, src_hdr->slt_count, fresh);
+    if(!result){
+        EV_FAIL("Could not create new vector memory to copy into\n");
+        return NULL;
+    }
+    evhd_t *res_hdr = EV_HDR(result);
+    if(_evextcpy(res_hdr, src_hdr)){
+        evfree(result);
+        return NULL;
+    }
+#if defined EV_FNUMA || defined EV_FALL
+    if(fresh){
+        _evnumabind(res_hdr, result, res_hdr->slt_size * res_hdr->slt_count, 0);
+    }
+#endif
+
+    memcpy(result, src, src_hdr->slt_size * src_hdr->obj_count);
+    if(fresh){
+        memset((char*)result + src_hdr->slt_size * src_hdr->obj_count, 0,
+               res_hdr->slt_size * (res_hdr->slt_count - src_hdr->obj_count));
+    }
+    res_hdr->obj_count = src_hdr->obj_count;
+#if !EV_COMPACT
+    res_hdr->index     = src_hdr->index;
+#endif
+#if defined EV_FBITS || defined EV_FALL
+    if(EV_EXTGET(src_hdr, bit_count)){
+        res_hdr->ext->bit_count = src_hdr->ext->bit_count;
+    }
+#endif
+    EV_STAT_MAX(res_hdr, peak_objs, res_hdr->obj_count);
+
+    return result;
+}
+#endif
+
+
+#if defined EV_FSEG  || defined EV_FALL
+evsg_t* evsgini(size_t slt_size)
+{
+    ifp(slt_size == 0,
+        EV_FAIL("Slot size cannot be zero\n");
+        return NULL;
+    );
+
+    evsg_t* sg = (evsg_t*)calloc(1, sizeof(evsg_t));
+    ifp(!sg,
+        EV_FAIL("No memory to init segmented vector with %zuB\n", sizeof(evsg_t));
+        return NULL;
+    );
+
+    memcpy(sg->magic1,EV_SEG_MAGIC1,sizeof(sg->magic1));
+    sg->slt_size = slt_size;
+
+    //The first block holds at least EV_INIT_COUNT slots, rounded to a power of 2
+    while(((int64_t)1 << sg->base_bits) < EV_INIT_COUNT){
+        sg->base_bits++;
+    }
+    memcpy(sg->magic2,EV_SEG_MAGIC2,sizeof(sg->magic2));
+
+    return sg;
+}
+
+//Check that the segmented vector header is sane
+int _evsghdrcheck(evsg_t* sg)
+{
+    if(strncmp(sg->magic1, EV_SEG_MAGIC1, sizeof(EV_SEG_MAGIC1)) != 0){
+        EV_FAIL("Header magic 1 should be '%s' but found '%.*s'\n", EV_SEG_MAGIC1, sizeof(EV_SEG_MAGIC1), sg->magic1);
+        return -1;
+    };
+    if(strncmp(sg->magic2, EV_SEG_MAGIC2, sizeof(EV_SEG_MAGIC2)) != 0){
+        EV_FAIL("Header magic 2 should be '%s' but found '%.*s'\n", EV_SEG_MAGIC2, sizeof(EV_SEG_MAGIC2), sg->magic2);
+        return -1;
+    };
+
+    if(sg->obj_count < 0 || sg->obj_count > sg->slt_count){
+        EV_FAIL("Object count (%" PRId64 ") is out of range (%" PRId64 ")\n", sg->obj_count, sg->slt_count);
+        return -1;
+    }
+
+    if(sg->blk_count < 0 || sg->blk_count > EV_SEG_MAX_BLKS){
+        EV_FAIL("Block count (%" PRId64 ") is out of range\n", sg->blk_count);
+        return -1;
+    }
+
+    return 0;
+}
+
+//Internal function, find the block and offset holding a given index. Block b
+//starts at index 2^base_bits * (2^b - 1), so adding 2^base_bits to the index
+//puts the block number in the position of the most significant bit.
+static inline void _evsgloc(evsg_t* sg, size_t idx, size_t* blk, size_t* off)
+{
+    const uint64_t j = (uint64_t)idx + ((uint64_t)1 << sg->base_bits);
+#ifdef __GNUC__
+    const int msb = 63 - __builtin_clzll(j);
+#else
+    int msb = 0;
+    for(uint64_t k = j; k >>= 1; msb++);
+#endif
+    *blk = msb - sg->base_bits;
+    *off = j - ((uint64_t)1 << msb);
+}
+
+void* evsgpush(evsg_t* sg, void* obj, size_t obj_size)
+{
+    ifp(!sg,
+        EV_FAIL("Cannot push into a NULL segmented vector\n");
+        return NULL;
+    );
+
+    ifp(_evsghdrcheck(sg),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(obj_size > sg->slt_size,
+        EV_FAIL("Object size (%" PRId64 ") is larger than there is space (%" PRId64 ")\n",
+                obj_size,
+                sg->slt_size);
+        return NULL;
+    );
+
+    //Enough space? If not, add a block. Nothing already stored moves.
+    if(sg->obj_count == sg->slt_count){
+        if(sg->blk_count == EV_SEG_MAX_BLKS){
+            EV_FAIL("Segmented vector has run out of blocks (%i)\n", EV_SEG_MAX_BLKS);
+            return NULL;
+        }
+
+        const size_t blk_slts = (size_t)1 << (sg->base_bits + sg->blk_count);
+        void* blk = calloc(blk_slts, sg->slt_size);
+        if(!blk){
+            EV_FAIL("No memory to grow segmented vector by %zuB\n", blk_slts * sg->slt_size);
+            return NULL;
+        }
+
+        sg->blks[sg->blk_count] = blk;
+        sg->blk_count++;
+        sg->slt_count += blk_slts;
+    }
+
+    size_t blk, off;
+    _evsgloc(sg, sg->obj_count, &blk, &off);
+    void* next_obj = (char*)sg->blks[blk] + sg->slt_size * off;
+    memcpy(next_obj,obj,obj_size);
+    sg->obj_count++;
+
+    return next_obj;
+}
+
+void evsgpop(evsg_t* sg)
+{
+    ifp(!sg,
+        EV_FAIL("Cannot pop a NULL segmented vector\n");
+        return;
+    );
+
+    ifp(_evsghdrcheck(sg),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    if(sg->obj_count)
+        sg->obj_count--;
+}
+
+size_t evsgcnt(evsg_t* sg)
+{
+    if(!sg){
+        return 0;
+    }
+
+    ifp(_evsghdrcheck(sg),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    return sg->obj_count;
+}
+
+void* evsgidx(evsg_t* sg, size_t idx)
+{
+    ifp(!sg,
+        EV_FAIL("Cannot get index of a NULL segmented vector\n");
+        return NULL;
+    );
+
+    ifp(_evsghdrcheck(sg),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(idx >= sg->obj_count,
+        EV_FAIL("Index cannot be greater than number of objects (idx=%" PRId64 " > %" PRId64 ")\n" ,
+                idx,
+                sg->obj_count -1);
+        return NULL;
+    );
+
+    size_t blk, off;
+    _evsgloc(sg, idx, &blk, &off);
+    return (char*)sg->blks[blk] + sg->slt_size * off;
+}
+
+size_t evsgblks(evsg_t* sg)
+{
+    if(!sg || sg->obj_count == 0){
+        return 0;
+    }
+
+    ifp(_evsghdrcheck(sg),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
+    );
+
+    size_t blk, off;
+    _evsgloc(sg, sg->obj_count - 1, &blk, &off);
+    return blk + 1;
+}
+
+void* evsgblk(evsg_t* sg, size_t blk, size_t* count)
+{
+    ifp(!sg,
+        EV_FAIL("Cannot get block of a NULL segmented vector\n");
+        return NULL;
+    );
+
+    ifp(_evsghdrcheck(sg),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(blk >= evsgblks(sg),
+        EV_FAIL("Block index (%zu) is out of range (%zu)\n", blk, evsgblks(sg));
+        return NULL;
+    );
+
+    const size_t blk_first = (((size_t)1 << blk) - 1) << sg->base_bits;
+    const size_t blk_slts  = (size_t)1 << (sg->base_bits + blk);
+    const size_t remaining = sg->obj_count - blk_first;
+    if(count){
+        *count = remaining < blk_slts ? remaining : blk_slts;
+    }
+
+    return sg->blks[blk];
+}
+
+evsg_t* evsgfree(evsg_t* sg)
+{
+    if(!sg){
+        return NULL;
+    }
+
+    ifp(_evsghdrcheck(sg),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    for(int64_t i = 0; i < sg->blk_count; i++){
+        free(sg->blks[i]);
+    }
+    free(sg);
+
+    return NULL;
+}
+#endif
+
+
+#if defined EV_FVAR  || defined EV_FALL
+evvr_t* evvrini(int64_t flags)
+{
+    ifp(flags & ~EV_FLAG_VAR_INTERN,
+        EV_FAIL("Unknown variable length vector flags (0x%" PRIx64 ")\n", flags);
+        return NULL;
+    );
+
+    evvr_t* vr = (evvr_t*)calloc(1, sizeof(evvr_t));
+    ifp(!vr,
+        EV_FAIL("No memory to init variable length vector with %zuB\n", sizeof(evvr_t));
+        return NULL;
+    );
+
+    memcpy(vr->magic1,EV_VAR_MAGIC1,sizeof(vr->magic1));
+    vr->flags = flags;
+    memcpy(vr->magic2,EV_VAR_MAGIC2,sizeof(vr->magic2));
+
+    return vr;
+}
+
+//Check that the variable length vector header is sane
+int _evvrhdrcheck(evvr_t* vr)
+{
+    if(strncmp(vr->magic1, EV_VAR_MAGIC1, sizeof(EV_VAR_MAGIC1)) != 0){
+        EV_FAIL("Header magic 1 should be '%s' but found '%.*s'\n", EV_VAR_MAGIC1, sizeof(EV_VAR_MAGIC1), vr->magic1);
+        return -1;
+    };
+    if(strncmp(vr->magic2, EV_VAR_MAGIC2, sizeof(EV_VAR_MAGIC2)) != 0){
+        EV_FAIL("Header magic 2 should be '%s' but found '%.*s'\n", EV_VAR_MAGIC2, sizeof(EV_VAR_MAGIC2), vr->magic2);
+        return -1;
+    };
+
+    if(vr->obj_count < 0 || vr->obj_count > vr->rec_count){
+        EV_FAIL("Record count (%" PRId64 ") is out of range (%" PRId64 ")\n", vr->obj_count, vr->rec_count);
+        return -1;
+    }
+
+    if(vr->pool_used < 0 || vr->pool_used > vr->pool_size){
+        EV_FAIL("Pool use (%" PRId64 "B) is out of range (%" PRId64 "B)\n", vr->pool_used, vr->pool_size);
+        return -1;
+    }
+
+    return 0;
+}
+
+//Internal function, grow an array so that it has space for at least need items
+static int _evvrfit(void** arr, int64_t* size, int64_t need, size_t item_size)
+{
+    if(need <= *size){
+        return 0;
+    }
+
+    int64_t new_size = *size ? *size : EV_INIT_COUNT;
+    while(new_size < need){
+        new_size *= EV_GROWTH_FACTOR;
+    }
+
+    void* new_arr = realloc(*arr, new_size * item_size);
+    if(!new_arr){
+        EV_FAIL("No memory to grow variable length vector up to %" PRId64 "B\n", new_size * item_size);
+        return -1;
+    }
+
+    *arr  = new_arr;
+    *size = new_size;
+    return 0;
+}
+
+//Internal function, FNV-1a hash of a record
+static inline uint64_t _evvrhash(const void* obj, size_t obj_size)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < obj_size; i++){
+        h ^= ((const unsigned char*)obj)[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+//Internal function, find the intern table slot holding a record equal to obj,
+//or the empty slot where it should go.
+static uint32_t* _evvrfind(evvr_t* vr, const void* obj, size_t obj_size)
+{
+    const uint64_t mask = vr->itab_size - 1;
+    for(uint64_t i = _evvrhash(obj, obj_size) & mask; ; i = (i + 1) & mask){
+        uint32_t* ent = &vr->itab[i];
+        if(*ent == 0){
+            return ent;
+        }
+
+        const evvrrec_t* rec = &vr->recs[*ent - 1];
+        if(rec->len == obj_size && memcmp(vr->pool + rec->off, obj, obj_size) == 0){
+            return ent;
+        }
+    }
+}
+
+//Internal function, rebuild the intern table with space for at least size entries
+static int _evvrrehash(evvr_t* vr, int64_t size)
+{
+    uint32_t* itab = calloc(size, sizeof(uint32_t));
+    if(!itab){
+        EV_FAIL("No memory to grow intern table up to %" PRId64 "B\n", size * sizeof(uint32_t));
+        return -1;
+    }
+
+    free(vr->itab);
+    vr->itab      = itab;
+    vr->itab_size = size;
+    vr->itab_used = 0;
+
+    for(int64_t i = 0; i < vr->obj_count; i++){
+        const evvrrec_t* rec = &vr->recs[i];
+        uint32_t* ent = _evvrfind(vr, vr->pool + rec->off, rec->len);
+        if(*ent == 0){
+            *ent = i + 1;
+            vr->itab_used++;
+        }
+    }
+
+    return 0;
+}
+
+//Internal function, remove the intern table entry for record idx, if it is the
+//stored copy. Entries further along the same probe run move back into the gap,
+//so that _evvrfind() still reaches them. Returns non-zero if it was removed.
+static int _evvrunintern(evvr_t* vr, int64_t idx)
+{
+    const uint64_t mask = vr->itab_size - 1;
+    const evvrrec_t* rec = &vr->recs[idx];
+    uint64_t i = _evvrhash(vr->pool + rec->off, rec->len) & mask;
+    while(vr->itab[i] && vr->itab[i] != idx + 1){
+        i = (i + 1) & mask;
+    }
+    if(!vr->itab[i]){
+        //A duplicate, pointing at an earlier copy
+        return 0;
+    }
+
+    for(uint64_t j = (i + 1) & mask; vr->itab[j]; j = (j + 1) & mask){
+        const evvrrec_t* moved = &vr->recs[vr->itab[j] - 1];
+        const uint64_t home = _evvrhash(vr->pool + moved->off, moved->len) & mask;
+
+        //Leave it if its home slot is after the gap (wrapping around)
+        if(i <= j ? (i < home && home <= j) : (i < home || home <= j)){
+            continue;
+        }
+        vr->itab[i] = vr->itab[j];
+        i = j;
+    }
+    vr->itab[i] = 0;
+    vr->itab_used--;
+
+    return 1;
+}
+
+void* evvrpush(evvr_t* vr, const void* obj, size_t obj_size)
+{
+    ifp(!vr,
+        EV_FAIL("Cannot push into a NULL variable length vector\n");
+        return NULL;
+    );
+
+    ifp(_evvrhdrcheck(vr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    //Always checked, since the record offsets would wrap around past this
+    if((EV_VAR_OFF_T)(vr->pool_used + obj_size) != vr->pool_used + obj_size){
+        EV_FAIL("Record (%zuB) does not fit in the pool, see EV_VAR_OFF_T\n", obj_size);
+        return NULL;
+    }
+
+    if(_evvrfit((void**)&vr->recs, &vr->rec_count, vr->obj_count + 1, sizeof(evvrrec_t))){
+        return NULL;
+    }
+
+    uint32_t* ent = NULL;
+    if(vr->flags & EV_FLAG_VAR_INTERN){
+        //Keep the table at most half full so that probes stay short
+        if((vr->itab_used + 1) * 2 > vr->itab_size &&
+           _evvrrehash(vr, vr->itab_size ? vr->itab_size * 2 : EV_INIT_COUNT * 2)){
+            return NULL;
+        }
+
+        ent = _evvrfind(vr, obj, obj_size);
+        if(*ent){
+            //Seen it before, point at the existing copy
+            vr->recs[vr->obj_count] = vr->recs[*ent - 1];
+            vr->obj_count++;
+            return vr->pool + vr->recs[*ent - 1].off;
+        }
+    }
+
+    if(_evvrfit((void**)&vr->pool, &vr->pool_size, vr->pool_used + obj_size, 1)){
+        return NULL;
+    }
+
+    char* next_obj = vr->pool + vr->pool_used;
+    memcpy(next_obj, obj, obj_size);
+
+    vr->recs[vr->obj_count].off = vr->pool_used;
+    vr->recs[vr->obj_count].len = obj_size;
+    vr->pool_used += obj_size;
+    vr->obj_count++;
+
+    if(ent){
+        *ent = vr->obj_count;
+        vr->itab_used++;
+    }
+
+    return next_obj;
+}
+
+size_t evvrcnt(evvr_t* vr)
+{
+    if(!vr){
+        return 0;
+    }
+
+    ifp(_evvrhdrcheck(vr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    return vr->obj_count;
+}
+
+void* evvridx(evvr_t* vr, size_t idx, size_t* size)
+{
+    ifp(!vr,
+        EV_FAIL("Cannot get index of a NULL variable length vector\n");
+        return NULL;
+    );
+
+    ifp(_evvrhdrcheck(vr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(idx >= vr->obj_count,
+        EV_FAIL("Index cannot be greater than number of records (idx=%" PRId64 " > %" PRId64 ")\n" ,
+                idx,
+                vr->obj_count -1);
+        return NULL;
+    );
+
+    const evvrrec_t* rec = &vr->recs[idx];
+    if(size){
+        *size = rec->len;
+    }
+
+    return vr->pool + rec->off;
+}
+
+void* evvrhead(evvr_t* vr)
+{
+    if(!vr || vr->obj_count == 0){
+        return NULL;
+    }
+
+    vr->index = 0;
+    return evvridx(vr, vr->index, NULL);
+}
+
+void* evvrnext(evvr_t* vr)
+{
+    ifp(!vr,
+        EV_FAIL("Cannot get next record in a NULL variable length vector\n");
+        return NULL;
+    );
+
+    vr->index++;
+    if(vr->index >= vr->obj_count){
+        return NULL;
+    }
+
+    return evvridx(vr, vr->index, NULL);
+}
+
+void evvrpop(evvr_t* vr)
+{
+    ifp(!vr,
+        EV_FAIL("Cannot pop a NULL variable length vector\n");
+        return;
+    );
+
+    ifp(_evvrhdrcheck(vr),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    if(!vr->obj_count){
+        return;
+    }
+
+    vr->obj_count--;
+
+    //Duplicates are always pushed after the copy they share, so once the copy
+    //itself is popped nothing else uses its pool space
+    const evvrrec_t* rec = &vr->recs[vr->obj_count];
+    const int shared = (vr->flags & EV_FLAG_VAR_INTERN) && !_evvrunintern(vr, vr->obj_count);
+    if(!shared && rec->off + rec->len == vr->pool_used){
+        vr->pool_used = rec->off;
+    }
+}
+
+size_t evvrmem(evvr_t* vr)
+{
+    ifp(!vr,
+        EV_FAIL("Cannot get size of a NULL variable length vector\n");
+        return -1;
+    );
+
+    ifp(_evvrhdrcheck(vr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    return sizeof(evvr_t) + vr->pool_size + vr->rec_count * sizeof(evvrrec_t) +
+           vr->itab_size * sizeof(uint32_t);
+}
+
+evvr_t* evvrfree(evvr_t* vr)
+{
+    if(!vr){
+        return NULL;
+    }
+
+    ifp(_evvrhdrcheck(vr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    free(vr->recs);
+    free(vr->pool);
+    free(vr->itab);
+    free(vr);
+
+    return NULL;
+}
+#endif
+
+
+#if defined EV_FCOL  || defined EV_FALL
+evcl_t* evclini(size_t col_count, const size_t* col_sizes, const size_t* col_offs)
+{
+    ifp(col_count == 0 || col_count > EV_COL_MAX,
+        EV_FAIL("Column count (%zu) must be between 1 and %i\n", col_count, EV_COL_MAX);
+        return NULL;
+    );
+
+    ifp(!col_sizes,
+        EV_FAIL("Column sizes cannot be NULL\n");
+        return NULL;
+    );
+
+    evcl_t* cl = (evcl_t*)calloc(1, sizeof(evcl_t));
+    ifp(!cl,
+        EV_FAIL("No memory to init columnar vector with %zuB\n", sizeof(evcl_t));
+        return NULL;
+    );
+
+    memcpy(cl->magic1,EV_COL_MAGIC1,sizeof(cl->magic1));
+    cl->col_count = col_count;
+    for(size_t c = 0; c < col_count; c++){
+        ifp(col_sizes[c] == 0,
+            EV_FAIL("Column %zu size cannot be zero\n", c);
+            free(cl);
+            return NULL;
+        );
+
+        cl->col_size[c] = col_sizes[c];
+        cl->col_off[c]  = col_offs ? col_offs[c] : (size_t)cl->row_size;
+        cl->row_size   += col_sizes[c];
+    }
+    cl->grw_factor = EV_GROWTH_FACTOR;
+    memcpy(cl->magic2,EV_COL_MAGIC2,sizeof(cl->magic2));
+
+    return cl;
+}
+
+//Check that the columnar vector header is sane
+int _evclhdrcheck(evcl_t* cl)
+{
+    if(strncmp(cl->magic1, EV_COL_MAGIC1, sizeof(EV_COL_MAGIC1)) != 0){
+        EV_FAIL("Header magic 1 should be '%s' but found '%.*s'\n", EV_COL_MAGIC1, sizeof(EV_COL_MAGIC1), cl->magic1);
+        return -1;
+    };
+    if(strncmp(cl->magic2, EV_COL_MAGIC2, sizeof(EV_COL_MAGIC2)) != 0){
+        EV_FAIL("Header magic 2 should be '%s' but found '%.*s'\n", EV_COL_MAGIC2, sizeof(EV_COL_MAGIC2), cl->magic2);
+        return -1;
+    };
+
+    if(cl->obj_count < 0 || cl->obj_count > cl->slt_count){
+        EV_FAIL("Object count (%" PRId64 ") is out of range (%" PRId64 ")\n", cl->obj_count, cl->slt_count);
+        return -1;
+    }
+
+    if(cl->col_count <= 0 || cl->col_count > EV_COL_MAX){
+        EV_FAIL("Column count (%" PRId64 ") is out of range\n", cl->col_count);
+        return -1;
+    }
+
+    return 0;
+}
+
+//Internal function, grow every column by the growth policy. Columns are cache
+//line aligned, like evini_aligned(), which realloc() would not keep, so each
+//one is copied into a fresh allocation. If one fails the columns done so far
+//are bigger than they need to be, which is harmless.
+static int _evclgrow(evcl_t* cl)
+{
+    const int64_t new_count = _evgrwnext(cl->slt_count, cl->grw_factor, cl->grw_limit, cl->grw_step);
+    for(int64_t c = 0; c < cl->col_count; c++){
+        char* col = NULL;
+        if(posix_memalign((void**)&col, EV_CACHE_LINE, new_count * cl->col_size[c])){
+            EV_FAIL("No memory to grow column %" PRId64 " up to %" PRId64 "B\n", c, new_count * cl->col_size[c]);
+            return -1;
+        }
+        if(cl->obj_count){
+            memcpy(col, cl->cols[c], cl->obj_count * cl->col_size[c]);
+        }
+        free(cl->cols[c]);
+        cl->cols[c] = col;
+    }
+
+    cl->slt_count = new_count;
+    return 0;
+}
+
+int evclpush(evcl_t* cl, const void* row)
+{
+    ifp(!cl,
+        EV_FAIL("Cannot push into a NULL columnar vector\n");
+        return -1;
+    );
+
+    ifp(_evclhdrcheck(cl),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    if(cl->obj_count == cl->slt_count && _evclgrow(cl)){
+        return -1;
+    }
+
+    for(int64_t c = 0; c < cl->col_count; c++){
+        memcpy(cl->cols[c] + cl->col_size[c] * cl->obj_count,
+               (const char*)row + cl->col_off[c],
+               cl->col_size[c]);
+    }
+    cl->obj_count++;
+    return 0;
+}
+
+void evclgrw(evcl_t* cl, double factor, size_t limit, size_t step)
+{
+    ifp(!cl,
+        EV_FAIL("Cannot set growth policy of a NULL columnar vector\n");
+        return;
+    );
+
+    ifp(_evclhdrcheck(cl),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    ifp(factor <= 1.0,
+        EV_FAIL("Growth factor (%f) must be greater than 1.0\n", factor);
+        return;
+    );
+
+    ifp(limit && !step,
+        EV_FAIL("Growth step must be greater than 0 when a limit is set\n");
+        return;
+    );
+
+    cl->grw_factor = factor;
+    cl->grw_limit  = limit;
+    cl->grw_step   = step;
+}
+
+void evclget(evcl_t* cl, size_t idx, void* row)
+{
+    ifp(!cl,
+        EV_FAIL("Cannot get record from a NULL columnar vector\n");
+        return;
+    );
+
+    ifp(_evclhdrcheck(cl),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    ifp(idx >= cl->obj_count,
+        EV_FAIL("Index cannot be greater than number of objects (idx=%" PRId64 " > %" PRId64 ")\n" ,
+                idx,
+                cl->obj_count -1);
+        return;
+    );
+
+    for(int64_t c = 0; c < cl->col_count; c++){
+        memcpy((char*)row + cl->col_off[c],
+               cl->cols[c] + cl->col_size[c] * idx,
+               cl->col_size[c]);
+    }
+}
+
+void* evclcol(evcl_t* cl, size_t col)
+{
+    ifp(!cl,
+        EV_FAIL("Cannot get column of a NULL columnar vector\n");
+        return NULL;
+    );
+
+    ifp(_evclhdrcheck(cl),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(col >= cl->col_count,
+        EV_FAIL("Column (%zu) is out of range (%" PRId64 ")\n", col, cl->col_count);
+        return NULL;
+    );
+
+    return cl->cols[col];
+}
+
+void* evclidx(evcl_t* cl, size_t col, size_t idx)
+{
+    char* column = evclcol(cl, col);
+    ifp(!column,
+        return NULL;
+    );
+
+    ifp(idx >= cl->obj_count,
+        EV_FAIL("Index cannot be greater than number of objects (idx=%" PRId64 " > %" PRId64 ")\n" ,
+                idx,
+                cl->obj_count -1);
+        return NULL;
+    );
+
+    return column + cl->col_size[col] * idx;
+}
+
+size_t evclcnt(evcl_t* cl)
+{
+    if(!cl){
+        return 0;
+    }
+
+    ifp(_evclhdrcheck(cl),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    return cl->obj_count;
+}
+
+void evclpop(evcl_t* cl)
+{
+    ifp(!cl,
+        EV_FAIL("Cannot pop a NULL columnar vector\n");
+        return;
+    );
+
+    ifp(_evclhdrcheck(cl),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    if(cl->obj_count)
+        cl->obj_count--;
+}
+
+void evcldel(evcl_t* cl, size_t idx)
+{
+    ifp(!cl,
+        EV_FAIL("Cannot delete from a NULL columnar vector\n");
+        return;
+    );
+
+    ifp(_evclhdrcheck(cl),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    ifp(idx >= cl->obj_count,
+        EV_FAIL("Vector index (%zu) too large (%" PRId64")\n", idx, cl->obj_count -1);
+        return;
+    );
+
+    for(int64_t c = 0; c < cl->col_count; c++){
+        const size_t sz = cl->col_size[c];
+        memmove(cl->cols[c] + sz * idx, cl->cols[c] + sz * (idx + 1), sz * (cl->obj_count - idx - 1));
+    }
+    cl->obj_count--;
+}
+
+//Internal function, stable merge sort of row numbers by the values in a column
+static void _evclmsort(uint64_t* rows, uint64_t* tmp, size_t n, const char* col, size_t sz,
+                       int (*compar)(const void* a, const void* b))
+{
+    if(n < 2){
+        return;
+    }
+
+    const size_t h = n / 2;
+    _evclmsort(rows, tmp, h, col, sz, compar);
+    _evclmsort(rows + h, tmp, n - h, col, sz, compar);
+
+    size_t i = 0, j = h, k = 0;
+    while(i < h && j < n){
+        tmp[k++] = compar(col + rows[j] * sz, col + rows[i] * sz) < 0 ? rows[j++] : rows[i++];
+    }
+    while(i < h) tmp[k++] = rows[i++];
+    while(j < n) tmp[k++] = rows[j++];
+    memcpy(rows, tmp, n * sizeof(uint64_t));
+}
+
+void evclsort(evcl_t* cl, size_t col, int (*compar)(const void* a, const void* b))
+{
+    ifp(!cl,
+        EV_FAIL("Cannot sort a NULL columnar vector\n");
+        return;
+    );
+
+    ifp(_evclhdrcheck(cl),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    ifp(col >= cl->col_count,
+        EV_FAIL("Column (%zu) is out of range (%" PRId64 ")\n", col, cl->col_count);
+        return;
+    );
+
+    const size_t n = cl->obj_count;
+    if(n < 2){
+        return;
+    }
+
+    //Work out the order once from the key column, then apply it to every column
+    size_t max_size = 0;
+    for(int64_t c = 0; c < cl->col_count; c++){
+        max_size = cl->col_size[c] > max_size ? cl->col_size[c] : max_size;
+    }
+
+    uint64_t* rows = malloc(n * sizeof(uint64_t) * 2);
+    char* tmp_col  = malloc(n * max_size);
+    if(!rows || !tmp_col){
+        EV_FAIL("No memory to sort columnar vector\n");
+        free(rows);
+        free(tmp_col);
+        return;
+    }
+
+    for(size_t i = 0; i < n; i++){
+        rows[i] = i;
+    }
+    _evclmsort(rows, rows + n, n, cl->cols[col], cl->col_size[col], compar);
+
+    for(int64_t c = 0; c < cl->col_count; c++){
+        const size_t sz = cl->col_size[c];
+        for(size_t i = 0; i < n; i++){
+            memcpy(tmp_col + i * sz, cl->cols[c] + rows[i] * sz, sz);
+        }
+        memcpy(cl->cols[c], tmp_col, n * sz);
+    }
+
+    free(rows);
+    free(tmp_col);
+}
+
+evcl_t* evclfree(evcl_t* cl)
+{
+    if(!cl){
+        return NULL;
+    }
+
+    ifp(_evclhdrcheck(cl),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    for(int64_t c = 0; c < cl->col_count; c++){
+        free(cl->cols[c]);
+    }
+    free(cl);
+
+    return NULL;
+}
+#endif
+
+
+#if EV_STATS
+void evstats(void* vec, evstats_t* stats)
+{
+    ifp(!stats,
+        EV_FAIL("Cannot write statistics to NULL\n");
+        return;
+    );
+
+    if(!vec){
+        *stats = _evst_total;
+        return;
+    }
+
+    evhd_t *hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    //Caller owned vectors are only counted once they move to the heap
+    if(hdr->ext){
+        *stats = hdr->ext->stats;
+    }
+    else{
+        memset(stats, 0x00, sizeof(*stats));
+    }
+}
+
+//Internal function, write one set of statistics
+static void _evstwrite(int fd, int json, const evstats_t* st)
+{
+    const char* fmt = json ?
+        "\"pushes\": %" PRId64 ", \"grows\": %" PRId64 ", \"copy_bytes\": %" PRId64 ", "
+        "\"del_bytes\": %" PRId64 ", \"peak_objs\": %" PRId64 ", \"peak_slots\": %" PRId64 :
+        "pushes: %" PRId64 ", grows: %" PRId64 ", copy_bytes: %" PRId64 ", "
+        "del_bytes: %" PRId64 ", peak_objs: %" PRId64 ", peak_slots: %" PRId64;
+    dprintf(fd, fmt, st->pushes, st->grows, st->copy_bytes, st->del_bytes, st->peak_objs, st->peak_slots);
+}
+
+void evstdump(int fd, int json)
+{
+    pthread_mutex_lock(&_evst_lock);
+
+    int64_t live_count = 0;
+    int64_t live_bytes = 0;
+    for(evext_t* ext = _evst_head; ext; ext = ext->st_next){
+        live_count++;
+        live_bytes += EV_HDR_BYTES + ext->st_hdr->slt_count * ext->st_hdr->slt_size;
+    }
+
+    dprintf(fd, json ? "{\"live_vectors\": %" PRId64 ", \"live_bytes\": %" PRId64 ", \"totals\": {" :
+                       "[EV STATS] live_vectors: %" PRId64 ", live_bytes: %" PRId64 ", totals: ",
+            live_count, live_bytes);
+    _evstwrite(fd, json, &_evst_total);
+    dprintf(fd, json ? "}, \"vectors\": [" : "\n");
+
+    for(evext_t* ext = _evst_head; ext; ext = ext->st_next){
+        const evhd_t* hdr = ext->st_hdr;
+        dprintf(fd, json ? "%s\n  {\"addr\": \"%p\", \"slt_size\": %" PRId64 ", \"obj_count\": %" PRId64 ", \"slt_count\": %" PRId64 ", " :
+                           "%s[EV STATS] %p: slt_size: %" PRId64 ", obj_count: %" PRId64 ", slt_count: %" PRId64 ", ",
+                ext == _evst_head || !json ? "" : ",",
+                (char*)hdr + EV_HDR_BYTES, hdr->slt_size, hdr->obj_count, hdr->slt_count);
+        _evstwrite(fd, json, &ext->stats);
+        dprintf(fd, json ? "}" : "\n");
+    }
+
+    if(json){
+        dprintf(fd, "]}\n");
+    }
+
+    pthread_mutex_unlock(&_evst_lock);
+}
+
+//Internal function, called by atexit()
+static void _evstexit(void)
+{
+    evstdump(_evst_fd, _evst_json);
+}
+
+void evstexit(int fd, int json)
+{
+    _evst_fd   = fd;
+    _evst_json = json;
+    atexit(_evstexit);
+}
+#endif
+
+#if EV_TRACE
+void* _evtrsite(void* vec, const char* file, int line)
+{
+    if(!vec){
+        return NULL;
+    }
+
+    evhd_t *hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return vec;
+    );
+
+    //Caller owned vectors are not tracked until they move to the heap
+    if(hdr->ext){
+        hdr->ext->tr_file = file;
+        hdr->ext->tr_line = line;
+    }
+    return vec;
+}
+
+void* _evtrpush(void* vec, void* obj, size_t obj_size, const char* file, int line)
+{
+    //Only a push that makes a new vector, or moves one out of caller owned
+    //storage, owns it
+    void* result = evpush(vec, obj, obj_size);
+    if(result && EV_HDR(result)->ext && !EV_HDR(result)->ext->tr_file){
+        _evtrsite(result, file, line);
+    }
+    return result;
+}
+
+typedef struct {
+    const char* file;
+    int64_t line;
+    int64_t vectors;
+    int64_t live_bytes;
+    int64_t slack_bytes;
+    int64_t grows;
+} _evtrsite_t;
+
+static int _evtrbysite(const void* a, const void* b)
+{
+    const _evtrsite_t* sa = a;
+    const _evtrsite_t* sb = b;
+    const int c = strcmp(sa->file ? sa->file : "", sb->file ? sb->file : "");
+    return c ? c : (sa->line > sb->line) - (sa->line < sb->line);
+}
+
+static int _evtrbybytes(const void* a, const void* b)
+{
+    const _evtrsite_t* sa = a;
+    const _evtrsite_t* sb = b;
+    return (sa->live_bytes < sb->live_bytes) - (sa->live_bytes > sb->live_bytes);
+}
+
+//Internal function, write a file name as the body of a JSON string
+static void _evtrjsonstr(int fd, const char* s)
+{
+    const char* run = s;
+    for(; *s; s++){
+        const unsigned char c = *s;
+        if(c != '"' && c != '\\' && c >= 0x20){
+            continue;
+        }
+        dprintf(fd, "%.*s", (int)(s - run), run);
+        if(c == '"' || c == '\\'){
+            dprintf(fd, "\\%c", c);
+        }
+        else{
+            dprintf(fd, "\\u%04x", c);
+        }
+        run = s + 1;
+    }
+    dprintf(fd, "%s", run);
+}
+
+void evtrdump(int fd, int json)
+{
+    pthread_mutex_lock(&_evst_lock);
+
+    size_t count = 0;
+    for(evext_t* ext = _evst_head; ext; ext = ext->st_next){
+        count++;
+    }
+
+    _evtrsite_t* sites = calloc(count ? count : 1, sizeof(_evtrsite_t));
+    if(!sites){
+        pthread_mutex_unlock(&_evst_lock);
+        EV_FAIL("No memory to build call site report\n");
+        return;
+    }
+
+    size_t i = 0;
+    for(evext_t* ext = _evst_head; ext; ext = ext->st_next, i++){
+        const evhd_t* hdr = ext->st_hdr;
+        sites[i].file        = ext->tr_file;
+        sites[i].line        = ext->tr_line;
+        sites[i].vectors     = 1;
+        sites[i].live_bytes  = EV_HDR_BYTES + hdr->slt_count * hdr->slt_size;
+        sites[i].slack_bytes = (hdr->slt_count - hdr->obj_count) * hdr->slt_size;
+        sites[i].grows       = ext->tr_grows;
+    }
+
+    pthread_mutex_unlock(&_evst_lock);
+
+    //Merge the vectors made at the same site
+    size_t site_count = 0;
+    qsort(sites, count, sizeof(_evtrsite_t), _evtrbysite);
+    for(i = 0; i < count; i++){
+        if(site_count && _evtrbysite(&sites[site_count - 1], &sites[i]) == 0){
+            sites[site_count - 1].vectors     += sites[i].vectors;
+            sites[site_count - 1].live_bytes  += sites[i].live_bytes;
+            sites[site_count - 1].slack_bytes += sites[i].slack_bytes;
+            sites[site_count - 1].grows       += sites[i].grows;
+        }
+        else{
+            sites[site_count++] = sites[i];
+        }
+    }
+    qsort(sites, site_count, sizeof(_evtrsite_t), _evtrbybytes);
+
+    if(json){
+        dprintf(fd, "{\"sites\": [");
+    }
+    for(i = 0; i < site_count; i++){
+        const char* file = sites[i].file ? sites[i].file : "unknown";
+        if(json){
+            dprintf(fd, "%s\n  {\"file\": \"", i ? "," : "");
+            _evtrjsonstr(fd, file);
+            dprintf(fd, "\", \"line\": %" PRId64 ", \"vectors\": %" PRId64 ", "
+                        "\"live_bytes\": %" PRId64 ", \"slack_bytes\": %" PRId64 ", \"grows\": %" PRId64 "}",
+                    sites[i].line, sites[i].vectors,
+                    sites[i].live_bytes, sites[i].slack_bytes, sites[i].grows);
+        }
+        else{
+            dprintf(fd, "[EV TRACE] %s:%" PRId64 ": vectors: %" PRId64 ", "
+                        "live_bytes: %" PRId64 ", slack_bytes: %" PRId64 ", grows: %" PRId64 "\n",
+                    file, sites[i].line, sites[i].vectors,
+                    sites[i].live_bytes, sites[i].slack_bytes, sites[i].grows);
+        }
+    }
+    if(json){
+        dprintf(fd, "]}\n");
+    }
+
+    free(sites);
+}
+#endif
+
+#if defined EV_FMATH || defined EV_FALL
+#include <pthread.h>
+
+#define EV_LANES 8 //Independent accumulators per loop, to give the vectorizer room
+
+enum {
+    _EV_OP_SUM,
+    _EV_OP_DOT,
+    _EV_OP_MIN,
+    _EV_OP_MAX,
+    _EV_OP_ARGMIN,
+    _EV_OP_ARGMAX,
+    _EV_OP_SCALE,
+    _EV_OP_ADD,
+    _EV_OP_ADDK,
+    _EV_OP_PREFIX,
+};
+
+//Internal function, check a numeric vector and find its items
+static char* _evnumdata(void* vec, size_t size, size_t* count)
+{
+    *count = 0;
+    if(!vec){
+        return NULL;
+    }
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(hdr->slt_size != size,
+        EV_FAIL("Slot size (%" PRId64 ") does not match the kernel type size (%zu)\n",
+                (int64_t)hdr->slt_size, size);
+        return NULL;
+    );
+
+    *count = hdr->obj_count;
+    return vec;
+}
+
+//Internal function, how many jobs to split n items over
+static size_t _evparjobs(size_t n)
+{
+    if(n < EV_PAR_CUTOFF){
+        return 1;
+    }
+
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if(cpus < 2){
+        return 1;
+    }
+    return cpus < EV_PAR_THREADS ? cpus : EV_PAR_THREADS;
+}
+
+//Internal struct, the threads that kernels are split over. Starting threads
+//for every kernel would cost more than a split kernel saves, so they are
+//started on first use and then wait for the next batch of jobs.
+static struct {
+    pthread_mutex_t lock;    //Guards everything below
+    pthread_cond_t work;     //Signalled when a batch is posted
+    pthread_cond_t done;     //Signalled when the last job of a batch ends
+    pthread_mutex_t run;     //Held while a batch runs, one batch at a time
+    size_t workers;          //Threads started so far
+    uint64_t batch;          //Counts the batches posted
+    void* (*fn)(void*);
+    char* jobs;
+    size_t job_size;
+    size_t n_jobs;
+    size_t next;             //Next job to hand out
+    size_t left;             //Jobs not finished yet
+} _evpool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+              PTHREAD_COND_INITIALIZER, PTHREAD_MUTEX_INITIALIZER };
+
+//Internal function, run jobs of the current batch until none are left to hand
+//out. Called with the lock held.
+static void _evpoolrun(void)
+{
+    while(_evpool.next < _evpool.n_jobs){
+        void* (*fn)(void*) = _evpool.fn;
+        char* job = _evpool.jobs + _evpool.next++ * _evpool.job_size;
+        pthread_mutex_unlock(&_evpool.lock);
+        fn(job);
+        pthread_mutex_lock(&_evpool.lock);
+        if(!--_evpool.left){
+            pthread_cond_signal(&_evpool.done);
+        }
+    }
+}
+
+//Internal function, the body of each pool thread
+static void* _evpoolmain(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&_evpool.lock);
+    uint64_t seen = _evpool.batch;
+    for(;;){
+        while(_evpool.batch == seen){
+            pthread_cond_wait(&_evpool.work, &_evpool.lock);
+        }
+        seen = _evpool.batch;
+        _evpoolrun();
+    }
+    return NULL;
+}
+
+//Internal function, run fn over each job, sharing them between the caller and
+//the pool threads
+static void _evpar(void* (*fn)(void*), char* jobs, size_t job_size, size_t n_jobs)
+{
+    if(n_jobs < 2){
+        fn(jobs);
+        return;
+    }
+
+    pthread_mutex_lock(&_evpool.run);
+    pthread_mutex_lock(&_evpool.lock);
+    while(_evpool.workers < n_jobs - 1){
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, _evpoolmain, NULL)){
+            //No more threads to be had, the caller picks up the slack
+            break;
+        }
+        pthread_detach(thread);
+        _evpool.workers++;
+    }
+
+    _evpool.fn       = fn;
+    _evpool.jobs     = jobs;
+    _evpool.job_size = job_size;
+    _evpool.n_jobs   = n_jobs;
+    _evpool.next     = 0;
+    _evpool.left     = n_jobs;
+    _evpool.batch++;
+    pthread_cond_broadcast(&_evpool.work);
+
+    _evpoolrun();
+    while(_evpool.left){
+        pthread_cond_wait(&_evpool.done, &_evpool.lock);
+    }
+    pthread_mutex_unlock(&_evpool.lock);
+    pthread_mutex_unlock(&_evpool.run);
+}
+
+//Internal macro, the lanes loop used by sum and dot
+#define _EV_NUM_LANES(A, expr) \
+    A lanes[EV_LANES] = {0}; \
+    size_t i = 0; \
+    for(; i + EV_LANES <= n; i += EV_LANES){ \
+        for(size_t l = 0; l < EV_LANES; l++){ \
+            lanes[l] += expr(A, i + l); \
+        } \
+    } \
+    for(; i < n; i++){ \
+        lanes[0] += expr(A, i); \
+    } \
+    A acc = 0; \
+    for(size_t l = 0; l < EV_LANES; l++){ \
+        acc += lanes[l]; \
+    }
+
+//Internal macro, the lanes loop used by min and max
+#define _EV_NUM_PICK(T, better) \
+    T lanes[EV_LANES]; \
+    for(size_t l = 0; l < EV_LANES; l++){ \
+        lanes[l] = a[0]; \
+    } \
+    size_t i = 0; \
+    for(; i + EV_LANES <= n; i += EV_LANES){ \
+        for(size_t l = 0; l < EV_LANES; l++){ \
+            lanes[l] = a[i + l] better lanes[l] ? a[i + l] : lanes[l]; \
+        } \
+    } \
+    T val = lanes[0]; \
+    for(; i < n; i++){ \
+        val = a[i] better val ? a[i] : val; \
+    } \
+    for(size_t l = 1; l < EV_LANES; l++){ \
+        val = lanes[l] better val ? lanes[l] : val; \
+    }
+
+#define _EV_NUM_A(A, k) ((A)a[k])
+#define _EV_NUM_AB(A, k) ((A)a[k] * (A)b[k])
+
+#define _EV_NUM_IMPL(S, T, A) \
+typedef struct { \
+    T* a; \
+    T* b; \
+    T k; \
+    size_t n; \
+    size_t base; \
+    int op; \
+    A acc; \
+    T val; \
+    size_t idx; \
+} _evjob_##S; \
+\
+static void* _evrun_##S(void* arg) \
+{ \
+    _evjob_##S* j = arg; \
+    /* Not restrict, since evadd_S(v, v) is allowed */ \
+    T* a = j->a; \
+    const T* b = j->b; \
+    const T k = j->k; \
+    const size_t n = j->n; \
+\
+    switch(j->op){ \
+    case _EV_OP_SUM: { _EV_NUM_LANES(A, _EV_NUM_A) j->acc = acc; break; } \
+    case _EV_OP_DOT: { _EV_NUM_LANES(A, _EV_NUM_AB) j->acc = acc; break; } \
+    case _EV_OP_MIN: { _EV_NUM_PICK(T, <) j->val = val; break; } \
+    case _EV_OP_MAX: { _EV_NUM_PICK(T, >) j->val = val; break; } \
+    case _EV_OP_ARGMIN: \
+    case _EV_OP_ARGMAX: { \
+        /* Find the value with the vectorized loop, then find where it is. A \
+           NaN is not equal to itself, so match it by its bits instead. */ \
+        T val; \
+        if(j->op == _EV_OP_ARGMIN){ _EV_NUM_PICK(T, <) j->val = val; } \
+        else { _EV_NUM_PICK(T, >) j->val = val; } \
+        val = j->val; \
+        size_t i = 0; \
+        while(i < n && a[i] != val && memcmp(&a[i], &val, sizeof(T))){ \
+            i++; \
+        } \
+        j->idx = j->base + (i < n ? i : 0); \
+        break; \
+    } \
+    case _EV_OP_SCALE: \
+        for(size_t i = 0; i < n; i++){ \
+            a[i] *= k; \
+        } \
+        break; \
+    case _EV_OP_ADD: \
+        for(size_t i = 0; i < n; i++){ \
+            a[i] += b[i]; \
+        } \
+        break; \
+    case _EV_OP_ADDK: \
+        for(size_t i = 0; i < n; i++){ \
+            a[i] += k; \
+        } \
+        break; \
+    case _EV_OP_PREFIX: { \
+        T run = 0; \
+        for(size_t i = 0; i < n; i++){ \
+            run += a[i]; \
+            a[i] = run; \
+        } \
+        j->val = run; \
+        break; \
+    } \
+    } \
+    return NULL; \
+} \
+\
+static _evjob_##S _evnum_##S(T* vec, T* src, int op, T k) \
+{ \
+    _evjob_##S res = { .idx = -1 }; \
+    size_t n = 0; \
+    T* a = (T*)_evnumdata(vec, sizeof(T), &n); \
+    T* b = NULL; \
+    if(src){ \
+        size_t src_n = 0; \
+        b = (T*)_evnumdata(src, sizeof(T), &src_n); \
+        ifp(src_n != n, \
+            EV_FAIL("Vector lengths differ (%zu != %zu)\n", n, src_n); \
+            return res; \
+        ); \
+    } \
+    if(!n){ \
+        return res; \
+    } \
+\
+    _evjob_##S jobs[EV_PAR_THREADS]; \
+    const size_t n_jobs = _evparjobs(n); \
+    const size_t per_job = (n + n_jobs - 1) / n_jobs; \
+    for(size_t j = 0; j < n_jobs; j++){ \
+        const size_t lo = j * per_job; \
+        const size_t hi = lo + per_job < n ? lo + per_job : n; \
+        jobs[j] = (_evjob_##S){ .a = a + lo, .b = b ? b + lo : NULL, .k = k, \
+                                .n = hi - lo, .base = lo, .op = op }; \
+    } \
+    _evpar(_evrun_##S, (char*)jobs, sizeof(jobs[0]), n_jobs); \
+\
+    res = jobs[0]; \
+    for(size_t j = 1; j < n_jobs; j++){ \
+        res.acc += jobs[j].acc; \
+        if((op == _EV_OP_MIN || op == _EV_OP_ARGMIN) && jobs[j].val < res.val){ \
+            res.val = jobs[j].val; \
+            res.idx = jobs[j].idx; \
+        } \
+        if((op == _EV_OP_MAX || op == _EV_OP_ARGMAX) && jobs[j].val > res.val){ \
+            res.val = jobs[j].val; \
+            res.idx = jobs[j].idx; \
+        } \
+    } \
+\
+    if(op == _EV_OP_PREFIX && n_jobs > 1){ \
+        /* Each job scanned its own part, so carry the totals along */ \
+        T carry = jobs[0].val; \
+        for(size_t j = 1; j < n_jobs; j++){ \
+            const T part = jobs[j].val; \
+            jobs[j].op = _EV_OP_ADDK; \
+            jobs[j].k = carry; \
+            carry += part; \
+        } \
+        _evpar(_evrun_##S, (char*)(jobs + 1), sizeof(jobs[0]), n_jobs - 1); \
+    } \
+\
+    if(op == _EV_OP_SCALE || op == _EV_OP_ADD || op == _EV_OP_PREFIX){ \
+        _evincsync(EV_HDR(vec), vec, 0, INT64_MAX); \
+    } \
+    return res; \
+} \
+\
+A evsum_##S(T* vec) { return _evnum_##S(vec, NULL, _EV_OP_SUM, 0).acc; } \
+\
+A evdot_##S(T* a, T* b) \
+{ \
+    ifp(!b, \
+        EV_FAIL("Cannot take the dot product with a NULL vector\n"); \
+        return 0; \
+    ); \
+    return _evnum_##S(a, b, _EV_OP_DOT, 0).acc; \
+} \
+\
+T evmin_##S(T* vec) \
+{ \
+    ifp(!evcnt(vec), \
+        EV_FAIL("Cannot get the minimum of an empty vector\n"); \
+        return 0; \
+    ); \
+    return _evnum_##S(vec, NULL, _EV_OP_MIN, 0).val; \
+} \
+\
+T evmax_##S(T* vec) \
+{ \
+    ifp(!evcnt(vec), \
+        EV_FAIL("Cannot get the maximum of an empty vector\n"); \
+        return 0; \
+    ); \
+    return _evnum_##S(vec, NULL, _EV_OP_MAX, 0).val; \
+} \
+\
+size_t evargmin_##S(T* vec) { return _evnum_##S(vec, NULL, _EV_OP_ARGMIN, 0).idx; } \
+size_t evargmax_##S(T* vec) { return _evnum_##S(vec, NULL, _EV_OP_ARGMAX, 0).idx; } \
+void evscale_##S(T* vec, T k) { _evnum_##S(vec, NULL, _EV_OP_SCALE, k); } \
+\
+void evadd_##S(T* vec, T* src) \
+{ \
+    ifp(!src, \
+        EV_FAIL("Cannot add a NULL vector\n"); \
+        return; \
+    ); \
+    _evnum_##S(vec, src, _EV_OP_ADD, 0); \
+} \
+\
+void evprefix_##S(T* vec) { _evnum_##S(vec, NULL, _EV_OP_PREFIX, 0); }
+
+_EV_NUM_TYPES(_EV_NUM_IMPL)
+
+
+void* evmap(void* dst, void* src, size_t slt_size,
+            void (*fn)(void* out, const void* in, void* arg), void* arg)
+{
+    ifp(!fn,
+        EV_FAIL("Cannot map with a NULL function\n");
+        return NULL;
+    );
+
+    ifp(dst && dst == src,
+        EV_FAIL("Cannot map a vector onto itself\n");
+        return NULL;
+    );
+
+    if(!src){
+        return dst;
+    }
+
+    evhd_t* src_hdr = EV_HDR(src);
+    ifp(_evhdrcheck(src_hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    const size_t count = src_hdr->obj_count;
+    const char* in = src;
+
+    if(!dst){
+        dst = evini(slt_size, count);
+        if(!dst){
+            return NULL;
+        }
+    }
+
+    evhd_t* hdr = EV_HDR(dst);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    //Grow once, to fit everything
+    if(hdr->obj_count + count > hdr->slt_count){
+        dst = _evgrowto(dst, hdr->obj_count + count);
+        if(!dst){
+            return NULL;
+        }
+        hdr = EV_HDR(dst);
+    }
+
+    char* out = (char*)dst + hdr->slt_size * hdr->obj_count;
+    for(size_t i = 0; i < count; i++){
+        fn(out + hdr->slt_size * i, in + src_hdr->slt_size * i, arg);
+    }
+    hdr->obj_count += count;
+
+    EV_STAT_ADD(hdr, pushes, count);
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count);
+    _evincpush(hdr, dst, hdr->obj_count - count);
+
+    return dst;
+}
+#endif
+
+#if defined EV_FNUMA || defined EV_FALL
+int evnuma(void* vec, int policy, int node)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot set the NUMA policy of a NULL vector\n");
+        return -1;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    ifp(policy < EV_NUMA_DEFAULT || policy > EV_NUMA_BIND,
+        EV_FAIL("Unknown NUMA policy (%i)\n", policy);
+        return -1;
+    );
+
+    ifp(policy == EV_NUMA_BIND && (node < 0 || node >= 64 || !(_evnumamask() >> node & 1)),
+        EV_FAIL("NUMA node %i is not online\n", node);
+        return -1;
+    );
+
+    evext_t* ext = _evext(hdr);
+    if(!ext){
+        return -1;
+    }
+
+    ext->numa_policy = policy;
+    ext->numa_node   = policy == EV_NUMA_BIND ? node : 0;
+    _evnumabind(hdr, vec, hdr->slt_size * hdr->slt_count, EV_MPOL_MF_MOVE);
+
+    return 0;
+}
+
+
+int evnumanodes(void)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(_evnumamask());
+#else
+    int nodes = 0;
+    for(uint64_t mask = _evnumamask(); mask; mask &= mask - 1){
+        nodes++;
+    }
+    return nodes;
+#endif
+}
+
+
+int64_t evnumaplace(void* vec, size_t* pages, size_t max_nodes)
+{
+    ifp(!vec || !pages,
+        EV_FAIL("Cannot find the pages of a NULL vector\n");
+        return -1;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    memset(pages, 0x00, max_nodes * sizeof(*pages));
+
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    const uintptr_t lo   = (uintptr_t)vec / page * page;
+    const uintptr_t hi   = ((uintptr_t)vec + hdr->slt_size * hdr->slt_count + page - 1) / page * page;
+    int64_t total = 0;
+
+    //Ask the kernel where each page is, a batch at a time
+    enum { BATCH = 256 };
+    void* addrs[BATCH];
+    int status[BATCH];
+    for(uintptr_t p = lo; p < hi; p += BATCH * page){
+        const size_t n = (hi - p) / page < BATCH ? (hi - p) / page : BATCH;
+        for(size_t i = 0; i < n; i++){
+            addrs[i] = (void*)(p + i * page);
+        }
+
+#if defined __linux__
+        if(syscall(SYS_move_pages, 0, n, addrs, NULL, status, 0))
+#endif
+        {
+            //No NUMA support, so everything is on node 0
+            for(size_t i = 0; i < n; i++){
+                status[i] = 0;
+            }
+        }
+
+        for(size_t i = 0; i < n; i++){
+            if(status[i] < 0){
+                continue; //Not touched yet, so not anywhere
+            }
+            total++;
+            if((size_t)status[i] < max_nodes){
+                pages[status[i]]++;
+            }
+        }
+    }
+
+    return total;
+}
+#endif
+
+#if defined EV_FHUGE || defined EV_FALL
+void evhuge(void* vec, size_t threshold, int64_t flags)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot set huge pages on a NULL vector\n");
+        return;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return;
+    );
+
+    ifp(flags & ~EV_FLAG_HUGETLB,
+        EV_FAIL("Unknown huge page flags (0x%" PRIx64 ")\n", flags);
+        return;
+    );
+
+    evext_t* ext = _evext(hdr);
+    if(!ext){
+        return;
+    }
+
+    ext->hp_limit = threshold;
+    hdr->flags    = (hdr->flags & ~EV_FLAG_HUGETLB) | flags;
+}
+
+
+int64_t evhugebytes(void* vec)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot count huge pages of a NULL vector\n");
+        return -1;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    FILE* f = fopen("/proc/self/smaps", "r");
+    if(!f){
+        return 0; //No way to tell, so assume none
+    }
+
+    //Each mapping is a "start-end perms ..." line, followed by its counters
+    const uintptr_t lo = (uintptr_t)vec;
+    const uintptr_t hi = lo + hdr->slt_size * hdr->slt_count;
+    uintptr_t overlap = 0;
+    int64_t total = 0;
+    char line[512];
+    while(fgets(line, sizeof(line), f)){
+        uintptr_t start = 0;
+        uintptr_t end = 0;
+        if(sscanf(line, "%" SCNxPTR "-%" SCNxPTR " ", &start, &end) == 2){
+            const uintptr_t from = start > lo ? start : lo;
+            const uintptr_t to   = end < hi ? end : hi;
+            overlap = to > from ? to - from : 0;
+            continue;
+        }
+
+        size_t kb = 0;
+        if(overlap && (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1 ||
+                       sscanf(line, "Private_Hugetlb: %zu kB", &kb) == 1 ||
+                       sscanf(line, "Shared_Hugetlb: %zu kB", &kb) == 1)){
+            //The mapping may be bigger than the vector, so only count the overlap
+            const uintptr_t bytes = (uintptr_t)kb * 1024;
+            total += bytes < overlap ? bytes : overlap;
+            overlap -= bytes < overlap ? bytes : overlap;
+        }
+    }
+    fclose(f);
+
+    return total;
+}
+#endif
+
+#if defined EV_FSHM || defined EV_FALL
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+//The writer publishes with release stores, and readers pick up with acquire
+//loads, so that a reader never sees a count or generation before the data
+#ifdef __GNUC__
+#define _EV_SHM_LOAD(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define _EV_SHM_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+#define _EV_SHM_LOAD(p) (*(volatile int64_t*)(p))
+#define _EV_SHM_STORE(p, v) (*(volatile int64_t*)(p) = (v))
+#endif
+
+#define _EV_SHM_SEG(sh) ((evshhd_t*)(sh)->base)
+#define _EV_SHM_HDR(sh) ((evhd_t*)((sh)->base + _EV_SHM_SEG(sh)->hdr_off))
+
+//Check that the shared memory vector handle is sane
+int _evshhdrcheck(evsh_t* sh)
+{
+    if(strncmp(sh->magic1, EV_SHM_MAGIC1, sizeof(EV_SHM_MAGIC1)) != 0){
+        EV_FAIL("Header magic 1 should be '%s' but found '%.*s'\n", EV_SHM_MAGIC1, sizeof(EV_SHM_MAGIC1), sh->magic1);
+        return -1;
+    };
+    if(strncmp(sh->magic2, EV_SHM_MAGIC2, sizeof(EV_SHM_MAGIC2)) != 0){
+        EV_FAIL("Header magic 2 should be '%s' but found '%.*s'\n", EV_SHM_MAGIC2, sizeof(EV_SHM_MAGIC2), sh->magic2);
+        return -1;
+    };
+
+    return 0;
+}
+
+//Internal function, the number of slots that fit in this process's mapping
+static inline int64_t _evshslts(evsh_t* sh)
+{
+    const evhd_t* hdr = _EV_SHM_HDR(sh);
+    return (sh->map_bytes - _EV_SHM_SEG(sh)->hdr_off - EV_HDR_BYTES) / hdr->slt_size;
+}
+
+//Internal function, map the first bytes of the segment, in place of any
+//earlier mapping. The segment only grows, so everything stays at the same
+//offset and nothing is copied.
+static int _evshmap(evsh_t* sh, size_t bytes)
+{
+    const int prot = sh->flags & EV_FLAG_SHM_RDWR ? PROT_READ | PROT_WRITE : PROT_READ;
+    char* base = (char*)mmap(NULL, bytes, prot, MAP_SHARED, sh->fd, 0);
+    if(base == MAP_FAILED){
+        EV_FAIL("Could not map %zuB of shared memory segment\n", bytes);
+        return -1;
+    }
+
+    if(sh->base){
+        munmap(sh->base, sh->map_bytes);
+    }
+    sh->base      = base;
+    sh->map_bytes = bytes;
+    return 0;
+}
+
+//Internal function, map the segment again if another process has grown it
+static int _evshsync(evsh_t* sh)
+{
+    evshhd_t* seg = _EV_SHM_SEG(sh);
+    const int64_t gen = _EV_SHM_LOAD(&seg->gen);
+    if(gen == sh->gen){
+        return 0;
+    }
+
+    //Read after the generation, so the segment is at least this big already
+    const int64_t seg_bytes = seg->seg_bytes;
+    if(seg_bytes != sh->map_bytes && _evshmap(sh, seg_bytes)){
+        return -1;
+    }
+    sh->gen = gen;
+    return 0;
+}
+
+//Internal function, grow the segment to hold at least min_slts slots, or by
+//the growth policy if that is more
+static int _evshgrow(evsh_t* sh, size_t min_slts)
+{
+    evhd_t* hdr                 = _EV_SHM_HDR(sh);
+    const int64_t hdr_off       = _EV_SHM_SEG(sh)->hdr_off;
+    const size_t page           = sysconf(_SC_PAGESIZE);
+    size_t new_slt_count        = _evgrwslts(hdr);
+    new_slt_count               = new_slt_count > min_slts ? new_slt_count : min_slts;
+    const size_t seg_bytes      = EV_ALIGN_UP(hdr_off + EV_HDR_BYTES + new_slt_count * hdr->slt_size, page);
+
+    //Grow the segment before the mapping, so that readers never map past its end
+    if(ftruncate(sh->fd, seg_bytes)){
+        EV_FAIL("No memory to grow shared memory segment up to %zuB\n", seg_bytes);
+        return -1;
+    }
+    if(_evshmap(sh, seg_bytes)){
+        return -1;
+    }
+
+    evshhd_t* seg   = _EV_SHM_SEG(sh);
+    hdr             = _EV_SHM_HDR(sh);
+    hdr->slt_count  = _evshslts(sh);
+    seg->seg_bytes  = seg_bytes;
+    sh->gen         = seg->gen + 1;
+    _EV_SHM_STORE(&seg->gen, sh->gen);
+
+    EV_STAT_ADD(hdr, grows, 1);
+    EV_STAT_MAX(hdr, peak_slots, hdr->slt_count);
+    return 0;
+}
+
+evsh_t* evshini(const char* name, size_t slt_size, size_t count)
+{
+    ifp(!name,
+        EV_FAIL("Shared memory segment name cannot be NULL\n");
+        return NULL;
+    );
+
+    ifp(slt_size == 0,
+        EV_FAIL("Slot size cannot be zero\n");
+        return NULL;
+    );
+
+    evsh_t* sh = (evsh_t*)calloc(1, sizeof(evsh_t));
+    ifp(!sh,
+        EV_FAIL("No memory to init shared memory vector with %zuB\n", sizeof(evsh_t));
+        return NULL;
+    );
+    memcpy(sh->magic1,EV_SHM_MAGIC1,sizeof(sh->magic1));
+    memcpy(sh->magic2,EV_SHM_MAGIC2,sizeof(sh->magic2));
+    sh->flags = EV_FLAG_SHM_RDWR;
+
+    sh->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, EV_SHM_MODE);
+    if(sh->fd < 0){
+        EV_FAIL("Could not create shared memory segment '%s'\n", name);
+        free(sh);
+        return NULL;
+    }
+
+    //Offsets rather than pointers, so the segment can be mapped anywhere
+    const size_t page       = sysconf(_SC_PAGESIZE);
+    const size_t hdr_off    = EV_ALIGN_UP(sizeof(evshhd_t), EV_ALIGNOF(align));
+    const size_t seg_bytes  = EV_ALIGN_UP(hdr_off + EV_HDR_BYTES + count * slt_size, page);
+    if(ftruncate(sh->fd, seg_bytes) || _evshmap(sh, seg_bytes)){
+        EV_FAIL("No memory to init shared memory vector with %zuB\n", seg_bytes);
+        shm_unlink(name);
+        close(sh->fd);
+        free(sh);
+        return NULL;
+    }
+
+    //The segment is zero already. Its header is shared between processes, so
+    //the vector has no extension block and is not in the registry.
+    evshhd_t* seg   = _EV_SHM_SEG(sh);
+    evhd_t* hdr     = (evhd_t*)(sh->base + hdr_off);
+    seg->hdr_off    = hdr_off;
+    _evhdrinit(hdr, slt_size, (seg_bytes - hdr_off - EV_HDR_BYTES) / slt_size, EV_FLAG_SHM);
+
+    seg->hdr_bytes  = EV_HDR_BYTES;
+    seg->seg_bytes  = seg_bytes;
+    memcpy(seg->magic1,EV_SHM_SEG_MAGIC1,sizeof(seg->magic1));
+    memcpy(seg->magic2,EV_SHM_SEG_MAGIC2,sizeof(seg->magic2));
+
+    return sh;
+}
+
+evsh_t* evshopen(const char* name, int64_t flags)
+{
+    ifp(!name,
+        EV_FAIL("Shared memory segment name cannot be NULL\n");
+        return NULL;
+    );
+
+    ifp(flags & ~EV_FLAG_SHM_RDWR,
+        EV_FAIL("Unknown shared memory flags (0x%" PRIx64 ")\n", flags);
+        return NULL;
+    );
+
+    evsh_t* sh = (evsh_t*)calloc(1, sizeof(evsh_t));
+    ifp(!sh,
+        EV_FAIL("No memory to attach shared memory vector with %zuB\n", sizeof(evsh_t));
+        return NULL;
+    );
+    memcpy(sh->magic1,EV_SHM_MAGIC1,sizeof(sh->magic1));
+    memcpy(sh->magic2,EV_SHM_MAGIC2,sizeof(sh->magic2));
+    sh->flags = flags;
+
+    sh->fd = shm_open(name, flags & EV_FLAG_SHM_RDWR ? O_RDWR : O_RDONLY, 0);
+    if(sh->fd < 0){
+        EV_FAIL("Could not open shared memory segment '%s'\n", name);
+        free(sh);
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(sh->fd, &st) || (size_t)st.st_size < sizeof(evshhd_t) || _evshmap(sh, st.st_size)){
+        EV_FAIL("Shared memory segment '%s' is not a vector\n", name);
+        close(sh->fd);
+        free(sh);
+        return NULL;
+    }
+
+    evshhd_t* seg = _EV_SHM_SEG(sh);
+    if(strncmp(seg->magic1, EV_SHM_SEG_MAGIC1, sizeof(EV_SHM_SEG_MAGIC1)) != 0 ||
+       strncmp(seg->magic2, EV_SHM_SEG_MAGIC2, sizeof(EV_SHM_SEG_MAGIC2)) != 0){
+        EV_FAIL("Shared memory segment '%s' is not a vector\n", name);
+        evshfree(sh);
+        return NULL;
+    }
+
+    if(seg->hdr_bytes != (int64_t)EV_HDR_BYTES){
+        EV_FAIL("Shared memory vector header is %" PRId64 "B but should be %zuB, "
+                "both sides must use the same header layout\n", seg->hdr_bytes, EV_HDR_BYTES);
+        evshfree(sh);
+        return NULL;
+    }
+
+    //If the segment grew while it was being mapped, map it again next time
+    sh->gen = _EV_SHM_LOAD(&seg->gen);
+    if(seg->seg_bytes > sh->map_bytes){
+        sh->gen = -1;
+    }
+
+    evhd_t* hdr = _EV_SHM_HDR(sh);
+    if(_evhdrcheck(hdr)){
+        EV_FAIL("Header sanity check failed\n");
+        evshfree(sh);
+        return NULL;
+    }
+
+    return sh;
+}
+
+void* evshvec(evsh_t* sh)
+{
+    ifp(!sh,
+        EV_FAIL("Cannot get the vector of a NULL shared memory vector\n");
+        return NULL;
+    );
+
+    ifp(_evshhdrcheck(sh),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    if(_evshsync(sh)){
+        return NULL;
+    }
+
+    return (char*)_EV_SHM_HDR(sh) + EV_HDR_BYTES;
+}
+
+size_t evshcnt(evsh_t* sh)
+{
+    if(!sh){
+        return 0;
+    }
+
+    ifp(_evshhdrcheck(sh),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
+    );
+
+    //The writer may have pushed past the end of this process's mapping
+    const int64_t count = _EV_SHM_LOAD(&_EV_SHM_HDR(sh)->obj_count);
+    const int64_t slts  = _evshslts(sh);
+    return count < slts ? count : slts;
+}
+
+int64_t evshgen(evsh_t* sh)
+{
+    ifp(!sh,
+        EV_FAIL("Cannot get the generation of a NULL shared memory vector\n");
+        return -1;
+    );
+
+    ifp(_evshhdrcheck(sh),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    return _EV_SHM_LOAD(&_EV_SHM_SEG(sh)->gen);
+}
+
+void* evshpush(evsh_t* sh, void* obj, size_t obj_size)
+{
+    ifp(!sh,
+        EV_FAIL("Cannot push into a NULL shared memory vector\n");
+        return NULL;
+    );
+
+    ifp(_evshhdrcheck(sh),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(!(sh->flags & EV_FLAG_SHM_RDWR),
+        EV_FAIL("Cannot push into a read only shared memory vector\n");
+        return NULL;
+    );
+
+    if(_evshsync(sh)){
+        return NULL;
+    }
+
+    evhd_t* hdr = _EV_SHM_HDR(sh);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(obj_size > (size_t)hdr->slt_size,
+        EV_FAIL("Object size (%zu) is larger than there is space (%" PRId64 ")\n",
+                obj_size,
+                (int64_t)hdr->slt_size);
+        return NULL;
+    );
+
+    if(hdr->obj_count == hdr->slt_count){
+        if(_evshgrow(sh, 0)){
+            return NULL;
+        }
+        hdr = _EV_SHM_HDR(sh);
+    }
+
+    char* vec = (char*)hdr + EV_HDR_BYTES;
+    memcpy(vec + hdr->slt_size * hdr->obj_count, obj, obj_size);
+    _EV_SHM_STORE(&hdr->obj_count, hdr->obj_count + 1);
+
+    EV_STAT_ADD(hdr, pushes, 1);
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count);
+
+    return vec;
+}
+
+evsh_t* evshfree(evsh_t* sh)
+{
+    if(!sh){
+        return NULL;
+    }
+
+    ifp(_evshhdrcheck(sh),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    if(sh->base){
+        munmap(sh->base, sh->map_bytes);
+    }
+    close(sh->fd);
+    free(sh);
+
+    return NULL;
+}
+
+int evshunlink(const char* name)
+{
+    ifp(!name,
+        EV_FAIL("Shared memory segment name cannot be NULL\n");
+        return -1;
+    );
+
+    return shm_unlink(name);
+}
+#endif
+
+#if defined EV_FRCU || defined EV_FALL
+//Readers publish their epoch before they look at the vector, and the writer
+//publishes the vector before it bumps the epoch, so these must not be reordered
+#ifdef __GNUC__
+#define _EV_RCU_LOAD(p) __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define _EV_RCU_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_SEQ_CST)
+#define _EV_RCU_CLAIM(p) __extension__ ({ int64_t __FREE__ = 0; \
+    __atomic_compare_exchange_n(p, &__FREE__, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED); })
+#else
+#define _EV_RCU_LOAD(p) (*(p))
+#define _EV_RCU_STORE(p, v) (*(p) = (v))
+#define _EV_RCU_CLAIM(p) (*(p) ? 0 : (*(p) = 1, 1))
+#endif
+
+//Storage that has been replaced, and the epoch it was replaced in
+typedef struct {
+    void* vec;
+    int64_t epoch;
+} evrcold_t;
+
+//Check that the epoch vector header is sane
+int _evrchdrcheck(evrc_t* rc)
+{
+    if(strncmp(rc->magic1, EV_RCU_MAGIC1, sizeof(EV_RCU_MAGIC1)) != 0){
+        EV_FAIL("Header magic 1 should be '%s' but found '%.*s'\n", EV_RCU_MAGIC1, sizeof(EV_RCU_MAGIC1), rc->magic1);
+        return -1;
+    };
+    if(strncmp(rc->magic2, EV_RCU_MAGIC2, sizeof(EV_RCU_MAGIC2)) != 0){
+        EV_FAIL("Header magic 2 should be '%s' but found '%.*s'\n", EV_RCU_MAGIC2, sizeof(EV_RCU_MAGIC2), rc->magic2);
+        return -1;
+    };
+
+    return 0;
+}
+
+//Internal function, free storage that belonged to an epoch vector
+static inline void _evrcfreevec(void* vec)
+{
+    evhd_t* hdr = EV_HDR(vec);
+    evext_t* ext = hdr->ext;
+    _evstunreg(hdr);
+    _evfreebase(hdr);
+    free(ext);
+}
+
+//Internal function, copy the items into bigger storage and publish it. The old
+//storage is kept until no reader can see it. Readers never see realloc().
+static void* _evrcgrow(evrc_t* rc)
+{
+    void* const old     = rc->vec;
+    evhd_t* old_hdr     = EV_HDR(old);
+    const size_t count  = old_hdr->obj_count;
+
+    void* vec = evini(old_hdr->slt_size, _evgrwslts(old_hdr));
+    if(!vec){
+        EV_FAIL("No memory to grow epoch vector\n");
+        return NULL;
+    }
+
+    evhd_t* hdr = EV_HDR(vec);
+    memcpy(vec, old, old_hdr->slt_size * count);
+    hdr->obj_count  = count;
+    hdr->flags      = old_hdr->flags;
+    if(_evextcpy(hdr, old_hdr)){
+        _evrcfreevec(vec);
+        return NULL;
+    }
+    if(hdr->ext && old_hdr->ext){
+        //The old storage is retired, so the new one takes over its history
+        hdr->ext->stats    = old_hdr->ext->stats;
+        hdr->ext->tr_file  = old_hdr->ext->tr_file;
+        hdr->ext->tr_line  = old_hdr->ext->tr_line;
+        hdr->ext->tr_grows = old_hdr->ext->tr_grows + 1;
+    }
+    EV_STAT_ADD(hdr, grows, 1);
+    EV_STAT_ADD(hdr, copy_bytes, old_hdr->slt_size * count);
+    EV_STAT_MAX(hdr, peak_slots, hdr->slt_count);
+
+    //Readers that entered before the epoch moves on may still see the old copy
+    const evrcold_t retired = { old, rc->epoch };
+    void* list = evpush(rc->retired, (void*)&retired, sizeof(retired));
+    if(!list){
+        EV_FAIL("No memory to retire epoch vector storage\n");
+        _evrcfreevec(vec);
+        return NULL;
+    }
+    rc->retired = list;
+    _evstunreg(old_hdr);
+
+    _EV_RCU_STORE(&rc->vec, vec);
+    _EV_RCU_STORE(&rc->epoch, rc->epoch + 1);
+
+    evrcsync(rc);
+    return vec;
+}
+
+evrc_t* evrcini(size_t slt_size, size_t count)
+{
+    ifp(slt_size == 0,
+        EV_FAIL("Slot size cannot be zero\n");
+        return NULL;
+    );
+
+    //Cache line aligned, so that the readers do not share one with the writer
+    evrc_t* rc = NULL;
+    if(posix_memalign((void**)&rc, 64, sizeof(evrc_t))){
+        EV_FAIL("No memory to init epoch vector with %zuB\n", sizeof(evrc_t));
+        return NULL;
+    }
+    memset(rc, 0x00, sizeof(evrc_t));
+
+    rc->vec = evini(slt_size, count);
+    if(!rc->vec){
+        free(rc);
+        return NULL;
+    }
+    EV_HDR(rc->vec)->flags |= EV_FLAG_RCU;
+
+    memcpy(rc->magic1,EV_RCU_MAGIC1,sizeof(rc->magic1));
+    rc->epoch = 1; //Readers use 0 to say they are not in an epoch
+    memcpy(rc->magic2,EV_RCU_MAGIC2,sizeof(rc->magic2));
+
+    return rc;
+}
+
+void* evrcpush(evrc_t* rc, void* obj, size_t obj_size)
+{
+    ifp(!rc,
+        EV_FAIL("Cannot push into a NULL epoch vector\n");
+        return NULL;
+    );
+
+    ifp(_evrchdrcheck(rc),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    void* vec   = rc->vec;
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(obj_size > (size_t)hdr->slt_size,
+        EV_FAIL("Object size (%zu) is larger than there is space (%" PRId64 ")\n",
+                obj_size,
+                (int64_t)hdr->slt_size);
+        return NULL;
+    );
+
+    if(hdr->obj_count == hdr->slt_count){
+        vec = _evrcgrow(rc);
+        if(!vec){
+            return NULL;
+        }
+        hdr = EV_HDR(vec);
+    }
+
+    //Copy the item in before the count, so that readers never see it half done
+    memcpy((char*)vec + hdr->slt_size * hdr->obj_count, obj, obj_size);
+    _EV_RCU_STORE(&hdr->obj_count, hdr->obj_count + 1);
+
+    EV_STAT_ADD(hdr, pushes, 1);
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count);
+
+    return vec;
+}
+
+int evrcreg(evrc_t* rc)
+{
+    ifp(!rc,
+        EV_FAIL("Cannot register a reader of a NULL epoch vector\n");
+        return -1;
+    );
+
+    ifp(_evrchdrcheck(rc),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    for(int i = 0; i < EV_RCU_READERS; i++){
+        if(_EV_RCU_CLAIM(&rc->readers[i].used)){
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void evrcunreg(evrc_t* rc, int reader)
+{
+    ifp(!rc,
+        EV_FAIL("Cannot unregister a reader of a NULL epoch vector\n");
+        return;
+    );
+
+    ifp(reader < 0 || reader >= EV_RCU_READERS,
+        EV_FAIL("Reader (%i) must be from 0 to %i\n", reader, EV_RCU_READERS - 1);
+        return;
+    );
+
+    ifp(_EV_RCU_LOAD(&rc->readers[reader].epoch),
+        EV_FAIL("Reader (%i) is still in an epoch\n", reader);
+        return;
+    );
+
+    _EV_RCU_STORE(&rc->readers[reader].used, 0);
+}
+
+void* evrcenter(evrc_t* rc, int reader, size_t* count)
+{
+    ifp(!rc,
+        EV_FAIL("Cannot read a NULL epoch vector\n");
+        return NULL;
+    );
+
+    ifp(_evrchdrcheck(rc),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(reader < 0 || reader >= EV_RCU_READERS || !_EV_RCU_LOAD(&rc->readers[reader].used),
+        EV_FAIL("Reader (%i) has not been registered\n", reader);
+        return NULL;
+    );
+
+    evrcrd_t* rd = &rc->readers[reader];
+    _EV_RCU_STORE(&rd->epoch, _EV_RCU_LOAD(&rc->epoch));
+
+    void* vec = _EV_RCU_LOAD(&rc->vec);
+    if(count){
+        *count = _EV_RCU_LOAD(&EV_HDR(vec)->obj_count);
+    }
+    return vec;
+}
+
+void evrcexit(evrc_t* rc, int reader)
+{
+    ifp(!rc,
+        EV_FAIL("Cannot exit a NULL epoch vector\n");
+        return;
+    );
+
+    ifp(reader < 0 || reader >= EV_RCU_READERS,
+        EV_FAIL("Reader (%i) must be from 0 to %i\n", reader, EV_RCU_READERS - 1);
+        return;
+    );
+
+    _EV_RCU_STORE(&rc->readers[reader].epoch, 0);
+}
+
+size_t evrcsync(evrc_t* rc)
+{
+    ifp(!rc,
+        EV_FAIL("Cannot sync a NULL epoch vector\n");
+        return 0;
+    );
+
+    ifp(_evrchdrcheck(rc),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
+    );
+
+    if(!rc->retired){
+        return 0;
+    }
+
+    //Storage replaced before the oldest epoch that a reader is in is unseen
+    int64_t oldest = INT64_MAX;
+    for(int i = 0; i < EV_RCU_READERS; i++){
+        const int64_t epoch = _EV_RCU_LOAD(&rc->readers[i].epoch);
+        if(epoch && epoch < oldest){
+            oldest = epoch;
+        }
+    }
+
+    evrcold_t* old = (evrcold_t*)rc->retired;
+    const size_t count = evcnt(old);
+    size_t keep = 0;
+    for(size_t i = 0; i < count; i++){
+        if(old[i].epoch < oldest){
+            _evrcfreevec(old[i].vec);
+        }
+        else{
+            old[keep++] = old[i];
+        }
+    }
+    EV_HDR(old)->obj_count = keep;
+
+    return keep;
+}
+
+evrc_t* evrcfree(evrc_t* rc)
+{
+    if(!rc){
+        return NULL;
+    }
+
+    ifp(_evrchdrcheck(rc),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    for(int i = 0; i < EV_RCU_READERS; i++){
+        ifp(rc->readers[i].epoch,
+            EV_FAIL("Reader (%i) is still in an epoch\n", i);
+            return NULL;
+        );
+    }
+
+    evrcsync(rc);
+    rc->retired = evfree(rc->retired);
+    _evrcfreevec(rc->vec);
+    free(rc);
+
+    return NULL;
 }
+#endif
 
-/*
- * This debugging code liberally borrowed and adapted from libchaste by
- * M.Grosvenor BSD 3 clause license. https://github.com/mgrosvenor/libchaste
- */
-typedef enum {
-    EV_MSG_DBG,
-    EV_MSG_WARN,
-    EV_MSG_ERR,
-} evdbg_e;
+#if defined EV_FBITS || defined EV_FALL
+#ifdef __GNUC__
+#define _evpopcnt(w) __builtin_popcountll(w)
+#define _evctz(w) __builtin_ctzll(w)
+#else
+static inline int _evpopcnt(uint64_t w)
+{
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((w * 0x0101010101010101ULL) >> 56);
+}
 
-#define EV_FAIL( /*format, args*/...)  everr_helper(__VA_ARGS__, "")
-#define everr_helper(format, ...) _evmsg(EV_MSG_ERR, __LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
-#define EV_WARN( /*format, args*/...)  evwarn_helper(__VA_ARGS__, "")
-#define evwarn_helper(format, ...) _evmsg(EV_MSG_WARN,__LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
+//w must not be 0
+static inline int _evctz(uint64_t w)
+{
+    int n = 0;
+    while(!(w & 1)){
+        w >>= 1;
+        n++;
+    }
+    return n;
+}
+#endif
 
-#if EV_DEBUG
-#define EV_DBG( /*format, args*/...)  evdebug_helper(__VA_ARGS__, "")
-    #define evdebug_helper(format, ...) _evmsg(EV_MSG_DBG,__LINE__, __FILE__, __FUNCTION__, format, __VA_ARGS__ )
+//Check that the header belongs to a sane bit vector
+static int _evbitscheck(evhd_t* hdr)
+{
+    if(_evhdrcheck(hdr)){
+        return -1;
+    }
+
+    if(hdr->slt_size != sizeof(uint64_t)){
+        EV_FAIL("Bit vector slots should be %zuB but are %" PRId64 "B\n", sizeof(uint64_t), hdr->slt_size);
+        return -1;
+    }
+
+    if(EV_EXTGET(hdr, bit_count) > hdr->obj_count * 64){
+        EV_FAIL("More bits in vector (%" PRId64 ") than there are words for (%" PRId64 ")\n",
+                EV_EXTGET(hdr, bit_count),
+                hdr->obj_count);
+        return -1;
+    }
+
+    return 0;
+}
+
+uint64_t* evbitsini(size_t count)
+{
+    return (uint64_t*)evini(sizeof(uint64_t), (count + 63) / 64);
+}
+
+uint64_t* evbitspush(uint64_t* bits, int bit)
+{
+    if(!bits){
+        bits = (uint64_t*)evini(sizeof(uint64_t), EV_INIT_COUNT);
+        if(!bits){
+            return NULL;
+        }
+    }
+
+    evhd_t* hdr = EV_HDR(bits);
+    ifp(_evbitscheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    if(EV_EXTGET(hdr, bit_count) == hdr->obj_count * 64){
+        //Out of bits in the last word, so start a new one
+        const uint64_t word = 0;
+        bits = (uint64_t*)evpush(bits, (void*)&word, sizeof(word));
+        if(!bits){
+            return NULL;
+        }
+        hdr = EV_HDR(bits);
+    }
+
+    evext_t* ext = _evext(hdr);
+    if(!ext){
+        return NULL;
+    }
+
+    const int64_t idx = ext->bit_count++;
+    if(bit){
+        bits[idx / 64] |= 1ULL << (idx % 64);
+    }
+
+    return bits;
+}
+
+size_t evbitscnt(uint64_t* bits)
+{
+    if(!bits){
+        return 0;
+    }
+
+    evhd_t* hdr = EV_HDR(bits);
+    ifp(_evbitscheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
+    );
+
+    return EV_EXTGET(hdr, bit_count);
+}
+
+//Internal function, check that a bit can be read or written
+static inline int _evbitsidx(uint64_t* bits, size_t idx)
+{
+    if(!bits){
+        EV_FAIL("Cannot index a NULL bit vector\n");
+        return -1;
+    }
+
+    evhd_t* hdr = EV_HDR(bits);
+    if(_evbitscheck(hdr)){
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    }
+
+    if(idx >= (size_t)EV_EXTGET(hdr, bit_count)){
+        EV_FAIL("Index cannot be greater than number of bits (idx=%zu >= %" PRId64 ")\n",
+                idx,
+                EV_EXTGET(hdr, bit_count));
+        return -1;
+    }
+
+    return 0;
+}
+
+int evbitsget(uint64_t* bits, size_t idx)
+{
+    ifp(_evbitsidx(bits, idx),
+        return 0;
+    );
+
+    return (bits[idx / 64] >> (idx % 64)) & 1;
+}
+
+void evbitsset(uint64_t* bits, size_t idx)
+{
+    ifp(_evbitsidx(bits, idx),
+        return;
+    );
+
+    bits[idx / 64] |= 1ULL << (idx % 64);
+}
+
+void evbitsclr(uint64_t* bits, size_t idx)
+{
+    ifp(_evbitsidx(bits, idx),
+        return;
+    );
+
+    bits[idx / 64] &= ~(1ULL << (idx % 64));
+}
+
+size_t evbitspopcnt(uint64_t* bits)
+{
+    if(!bits){
+        return 0;
+    }
+
+    evhd_t* hdr = EV_HDR(bits);
+    ifp(_evbitscheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
+    );
+
+    //Independent counts, so that several words are in flight at once
+    const size_t n = hdr->obj_count;
+    size_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4){
+        c0 += _evpopcnt(bits[i + 0]);
+        c1 += _evpopcnt(bits[i + 1]);
+        c2 += _evpopcnt(bits[i + 2]);
+        c3 += _evpopcnt(bits[i + 3]);
+    }
+    for(; i < n; i++){
+        c0 += _evpopcnt(bits[i]);
+    }
+
+    return c0 + c1 + c2 + c3;
+}
+
+int64_t evbitsffs(uint64_t* bits, size_t from)
+{
+    if(!bits){
+        return -1;
+    }
+
+    evhd_t* hdr = EV_HDR(bits);
+    ifp(_evbitscheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    if(from >= (size_t)EV_EXTGET(hdr, bit_count)){
+        return -1;
+    }
+
+    //Bits past the end are always 0, so there is no need to stop at bit_count
+    const size_t n = hdr->obj_count;
+    size_t i = from / 64;
+    uint64_t word = bits[i] & (~0ULL << (from % 64));
+    while(!word){
+        if(++i == n){
+            return -1;
+        }
+        word = bits[i];
+    }
+
+    return i * 64 + _evctz(word);
+}
+
+//The same length means the same number of words, and bits past the end stay 0
+#define _EV_BITS_OP(name, op) \
+void name(uint64_t* dst, uint64_t* src) \
+{ \
+    ifp(!dst || !src, \
+        EV_FAIL("Cannot combine NULL bit vectors\n"); \
+        return; \
+    ); \
+    evhd_t* dst_hdr = EV_HDR(dst); \
+    ifp(_evbitscheck(dst_hdr) || _evbitscheck(EV_HDR(src)), \
+        EV_FAIL("Header sanity check failed\n"); \
+        return; \
+    ); \
+    ifp(EV_EXTGET(dst_hdr, bit_count) != EV_EXTGET(EV_HDR(src), bit_count), \
+        EV_FAIL("Bit vectors must be the same length (%" PRId64 " != %" PRId64 ")\n", \
+                EV_EXTGET(dst_hdr, bit_count), EV_EXTGET(EV_HDR(src), bit_count)); \
+        return; \
+    ); \
+    const size_t n = dst_hdr->obj_count; \
+    for(size_t i = 0; i < n; i++){ \
+        dst[i] op src[i]; \
+    } \
+}
+
+_EV_BITS_OP(evbitsand, &=)
+_EV_BITS_OP(evbitsor,  |=)
+_EV_BITS_OP(evbitsxor, ^=)
+#endif
+
+#if defined EV_FPACK || defined EV_FALL
+#define _EV_PK_OFF(bk) ((bk)->off_width >> 8)
+#define _EV_PK_WIDTH(bk) ((int)((bk)->off_width & 0xFF))
+
+//Check that the packed integer vector header is sane
+int _evpkhdrcheck(evpk_t* pk)
+{
+    if(strncmp(pk->magic1, EV_PK_MAGIC1, sizeof(EV_PK_MAGIC1)) != 0){
+        EV_FAIL("Header magic 1 should be '%s' but found '%.*s'\n", EV_PK_MAGIC1, sizeof(EV_PK_MAGIC1), pk->magic1);
+        return -1;
+    };
+    if(strncmp(pk->magic2, EV_PK_MAGIC2, sizeof(EV_PK_MAGIC2)) != 0){
+        EV_FAIL("Header magic 2 should be '%s' but found '%.*s'\n", EV_PK_MAGIC2, sizeof(EV_PK_MAGIC2), pk->magic2);
+        return -1;
+    };
+
+    if(pk->obj_count < 0){
+        EV_FAIL("Object count cannot be less than zero!\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+//Internal function, read the packed difference i of a block, w must be 1 to
+//64. Slot 0 is unused, so that a block of width w is exactly 2 x w words.
+static inline uint64_t _evpkres(const uint64_t* in, int w, size_t i)
+{
+    const size_t bit    = i * w;
+    const size_t word   = bit / 64;
+    const int shift     = bit % 64;
+    uint64_t r = in[word] >> shift;
+    if(shift + w > 64){
+        r |= in[word + 1] << (64 - shift);
+    }
+    return w == 64 ? r : r & ((1ULL << w) - 1);
+}
+
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#ifdef __GNUC__
+#define _EV_PK_INLINE static inline __attribute__((always_inline))
+#define _EV_PK_UNROLL _Pragma("GCC unroll 8")
 #else
-#define EV_DBG( /*format, args*/...)
+#define _EV_PK_INLINE static inline
+#define _EV_PK_UNROLL
 #endif
 
+//Internal function, unpack the differences of a block 8 at a time. 8 values
+//of w bits take exactly w bytes, and on a little endian machine bit b of the
+//block is bit b % 8 of byte b / 8. So each value is one unaligned load, then a
+//shift and mask by constants, once w is a constant. This reads up to 8 bytes
+//past the block, so there is always a spare word after the last block.
+_EV_PK_INLINE void _evpkoct(const unsigned char* in, int w, uint64_t* res)
+{
+    for(size_t g = 0; g < EV_PK_BLOCK / 8; g++){
+        _EV_PK_UNROLL
+        for(size_t k = 0; k < 8; k++){
+            uint64_t r;
+            memcpy(&r, in + g * w + k * w / 8, sizeof(r));
+            res[g * 8 + k] = (r >> (k * w % 8)) & ((1ULL << w) - 1);
+        }
+    }
+}
+
+//Widths up to 56 fit in one load whatever the shift, wider ones go the slow way
+#define _EV_PK_UNPACK(w) \
+    case w: \
+        _evpkoct((const unsigned char*)in, w, res); \
+        break;
+#define _EV_PK_UNPACK8(w) \
+    _EV_PK_UNPACK(w + 1) _EV_PK_UNPACK(w + 2) _EV_PK_UNPACK(w + 3) _EV_PK_UNPACK(w + 4) \
+    _EV_PK_UNPACK(w + 5) _EV_PK_UNPACK(w + 6) _EV_PK_UNPACK(w + 7) _EV_PK_UNPACK(w + 8)
+#define _EV_PK_UNPACKS \
+    _EV_PK_UNPACK8(0)  _EV_PK_UNPACK8(8)  _EV_PK_UNPACK8(16) \
+    _EV_PK_UNPACK8(24) _EV_PK_UNPACK8(32) _EV_PK_UNPACK8(40) _EV_PK_UNPACK8(48)
+#else
+#define _EV_PK_UNPACKS
+#endif
 
-static inline void _evmsg(evdbg_e mode, int ln, char* fn, const char* fu, const char* msg, ... )
+//Internal function, unpack a whole block. Unpacking and summing are separate
+//loops, so that only the sum has to go one value at a time.
+static void _evpkunpack(const evpkbk_t* bk, const uint64_t* words, int64_t* out)
 {
-    va_list args;
-    va_start(args,msg);
-    char* mode_str = NULL;
-    switch(mode){
-        case EV_MSG_ERR:   mode_str = "Error  :"; break;
-        case EV_MSG_DBG:   mode_str = "Debug  :"; break;
-        case EV_MSG_WARN:  mode_str = "Warning:"; break;
+    const uint64_t* in = words + _EV_PK_OFF(bk);
+    uint64_t* res = (uint64_t*)out;
+
+    const int w = _EV_PK_WIDTH(bk);
+    switch(w){
+        _EV_PK_UNPACKS
+        case 0:
+            memset(res, 0x00, sizeof(int64_t) * EV_PK_BLOCK);
+            break;
+        default:
+            for(size_t i = 0; i < EV_PK_BLOCK; i++){
+                res[i] = _evpkres(in, w, i);
+            }
     }
-    dprintf(STDERR_FILENO,"[%s %s:%i:%s()]  ", mode_str, basename(fn), ln, fu);
-    vdprintf(STDERR_FILENO,msg,args);
 
-    if(mode == EV_MSG_ERR && EV_HARD_EXIT){
-        exit(0xDEAD);
+    //Unsigned, so that wrapping around is well defined and exact
+    uint64_t v = bk->first;
+    res[0] = v;
+    for(size_t i = 1; i < EV_PK_BLOCK; i++){
+        v += (uint64_t)bk->min_delta + res[i];
+        res[i] = v;
     }
-    va_end(args);
 }
 
+//Internal function, pack the tail into a new block
+static int _evpkpack(evpk_t* pk)
+{
+    const int64_t* v = pk->tail;
 
-void* evini(size_t slt_size, size_t count)
+    int64_t min_delta = INT64_MAX;
+    for(size_t i = 1; i < EV_PK_BLOCK; i++){
+        const int64_t d = (int64_t)((uint64_t)v[i] - (uint64_t)v[i - 1]);
+        min_delta = d < min_delta ? d : min_delta;
+    }
+
+    uint64_t res[EV_PK_BLOCK] = {0};
+    uint64_t all = 0;
+    for(size_t i = 1; i < EV_PK_BLOCK; i++){
+        res[i] = (uint64_t)v[i] - (uint64_t)v[i - 1] - (uint64_t)min_delta;
+        all |= res[i];
+    }
+
+    int w = 0;
+    while(w < 64 && (all >> w)){
+        w++;
+    }
+
+    const size_t off    = evcnt(pk->words);
+    const size_t nwords = 2 * w; //EV_PK_BLOCK x w bits
+    uint64_t* words = (uint64_t*)evrsv(pk->words, off + nwords + 1);
+    if(!words){
+        return -1;
+    }
+    pk->words = words;
+
+    uint64_t* out = words + off;
+    memset(out, 0x00, (nwords + 1) * sizeof(uint64_t)); //And the spare word
+    for(size_t i = 1; w && i < EV_PK_BLOCK; i++){
+        const size_t bit    = i * w;
+        const size_t word   = bit / 64;
+        const int shift     = bit % 64;
+        out[word] |= res[i] << shift;
+        if(shift + w > 64){
+            out[word + 1] |= res[i] >> (64 - shift);
+        }
+    }
+    EV_HDR(words)->obj_count += nwords;
+
+    evpkbk_t bk = { v[0], min_delta, (uint64_t)off << 8 | w };
+    evpkbk_t* blks = (evpkbk_t*)evpush(pk->blks, &bk, sizeof(bk));
+    if(!blks){
+        return -1;
+    }
+    pk->blks = blks;
+
+    return 0;
+}
+
+evpk_t* evpkini(void)
 {
-    size_t store_bytes  = count * slt_size;
-    size_t full_bytes = EV_HDR_BYTES + store_bytes;
+    evpk_t* pk = (evpk_t*)calloc(1, sizeof(evpk_t));
+    ifp(!pk,
+        EV_FAIL("No memory to init packed integer vector with %zuB\n", sizeof(evpk_t));
+        return NULL;
+    );
+
+    pk->blks  = (evpkbk_t*)evini(sizeof(evpkbk_t), 0);
+    pk->words = (uint64_t*)evini(sizeof(uint64_t), 1); //The spare word
+    if(!pk->blks || !pk->words){
+        evfree(pk->blks);
+        evfree(pk->words);
+        free(pk);
+        return NULL;
+    }
+
+    memcpy(pk->magic1,EV_PK_MAGIC1,sizeof(pk->magic1));
+    memcpy(pk->magic2,EV_PK_MAGIC2,sizeof(pk->magic2));
+
+    return pk;
+}
+
+int evpkpush(evpk_t* pk, int64_t value)
+{
+    ifp(!pk,
+        EV_FAIL("Cannot push into a NULL packed integer vector\n");
+        return -1;
+    );
+
+    ifp(_evpkhdrcheck(pk),
+        EV_FAIL("Header sanity check failed\n");
+        return -1;
+    );
+
+    pk->tail[pk->obj_count % EV_PK_BLOCK] = value;
+    if(pk->obj_count % EV_PK_BLOCK == EV_PK_BLOCK - 1 && _evpkpack(pk)){
+        EV_FAIL("No memory to pack block %" PRId64 "\n", pk->obj_count / EV_PK_BLOCK);
+        return -1;
+    }
+    pk->obj_count++;
+
+    return 0;
+}
+
+size_t evpkcnt(evpk_t* pk)
+{
+    if(!pk){
+        return 0;
+    }
+
+    ifp(_evpkhdrcheck(pk),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
+    );
+
+    return pk->obj_count;
+}
+
+int64_t evpkget(evpk_t* pk, size_t idx)
+{
+    ifp(!pk,
+        EV_FAIL("Cannot index a NULL packed integer vector\n");
+        return 0;
+    );
 
-    evhd_t *hdr = (evhd_t*)malloc(full_bytes);
-    ifp(!hdr,
-        EV_FAIL("No memory to init vector with %" PRId64 "B\n", full_bytes);
-                return NULL;
+    ifp(_evpkhdrcheck(pk),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
     );
 
+    ifp(idx >= (size_t)pk->obj_count,
+        EV_FAIL("Index cannot be greater than number of objects (idx=%zu >= %" PRId64 ")\n",
+                idx,
+                pk->obj_count);
+        return 0;
+    );
 
-    memset(hdr,0x00,full_bytes);
+    const size_t blk = idx / EV_PK_BLOCK;
+    const size_t i   = idx % EV_PK_BLOCK;
+    if(blk == evcnt(pk->blks)){
+        return pk->tail[i];
+    }
 
-    memcpy(hdr->magic1,EV_MAGIC1,sizeof(hdr->magic1));
-    hdr->slt_size   = slt_size;
-    hdr->slt_count  = count;
-    hdr->obj_count  = 0;
-    memcpy(hdr->magic2,EV_MAGIC2,sizeof(hdr->magic2));
+    const evpkbk_t* bk  = &pk->blks[blk];
+    const uint64_t* in  = pk->words + _EV_PK_OFF(bk);
+    const int w         = _EV_PK_WIDTH(bk);
+    uint64_t v = (uint64_t)bk->first + i * (uint64_t)bk->min_delta;
+    for(size_t j = 1; w && j <= i; j++){
+        v += _evpkres(in, w, j);
+    }
 
-    void *vec_start = (char*)hdr + EV_HDR_BYTES;
-    return vec_start;
+    return (int64_t)v;
 }
 
-//Check that the EV header is sane
-int _evhdrcheck(evhd_t* hdr)
+size_t evpkdecode(evpk_t* pk, size_t start, int64_t* out, size_t count)
 {
-    if(strncmp(hdr->magic1, EV_MAGIC1, sizeof(EV_MAGIC1)) != 0){
-        EV_FAIL("Header magic 1 should be '%s' but found '%.*s'\n", EV_MAGIC1, sizeof(EV_MAGIC1), hdr->magic1);
-        return -1;
-    };
-    if(strncmp(hdr->magic2, EV_MAGIC2, sizeof(EV_MAGIC2)) != 0){
-        EV_FAIL("Header magic 2 should be '%s' but found '%.*s'\n", EV_MAGIC2, sizeof(EV_MAGIC2), hdr->magic2);
-        return -1;
-    };
+    ifp(!pk || !out,
+        EV_FAIL("Cannot decode a NULL packed integer vector or into a NULL array\n");
+        return 0;
+    );
 
-    if(hdr->obj_count < 0){
-        EV_FAIL("Object count cannot be less than zero!\n");
-        return -1;
-    }
+    ifp(_evpkhdrcheck(pk),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
+    );
 
-    if(hdr->index < 0){
-        EV_FAIL("Index value cannot be less than zero!\n");
-        return -1;
+    if(start >= (size_t)pk->obj_count){
+        return 0;
     }
-
-    if(hdr->slt_count < 0){
-        EV_FAIL("Slot count cannot be less than zero\n");
-        return -1;
+    if(count > pk->obj_count - start){
+        count = pk->obj_count - start;
     }
 
-    if(hdr->obj_count > hdr->slt_count){
-        EV_FAIL("More items in vector (%" PRId64 ") than there is space (%" PRId64 ")\n",
-                hdr->obj_count,
-                hdr->slt_count);
-        return -1;
+    const size_t blks = evcnt(pk->blks);
+    int64_t tmp[EV_PK_BLOCK];
+    size_t done = 0;
+    while(done < count){
+        const size_t idx    = start + done;
+        const size_t blk    = idx / EV_PK_BLOCK;
+        const size_t i      = idx % EV_PK_BLOCK;
+        size_t n            = EV_PK_BLOCK - i;
+        n = n < count - done ? n : count - done;
+
+        if(blk == blks){
+            memcpy(out + done, pk->tail + i, n * sizeof(int64_t));
+        }
+        else if(n == EV_PK_BLOCK){
+            //Whole blocks go straight into the caller's array
+            _evpkunpack(&pk->blks[blk], pk->words, out + done);
+        }
+        else{
+            _evpkunpack(&pk->blks[blk], pk->words, tmp);
+            memcpy(out + done, tmp + i, n * sizeof(int64_t));
+        }
+        done += n;
     }
 
-    if(hdr->slt_size < 0){
-        EV_FAIL("Slot size cannot be less than zero\n");
-        return -1;
+    return done;
+}
+
+size_t evpkmem(evpk_t* pk)
+{
+    if(!pk){
+        return 0;
     }
 
-    return 0;
+    ifp(_evpkhdrcheck(pk),
+        EV_FAIL("Header sanity check failed\n");
+        return 0;
+    );
+
+    const evhd_t* blks  = EV_HDR(pk->blks);
+    const evhd_t* words = EV_HDR(pk->words);
+    return sizeof(evpk_t) +
+           EV_HDR_BYTES + blks->slt_size * blks->slt_count +
+           EV_HDR_BYTES + words->slt_size * words->slt_count;
 }
 
-//Internal function, grow the vector backing store memory
-void* _evgrow(void* vec)
+evpk_t* evpkfree(evpk_t* pk)
 {
-    ifp(!vec,
-        EV_FAIL("Cannot grow an empty vector!\n");
-    );
+    if(!pk){
+        return NULL;
+    }
 
-    evhd_t* hdr = EV_HDR(vec);
-    ifp(_evhdrcheck(hdr),
+    ifp(_evpkhdrcheck(pk),
         EV_FAIL("Header sanity check failed\n");
-                return NULL;
+        return NULL;
     );
 
+    evfree(pk->blks);
+    evfree(pk->words);
+    free(pk);
 
-    const size_t storage_bytes      = hdr->slt_size * hdr->slt_count;
-    const size_t new_storage_bytes  = hdr->slt_count ? storage_bytes * EV_GROWTH_FACTOR :
-                                      EV_INIT_COUNT * hdr->slt_size;
-    const size_t full_bytes         = EV_HDR_BYTES + new_storage_bytes;
+    return NULL;
+}
+#endif
 
-    hdr = realloc(hdr, full_bytes);
-    if (!hdr){
-        EV_FAIL("No memory to grow vector up to %" PRId64 "B\n", full_bytes);
-        return NULL;
-    }
 
-    memset((char*)hdr + EV_HDR_BYTES + storage_bytes, 0x00, new_storage_bytes - storage_bytes);
+#if defined EV_FHEAP || defined EV_FALL
+//Internal function, the number of children per item
+static inline size_t _evheapd(const evhd_t* hdr)
+{
+    return hdr->flags & EV_FLAG_HEAP4 ? 4 : 2;
+}
+
+//Internal function, check a heap and find its items
+static char* _evheapdata(void* vec, evhd_t* hdr)
+{
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
 
-    hdr->slt_count  = hdr->slt_count ? hdr->slt_count * EV_GROWTH_FACTOR : EV_INIT_COUNT;
+    return vec;
+}
 
-    void *vec_start = (char*)hdr + EV_HDR_BYTES;
+//Internal function, swap two slots a chunk at a time
+static inline void _evheapswap(char* a, char* b, size_t size)
+{
+    char tmp[64];
+    while(size){
+        const size_t n = size < sizeof(tmp) ? size : sizeof(tmp);
+        memcpy(tmp, a, n);
+        memcpy(a, b, n);
+        memcpy(b, tmp, n);
+        a += n;
+        b += n;
+        size -= n;
+    }
+}
 
-    return vec_start;
+//Internal function, move item i down until it is no bigger than its children.
+//Returns where it ends up.
+static size_t _evheapdown(char* data, size_t n, size_t slt, size_t d, size_t i,
+                          int (*compar)(const void* a, const void* b))
+{
+    for(;;){
+        const size_t first = d * i + 1;
+        if(first >= n){
+            return i;
+        }
+
+        const size_t last = first + d < n ? first + d : n;
+        size_t best = first;
+        for(size_t c = first + 1; c < last; c++){
+            if(compar(data + c * slt, data + best * slt) < 0){
+                best = c;
+            }
+        }
+
+        if(compar(data + best * slt, data + i * slt) >= 0){
+            return i;
+        }
+        _evheapswap(data + i * slt, data + best * slt, slt);
+        i = best;
+    }
 }
 
 
-void* evpush(void* vec, void* obj, size_t obj_size)
+void* evheap_push(void* vec, void* obj, size_t obj_size, int (*compar)(const void* a, const void* b))
 {
     void* result = vec;
     if(!vec){
@@ -569,331 +7456,1481 @@ void* evpush(void* vec, void* obj, size_t obj_size)
     evhd_t* hdr = EV_HDR(result);
     ifp(_evhdrcheck(hdr),
         EV_FAIL("Header sanity check failed\n");
-                return NULL;
+        return NULL;
     );
 
     //Sanity check
     ifp(obj_size > hdr->slt_size,
         EV_FAIL("Object size (%" PRId64 ") is larger than there is space (%" PRId64 ")\n",
                 obj_size,
-                hdr->slt_size);
+                (int64_t)hdr->slt_size);
                 return NULL;
     );
 
     //Enough space?
     if(hdr->obj_count == hdr->slt_count){
-        //Get some more
         result = _evgrow(result);
+        if(!result){
+            return NULL;
+        }
         hdr = EV_HDR(result);
     }
 
-    void* next_obj = ((char*)result) + hdr->slt_size * hdr->obj_count;
-    memcpy(next_obj,obj,obj_size);
+    char* data = _evheapdata(result, hdr);
+    if(!data){
+        return NULL;
+    }
+    const size_t slt = hdr->slt_size;
+    const size_t d   = _evheapd(hdr);
+
+    //Add it at the bottom, then move it up past any bigger parents
+    size_t i = hdr->obj_count;
+    memcpy(data + i * slt, obj, obj_size);
+    memset(data + i * slt + obj_size, 0, slt - obj_size);
+    while(i > 0){
+        const size_t parent = (i - 1) / d;
+        if(compar(data + i * slt, data + parent * slt) >= 0){
+            break;
+        }
+        _evheapswap(data + i * slt, data + parent * slt, slt);
+        i = parent;
+    }
     hdr->obj_count++;
 
+    EV_STAT_ADD(hdr, pushes, 1);
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count);
+    _evincpath(hdr, result, hdr->obj_count - 1, i, d);
+    _evincpush(hdr, result, hdr->obj_count - 1);
+
     return result;
 }
 
 
-size_t evcnt(void* vec)
+void* evheap_top(void* vec)
 {
-    if(!vec){
-        return 0;
-    };
+    ifp(!vec,
+        EV_FAIL("Cannot get the top of a NULL heap\n");
+        return NULL;
+    );
 
-    evhd_t *hdr =  EV_HDR(vec);
-    ifp(_evhdrcheck(hdr),
-        EV_FAIL("Header sanity check failed\n");
-                return -1;
+    evhd_t* hdr = EV_HDR(vec);
+    char* data = _evheapdata(vec, hdr);
+    if(!data || !hdr->obj_count){
+        return NULL;
+    }
+    return data;
+}
+
+
+void evheap_pop(void* vec, void* obj, int (*compar)(const void* a, const void* b))
+{
+    ifp(!vec,
+        EV_FAIL("Cannot pop from a NULL heap\n");
+        return;
     );
 
-    return hdr->obj_count;
+    evhd_t* hdr = EV_HDR(vec);
+    char* data = _evheapdata(vec, hdr);
+    if(!data){
+        return;
+    }
+    ifp(!hdr->obj_count,
+        EV_FAIL("Cannot pop from an empty heap\n");
+        return;
+    );
+
+    const size_t slt = hdr->slt_size;
+    if(obj){
+        memcpy(obj, data, slt);
+    }
+
+    //Move the last item to the top, then back down past any smaller children
+    const size_t n = --hdr->obj_count;
+    if(n){
+        memcpy(data, data + n * slt, slt);
+        const size_t d = _evheapd(hdr);
+        _evincpath(hdr, vec, _evheapdown(data, n, slt, d, 0, compar), 0, d);
+    }
 }
 
 
-void* evidx(void* vec, size_t idx)
+void evheapify(void* vec, int (*compar)(const void* a, const void* b))
 {
     ifp(!vec,
-        EV_FAIL("Cannot get index of a NULL vector\n");
-                return NULL;
+        EV_FAIL("Cannot heapify a NULL vector\n");
+        return;
     );
 
-    evhd_t *hdr =  EV_HDR(vec);
+    evhd_t* hdr = EV_HDR(vec);
+    char* data = _evheapdata(vec, hdr);
+    const size_t n = hdr->obj_count;
+    const size_t d = _evheapd(hdr);
+    if(!data || n < 2){
+        return;
+    }
+
+    //Every item past the last parent is already a heap of one
+    for(size_t i = (n - 2) / d + 1; i-- > 0; ){
+        _evheapdown(data, n, hdr->slt_size, d, i, compar);
+    }
+    _evincsync(hdr, vec, 0, n);
+}
+
+
+void evheap_arity(void* vec, int arity)
+{
+    ifp(!vec,
+        EV_FAIL("Cannot set the arity of a NULL vector\n");
+        return;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
     ifp(_evhdrcheck(hdr),
         EV_FAIL("Header sanity check failed\n");
-                return NULL;
+        return;
     );
 
-    ifp(hdr->obj_count == 0,
-        EV_FAIL("Cannot get index of empty vector\n");
-                return NULL;
+    ifp(arity != 2 && arity != 4,
+        EV_FAIL("Heap arity (%i) must be 2 or 4\n", arity);
+        return;
     );
 
-    ifp(idx < 0,
-        EV_FAIL("Index cannot be <0 (idx=%" PRId64 ")\n", idx);
+    if(arity == 4){
+        hdr->flags |= EV_FLAG_HEAP4;
+    }
+    else{
+        hdr->flags &= ~EV_FLAG_HEAP4;
+    }
+}
+
+//Internal macro, the typed heaps. The item being moved is held in a local,
+//and the others are shifted over the hole it leaves, which is half the copies
+//of swapping. Sift down is written for a constant d, so that the loop over the
+//children unrolls.
+#define _EV_HEAP_IMPL(S, T, A) \
+static inline T* _evheapdata_##S(T* vec) \
+{ \
+    evhd_t* hdr = EV_HDR(vec); \
+    ifp(hdr->slt_size != sizeof(T), \
+        EV_FAIL("Slot size (%" PRId64 ") does not match the heap type size (%zu)\n", \
+                (int64_t)hdr->slt_size, sizeof(T)); \
+        return NULL; \
+    ); \
+    return (T*)_evheapdata(vec, hdr); \
+} \
+\
+static inline size_t _evheapdown_##S(T* a, size_t n, size_t d, size_t i) \
+{ \
+    const T val = a[i]; \
+    for(;;){ \
+        const size_t first = d * i + 1; \
+        if(first >= n){ \
+            break; \
+        } \
+        size_t best = first; \
+        if(first + d <= n){ \
+            for(size_t c = first + 1; c < first + d; c++){ \
+                best = a[c] < a[best] ? c : best; \
+            } \
+        } \
+        else{ \
+            for(size_t c = first + 1; c < n; c++){ \
+                best = a[c] < a[best] ? c : best; \
+            } \
+        } \
+        if(!(a[best] < val)){ \
+            break; \
+        } \
+        a[i] = a[best]; \
+        i = best; \
+    } \
+    a[i] = val; \
+    return i; \
+} \
+\
+static size_t _evheapdownd_##S(T* a, size_t n, size_t d, size_t i) \
+{ \
+    if(d == 4){ \
+        return _evheapdown_##S(a, n, 4, i); \
+    } \
+    return _evheapdown_##S(a, n, 2, i); \
+} \
+\
+T* evheap_push_##S(T* vec, T value) \
+{ \
+    if(!vec){ \
+        vec = evinisz(sizeof(T)); \
+    } \
+\
+    evhd_t* hdr = EV_HDR(vec); \
+    ifp(_evhdrcheck(hdr), \
+        EV_FAIL("Header sanity check failed\n"); \
+        return NULL; \
+    ); \
+\
+    if(hdr->obj_count == hdr->slt_count){ \
+        vec = _evgrow(vec); \
+        if(!vec){ \
+            return NULL; \
+        } \
+        hdr = EV_HDR(vec); \
+    } \
+\
+    T* a = _evheapdata_##S(vec); \
+    if(!a){ \
+        return NULL; \
+    } \
+    const size_t d = _evheapd(hdr); \
+    size_t i = hdr->obj_count; \
+    while(i > 0){ \
+        const size_t parent = (i - 1) / d; \
+        if(!(value < a[parent])){ \
+            break; \
+        } \
+        a[i] = a[parent]; \
+        i = parent; \
+    } \
+    a[i] = value; \
+    hdr->obj_count++; \
+\
+    EV_STAT_ADD(hdr, pushes, 1); \
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count); \
+    _evincpath(hdr, vec, hdr->obj_count - 1, i, d); \
+    _evincpush(hdr, vec, hdr->obj_count - 1); \
+\
+    return vec; \
+} \
+\
+T evheap_pop_##S(T* vec) \
+{ \
+    ifp(!vec, \
+        EV_FAIL("Cannot pop from a NULL heap\n"); \
+        return 0; \
+    ); \
+\
+    T* a = _evheapdata_##S(vec); \
+    evhd_t* hdr = EV_HDR(vec); \
+    if(!a){ \
+        return 0; \
+    } \
+    ifp(!hdr->obj_count, \
+        EV_FAIL("Cannot pop from an empty heap\n"); \
+        return 0; \
+    ); \
+\
+    const T top = a[0]; \
+    const size_t n = --hdr->obj_count; \
+    if(n){ \
+        a[0] = a[n]; \
+        const size_t d = _evheapd(hdr); \
+        _evincpath(hdr, vec, _evheapdownd_##S(a, n, d, 0), 0, d); \
+    } \
+    return top; \
+} \
+\
+void evheapify_##S(T* vec) \
+{ \
+    ifp(!vec, \
+        EV_FAIL("Cannot heapify a NULL vector\n"); \
+        return; \
+    ); \
+\
+    T* a = _evheapdata_##S(vec); \
+    evhd_t* hdr = EV_HDR(vec); \
+    const size_t n = hdr->obj_count; \
+    const size_t d = _evheapd(hdr); \
+    if(!a || n < 2){ \
+        return; \
+    } \
+    for(size_t i = (n - 2) / d + 1; i-- > 0; ){ \
+        _evheapdownd_##S(a, n, d, i); \
+    } \
+    _evincsync(hdr, vec, 0, n); \
+}
+_EV_NUM_TYPES(_EV_HEAP_IMPL)
+#endif
+
+
+#if defined EV_FSET || defined EV_FALL
+#if defined __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define _EV_SET_MERGE 0
+#define _EV_SET_UNION 1
+#define _EV_SET_INTER 2
+#define _EV_SET_DIFF  3
+
+//Internal struct, the inputs to a set operation and where its results go
+typedef struct {
+    char* a;
+    char* b;
+    size_t na;
+    size_t nb;
+    char* out;
+} _evset_t;
+
+//Internal function, check one input of a set operation and find its items
+static char* _evsetdata(void* vec, size_t* count, size_t* slt_size)
+{
+    *count = 0;
+    if(!vec){
+        return NULL;
+    }
+
+    evhd_t* hdr = EV_HDR(vec);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
     );
 
-    ifp(idx > hdr->obj_count - 1,
-        EV_FAIL("Index cannot be greater than number of objects (idx=%" PRId64 " > %" PRId64 ")\n" ,
-                idx,
-                hdr->obj_count -1);
+    *count    = hdr->obj_count;
+    *slt_size = hdr->slt_size;
+    return vec;
+}
+
+//Internal function, check the inputs of a set operation, and grow dst once to
+//fit the most results that it can give. type_size is 0 if any slot size will
+//do. Returns dst, which may have moved, or NULL. set->out is NULL if there is
+//nothing to do.
+static void* _evsetprep(void* dst, void* a, void* b, int op, size_t type_size, _evset_t* set)
+{
+    set->out = NULL;
+    ifp(dst && (dst == a || dst == b),
+        EV_FAIL("Cannot put the results of a set operation into one of its inputs\n");
+        return NULL;
+    );
+
+    size_t slt_a = 0, slt_b = 0;
+    set->a = _evsetdata(a, &set->na, &slt_a);
+    set->b = _evsetdata(b, &set->nb, &slt_b);
+    ifp(slt_a && slt_b && slt_a != slt_b,
+        EV_FAIL("Slot sizes of the inputs (%zu and %zu) do not match\n", slt_a, slt_b);
+        return NULL;
+    );
+
+    const size_t slt_size = slt_a ? slt_a : slt_b;
+    if(!slt_size){
+        return dst;
+    }
+
+    ifp(type_size && slt_size != type_size,
+        EV_FAIL("Slot size (%zu) does not match the set type size (%zu)\n", slt_size, type_size);
+        return NULL;
+    );
+
+    const size_t shorter = set->na < set->nb ? set->na : set->nb;
+    const size_t most = op == _EV_SET_INTER ? shorter :
+                        op == _EV_SET_DIFF  ? set->na :
+                        set->na + set->nb;
+
+    if(!dst){
+        dst = evini(slt_size, most);
+        if(!dst){
+            return NULL;
+        }
+    }
+
+    evhd_t* hdr = EV_HDR(dst);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
+
+    ifp(hdr->slt_size != slt_size,
+        EV_FAIL("Slot size of the destination (%" PRId64 ") does not match the inputs (%zu)\n",
+                (int64_t)hdr->slt_size, slt_size);
+        return NULL;
+    );
+
+    //Grow once, to fit everything
+    if(hdr->obj_count + most > hdr->slt_count){
+        dst = _evgrowto(dst, hdr->obj_count + most);
+        if(!dst){
+            return NULL;
+        }
+        hdr = EV_HDR(dst);
+    }
+
+    set->out = (char*)dst + hdr->slt_size * hdr->obj_count;
+    return dst;
+}
+
+//Internal function, count the results of a set operation into dst
+static void* _evsetdone(void* dst, size_t count)
+{
+    evhd_t* hdr = EV_HDR(dst);
+    hdr->obj_count += count;
+
+    EV_STAT_ADD(hdr, pushes, count);
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count);
+    _evincpush(hdr, dst, hdr->obj_count - count);
+
+    return dst;
+}
+
+//Internal function, find the first item at or after from that is not less
+//than key, or with upper set, the first that is greater than key. Gallop out
+//in steps of 1, 2, 4.. then binary search the last step.
+static size_t _evsetfind(const char* data, size_t from, size_t n, size_t slt, const void* key,
+                         int upper, int (*compar)(const void* a, const void* b))
+{
+    size_t lo = from, hi = from, step = 1;
+    while(hi < n && compar(data + hi * slt, key) < upper){
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    hi = hi < n ? hi : n;
+
+    while(lo < hi){
+        const size_t mid = lo + (hi - lo) / 2;
+        if(compar(data + mid * slt, key) < upper){
+            lo = mid + 1;
+        }
+        else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+//Internal macro, copy count items from src to the output
+#define _EV_SET_EMIT(src, count) \
+    do { \
+        memcpy(o, (src), (count) * slt); \
+        o += (count) * slt; \
+    } while(0)
+
+//Internal function, run a set operation. Returns the number of results.
+static size_t _evsetrun(int op, char* out, const char* a, size_t na, const char* b, size_t nb,
+                        size_t slt, int (*compar)(const void* a, const void* b))
+{
+    const int keep_a = op != _EV_SET_INTER; //Keep items that are only in a
+    const int keep_b = op <= _EV_SET_UNION; //Keep items that are only in b
+    char* o = out;
+    size_t i = 0, j = 0;
+
+    if(nb / EV_SET_GALLOP >= na){
+        //Find each item of a in b, and copy the runs of b in between
+        for(; i < na; i++){
+            const char* x = a + i * slt;
+            const size_t k = _evsetfind(b, j, nb, slt, x, 0, compar);
+            if(keep_b){
+                _EV_SET_EMIT(b + j * slt, k - j);
+            }
+            j = k;
+
+            //A merge keeps equal items of b for after the equal items of a
+            if(op != _EV_SET_MERGE && j < nb && compar(x, b + j * slt) == 0){
+                if(op != _EV_SET_DIFF){
+                    _EV_SET_EMIT(x, 1);
+                }
+                j++;
+            }
+            else if(keep_a){
+                _EV_SET_EMIT(x, 1);
+            }
+        }
+    }
+    else if(na / EV_SET_GALLOP >= nb){
+        //Find each item of b in a, and copy the runs of a in between
+        for(; j < nb; j++){
+            const char* y = b + j * slt;
+            //A merge copies the items of a equal to y as well, so y goes after them
+            const size_t k = _evsetfind(a, i, na, slt, y, op == _EV_SET_MERGE, compar);
+            if(keep_a){
+                _EV_SET_EMIT(a + i * slt, k - i);
+            }
+            i = k;
+
+            if(op != _EV_SET_MERGE && i < na && compar(a + i * slt, y) == 0){
+                if(op != _EV_SET_DIFF){
+                    _EV_SET_EMIT(a + i * slt, 1);
+                }
+                i++;
+            }
+            else if(keep_b){
+                _EV_SET_EMIT(y, 1);
+            }
+        }
+    }
+    else{
+        while(i < na && j < nb){
+            const int c = compar(a + i * slt, b + j * slt);
+            //Equal items of a go first in a merge, so that it is stable
+            if(c < 0 || (c == 0 && op == _EV_SET_MERGE)){
+                if(keep_a){
+                    _EV_SET_EMIT(a + i * slt, 1);
+                }
+                i++;
+            }
+            else if(c > 0){
+                if(keep_b){
+                    _EV_SET_EMIT(b + j * slt, 1);
+                }
+                j++;
+            }
+            else{
+                if(op != _EV_SET_DIFF){
+                    _EV_SET_EMIT(a + i * slt, 1);
+                }
+                i++;
+                j++;
+            }
+        }
+    }
+
+    if(keep_a){
+        _EV_SET_EMIT(a + i * slt, na - i);
+    }
+    if(keep_b){
+        _EV_SET_EMIT(b + j * slt, nb - j);
+    }
+    return (o - out) / slt;
+}
+
+//Internal function, the generic set operations
+static void* _evsetop(void* dst, void* a, void* b, int op, int (*compar)(const void* a, const void* b))
+{
+    ifp(!compar,
+        EV_FAIL("Cannot combine sets with a NULL comparison function\n");
+        return NULL;
     );
 
+    _evset_t set;
+    dst = _evsetprep(dst, a, b, op, 0, &set);
+    if(!set.out){
+        return dst;
+    }
+
+    const size_t slt = EV_HDR(dst)->slt_size;
+    return _evsetdone(dst, _evsetrun(op, set.out, set.a, set.na, set.b, set.nb, slt, compar));
+}
+
+void* evmerge(void* dst, void* a, void* b, int (*compar)(const void* a, const void* b))
+{
+    return _evsetop(dst, a, b, _EV_SET_MERGE, compar);
+}
+
+void* evunion(void* dst, void* a, void* b, int (*compar)(const void* a, const void* b))
+{
+    return _evsetop(dst, a, b, _EV_SET_UNION, compar);
+}
+
+void* evinter(void* dst, void* a, void* b, int (*compar)(const void* a, const void* b))
+{
+    return _evsetop(dst, a, b, _EV_SET_INTER, compar);
+}
+
+void* evdiff(void* dst, void* a, void* b, int (*compar)(const void* a, const void* b))
+{
+    return _evsetop(dst, a, b, _EV_SET_DIFF, compar);
+}
+
+//Internal function, intersect blocks of 4 items, while there are 4 left in
+//both inputs. Each item of a is compared against all of the items of b at
+//once, by rotating b 3 times. The inputs have no duplicates, so at least one
+//block is used up each step. Returns the number of results.
+static size_t _evinter4_i32(const int32_t* a, size_t na, const int32_t* b, size_t nb,
+                            int32_t* out, size_t* ia, size_t* ib)
+{
+    size_t i = 0, j = 0, o = 0;
+#if defined __SSE2__
+    while(i + 4 <= na && j + 4 <= nb){
+        const __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        const __m128i vb = _mm_loadu_si128((const __m128i*)(b + j));
+        const __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                         _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+
+        for(int mask = _mm_movemask_ps(_mm_castsi128_ps(eq)); mask; mask &= mask - 1){
+            out[o++] = a[i + __builtin_ctz(mask)];
+        }
+
+        const int32_t a_last = a[i + 3];
+        const int32_t b_last = b[j + 3];
+        i += a_last <= b_last ? 4 : 0;
+        j += b_last <= a_last ? 4 : 0;
+    }
+#else
+    (void)a; (void)na; (void)b; (void)nb; (void)out;
+#endif
+    *ia = i;
+    *ib = j;
+    return o;
+}
+
+//No block intersection for the other types, they use the scalar loop
+#define _evinter4_i64(a, na, b, nb, out, ia, ib) 0
+#define _evinter4_f32(a, na, b, nb, out, ia, ib) 0
+#define _evinter4_f64(a, na, b, nb, out, ia, ib) 0
+
+//Internal macro, the typed set operations. These are the same as
+//_evsetrun(), with the comparisons inline.
+#define _EV_SET_IMPL(S, T, A) \
+static size_t _evsetfind_##S(const T* data, size_t from, size_t n, T key, int upper) \
+{ \
+    size_t lo = from, hi = from, step = 1; \
+    while(hi < n && (upper ? !(key < data[hi]) : data[hi] < key)){ \
+        lo = hi + 1; \
+        hi += step; \
+        step *= 2; \
+    } \
+    hi = hi < n ? hi : n; \
+\
+    while(lo < hi){ \
+        const size_t mid = lo + (hi - lo) / 2; \
+        if(upper ? !(key < data[mid]) : data[mid] < key){ \
+            lo = mid + 1; \
+        } \
+        else{ \
+            hi = mid; \
+        } \
+    } \
+    return lo; \
+} \
+\
+static size_t _evsetrun_##S(int op, T* out, const T* a, size_t na, const T* b, size_t nb) \
+{ \
+    const int keep_a = op != _EV_SET_INTER; \
+    const int keep_b = op <= _EV_SET_UNION; \
+    T* o = out; \
+    size_t i = 0, j = 0; \
+\
+    if(nb / EV_SET_GALLOP >= na){ \
+        for(; i < na; i++){ \
+            const size_t k = _evsetfind_##S(b, j, nb, a[i], 0); \
+            if(keep_b){ \
+                memcpy(o, b + j, (k - j) * sizeof(T)); \
+                o += k - j; \
+            } \
+            j = k; \
+            if(op != _EV_SET_MERGE && j < nb && !(a[i] < b[j])){ \
+                if(op != _EV_SET_DIFF){ \
+                    *o++ = a[i]; \
+                } \
+                j++; \
+            } \
+            else if(keep_a){ \
+                *o++ = a[i]; \
+            } \
+        } \
+    } \
+    else if(na / EV_SET_GALLOP >= nb){ \
+        for(; j < nb; j++){ \
+            const size_t k = _evsetfind_##S(a, i, na, b[j], op == _EV_SET_MERGE); \
+            if(keep_a){ \
+                memcpy(o, a + i, (k - i) * sizeof(T)); \
+                o += k - i; \
+            } \
+            i = k; \
+            if(op != _EV_SET_MERGE && i < na && !(b[j] < a[i])){ \
+                if(op != _EV_SET_DIFF){ \
+                    *o++ = a[i]; \
+                } \
+                i++; \
+            } \
+            else if(keep_b){ \
+                *o++ = b[j]; \
+            } \
+        } \
+    } \
+    else{ \
+        if(op == _EV_SET_INTER){ \
+            o += _evinter4_##S(a, na, b, nb, o, &i, &j); \
+        } \
+        while(i < na && j < nb){ \
+            if(a[i] < b[j] || (op == _EV_SET_MERGE && !(b[j] < a[i]))){ \
+                if(keep_a){ \
+                    *o++ = a[i]; \
+                } \
+                i++; \
+            } \
+            else if(b[j] < a[i]){ \
+                if(keep_b){ \
+                    *o++ = b[j]; \
+                } \
+                j++; \
+            } \
+            else{ \
+                if(op != _EV_SET_DIFF){ \
+                    *o++ = a[i]; \
+                } \
+                i++; \
+                j++; \
+            } \
+        } \
+    } \
+\
+    if(keep_a){ \
+        memcpy(o, a + i, (na - i) * sizeof(T)); \
+        o += na - i; \
+    } \
+    if(keep_b){ \
+        memcpy(o, b + j, (nb - j) * sizeof(T)); \
+        o += nb - j; \
+    } \
+    return o - out; \
+} \
+\
+static T* _evsetop_##S(T* dst, T* a, T* b, int op) \
+{ \
+    _evset_t set; \
+    dst = _evsetprep(dst, a, b, op, sizeof(T), &set); \
+    if(!set.out){ \
+        return dst; \
+    } \
+    return _evsetdone(dst, _evsetrun_##S(op, (T*)set.out, (T*)set.a, set.na, (T*)set.b, set.nb)); \
+} \
+\
+T* evmerge_##S(T* dst, T* a, T* b) { return _evsetop_##S(dst, a, b, _EV_SET_MERGE); } \
+T* evunion_##S(T* dst, T* a, T* b) { return _evsetop_##S(dst, a, b, _EV_SET_UNION); } \
+T* evinter_##S(T* dst, T* a, T* b) { return _evsetop_##S(dst, a, b, _EV_SET_INTER); } \
+T* evdiff_##S(T* dst, T* a, T* b) { return _evsetop_##S(dst, a, b, _EV_SET_DIFF); }
+_EV_NUM_TYPES(_EV_SET_IMPL)
+#endif
 
-    return (char*)vec + hdr->slt_size * idx;
-}
 
+#if defined EV_FGATHER || defined EV_FALL
+#if defined __GNUC__
+#define _evprefetch(addr, rw) __builtin_prefetch((addr), (rw))
+#else
+#define _evprefetch(addr, rw) ((void)(addr))
+#endif
 
-void* evtail(void* vec)
+//Internal function, the largest index in a list. This is one pass with no
+//branches, so it vectorizes, and is much cheaper than checking each index.
+static inline size_t _evidxmax(const size_t* idx, size_t n)
 {
-    return evidx(vec,evcnt(vec) -1);
+    size_t max = 0;
+    for(size_t k = 0; k < n; k++){
+        max = idx[k] > max ? idx[k] : max;
+    }
+    return max;
 }
 
-void* evhead(void* vec)
+//Internal macro, copy n items between the indexed side (far) and the side
+//that is read or written in order (near). scatter is a constant, so the
+//direction of the copy is known at compile time. So is the slot size in each
+//case of the switch below, so that the memcpy() turns into a load and a store.
+#define _EV_GATHER_LOOP(far, near, size, scatter) \
+    do { \
+        const size_t ahead = n > EV_GATHER_AHEAD ? n - EV_GATHER_AHEAD : 0; \
+        for(size_t k = 0; k < n; k++){ \
+            if(k < ahead){ \
+                _evprefetch(far + idx[k + EV_GATHER_AHEAD] * (size), scatter); \
+            } \
+            if(scatter){ \
+                memcpy(far + idx[k] * (size), near + k * (size), (size)); \
+            } \
+            else{ \
+                memcpy(near + k * (size), far + idx[k] * (size), (size)); \
+            } \
+        } \
+    } while(0)
+
+//Internal macro, run _EV_GATHER_LOOP() with a constant slot size if it can
+#define _EV_GATHER_SWITCH(far, near, slt, scatter) \
+    switch(slt){ \
+    case 1:  _EV_GATHER_LOOP(far, near, 1, scatter);   break; \
+    case 2:  _EV_GATHER_LOOP(far, near, 2, scatter);   break; \
+    case 4:  _EV_GATHER_LOOP(far, near, 4, scatter);   break; \
+    case 8:  _EV_GATHER_LOOP(far, near, 8, scatter);   break; \
+    case 16: _EV_GATHER_LOOP(far, near, 16, scatter);  break; \
+    default: _EV_GATHER_LOOP(far, near, slt, scatter); break; \
+    }
+
+void* evgather(void* dst, void* src, const size_t* idx, size_t n)
 {
-    ifp(!vec,
-    return NULL;
+    ifp(!src,
+        EV_FAIL("Cannot gather from a NULL vector\n");
+        return NULL;
     );
 
-    evhd_t *hdr =  EV_HDR(vec);
-    ifp(_evhdrcheck(hdr),
-        EV_FAIL("Header sanity check failed\n");
+    ifp(n && !idx,
+        EV_FAIL("Cannot gather with a NULL index list\n");
         return NULL;
     );
 
-    ifp(hdr->obj_count == 0,
+    ifp(dst && dst == src,
+        EV_FAIL("Cannot gather a vector into itself\n");
         return NULL;
     );
 
-    hdr->index = 0;
-
-    return evidx(vec,hdr->index);
-}
+    evhd_t* src_hdr = EV_HDR(src);
+    ifp(_evhdrcheck(src_hdr),
+        EV_FAIL("Header sanity check failed\n");
+        return NULL;
+    );
 
-void* evnext(void* vec)
-{
-    ifp(!vec,
-        EV_FAIL("Cannot get next item in a NULL vector\n");
-                return NULL;
+    ifp(n && _evidxmax(idx, n) >= (size_t)src_hdr->obj_count,
+        EV_FAIL("Gather index (%zu) is out of range (%" PRId64 " items)\n",
+                _evidxmax(idx, n), (int64_t)src_hdr->obj_count);
+        return NULL;
     );
 
-    evhd_t *hdr =  EV_HDR(vec);
+    const size_t slt = src_hdr->slt_size;
+    char* in = src;
+
+    if(!dst){
+        dst = evini(slt, n);
+        if(!dst){
+            return NULL;
+        }
+    }
+
+    evhd_t* hdr = EV_HDR(dst);
     ifp(_evhdrcheck(hdr),
         EV_FAIL("Header sanity check failed\n");
-                return NULL;
+        return NULL;
     );
 
-    ifp(hdr->obj_count == 0,
-        EV_FAIL("Cannot get next item in an empty vector\n");
-                return NULL;
+    ifp(hdr->slt_size != (int64_t)slt,
+        EV_FAIL("Slot size of the destination (%" PRId64 ") does not match the source (%zu)\n",
+                (int64_t)hdr->slt_size, slt);
+        return NULL;
     );
 
-    hdr->index++;
-    if(hdr->index >= hdr->obj_count){
-        return NULL;
+    //Grow once, to fit everything
+    if(hdr->obj_count + n > hdr->slt_count){
+        dst = _evgrowto(dst, hdr->obj_count + n);
+        if(!dst){
+            return NULL;
+        }
+        hdr = EV_HDR(dst);
     }
 
-    return evidx(vec,hdr->index);
-
-}
-
-void* evfree(void* vec)
-{
-    if(!vec){
-        return NULL;
-    };
+    char* out = (char*)dst + slt * hdr->obj_count;
+    _EV_GATHER_SWITCH(in, out, slt, 0)
+    hdr->obj_count += n;
 
-    if(vec){
-        evhd_t *hdr =  EV_HDR(vec);
-        ifp(_evhdrcheck(hdr),
-            EV_FAIL("Header sanity check failed\n");
-                    return NULL;
-        );
-        free(hdr);
-    }
+    EV_STAT_ADD(hdr, pushes, n);
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count);
+    _evincpush(hdr, dst, hdr->obj_count - n);
 
-    return NULL;
+    return dst;
 }
 
 
-
-#if defined EV_FPOP || defined EV_FALL
-void evpop(void *vec)
+int evscatter(void* dst, const size_t* idx, void* src, size_t n)
 {
-    ifp(!vec,
-        //Uh ohhh....
-        EV_FAIL("Cannot pop a NULL vector\n");
-        return;
+    ifp(!dst || !src,
+        EV_FAIL("Cannot scatter to or from a NULL vector\n");
+        return -1;
     );
 
-    evhd_t* hdr =  EV_HDR(vec);
-    ifp(_evhdrcheck(hdr),
-        EV_FAIL("Header sanity check failed\n");
-        return;
+    ifp(n && !idx,
+        EV_FAIL("Cannot scatter with a NULL index list\n");
+        return -1;
     );
 
-    if(hdr->obj_count)
-        hdr->obj_count--;
-
-}
-#endif
-
-
-#if defined EV_FDEL || defined EV_FALL
-void evdel(void *vec, size_t idx)
-{
-    ifp(!vec,
-        //Uh ohhh....
-        EV_FAIL("Cannot pop an empty vector\n");
-        return;
+    ifp(dst == src,
+        EV_FAIL("Cannot scatter a vector into itself\n");
+        return -1;
     );
 
-    evhd_t* hdr = EV_HDR(vec);
-    ifp(_evhdrcheck(hdr),
+    evhd_t* hdr = EV_HDR(dst);
+    evhd_t* src_hdr = EV_HDR(src);
+    ifp(_evhdrcheck(hdr) || _evhdrcheck(src_hdr),
         EV_FAIL("Header sanity check failed\n");
-        return;
+        return -1;
     );
 
-    if(hdr->obj_count == 0){
-        //Nothing to delete
-        return;
-    }
-
-    //Sanity check
-    ifp(idx < 0,
-        EV_FAIL("Vector index cannot be less than 0\n");
-        return;
-    )
+    ifp(hdr->slt_size != src_hdr->slt_size,
+        EV_FAIL("Slot size of the destination (%" PRId64 ") does not match the source (%" PRId64 ")\n",
+                (int64_t)hdr->slt_size, (int64_t)src_hdr->slt_size);
+        return -1;
+    );
 
-    ifp(idx > hdr->obj_count - 1,
-        EV_FAIL("Vector index (%lu) too large (%" PRId64")\n", idx, hdr->obj_count -1);
-        return;
+    ifp(n > (size_t)src_hdr->obj_count,
+        EV_FAIL("Cannot scatter %zu items from a vector of %" PRId64 "\n", n, (int64_t)src_hdr->obj_count);
+        return -1;
     );
 
-    void* curr_obj = (char*)vec + hdr->slt_size * (idx + 0);
-    void* next_obj = (char*)vec + hdr->slt_size * (idx + 1);
-    const size_t to_move = hdr->slt_size * (hdr->obj_count - idx);
+    ifp(n && _evidxmax(idx, n) >= (size_t)hdr->obj_count,
+        EV_FAIL("Scatter index (%zu) is out of range (%" PRId64 " items)\n",
+                _evidxmax(idx, n), (int64_t)hdr->obj_count);
+        return -1;
+    );
 
-    memcpy(curr_obj,next_obj,to_move);
+    (void)src_hdr;
+    const size_t slt = hdr->slt_size;
+    char* out = dst;
+    char* in = src;
+    _EV_GATHER_SWITCH(out, in, slt, 1)
+#if defined EV_FINCR || defined EV_FALL
+    for(size_t i = 0; i < n; i++){
+        _evincsync(hdr, dst, idx[i], idx[i] + 1);
+    }
+#endif
 
-    hdr->obj_count--;
+    return 0;
 }
 #endif
 
 
-#if defined EV_FMEMSZ  || defined EV_FALL
-
-size_t evvsz(void* vec)
+#if defined EV_FSELECT || defined EV_FALL
+//Internal function, check a vector and find its items
+static char* _evseldata(void* vec, evhd_t* hdr)
 {
-    ifp(!vec,
-        EV_FAIL("Cannot get size of a NULL vector\n");
-        return -1;
-    );
-
-    evhd_t *hdr = EV_HDR(vec);
     ifp(_evhdrcheck(hdr),
         EV_FAIL("Header sanity check failed\n");
-        return -1;
+        return NULL;
     );
 
-    return hdr->slt_count;
+    return vec;
 }
 
-
-size_t evvmem(void* vec)
+//Internal function, swap two slots a chunk at a time
+static inline void _evselswap(char* a, char* b, size_t size)
 {
-    ifp(!vec,
-        EV_FAIL("Cannot get size of a NULL vector\n");
-        return -1;
-    );
+    char tmp[64];
+    while(size){
+        const size_t n = size < sizeof(tmp) ? size : sizeof(tmp);
+        memcpy(tmp, a, n);
+        memcpy(a, b, n);
+        memcpy(b, tmp, n);
+        a += n;
+        b += n;
+        size -= n;
+    }
+}
 
-    evhd_t *hdr = EV_HDR(vec);
-    ifp(_evhdrcheck(hdr),
-        EV_FAIL("Header sanity check failed\n");
-        return -1;
-    );
+//Internal function, how many bad pivots to allow before falling back to a heap
+static inline size_t _evseldepth(size_t n)
+{
+    size_t depth = 0;
+    while(n > 1){
+        n >>= 1;
+        depth += 2;
+    }
+    return depth;
+}
 
-    return hdr->slt_count * hdr->slt_size;
+//Internal function, move item i of a binary heap down until no child sorts
+//after it. The item that sorts last is on top. Returns where it ends up.
+static size_t _evselmaxdown(char* data, size_t n, size_t slt, size_t i,
+                            int (*compar)(const void* a, const void* b))
+{
+    for(;;){
+        size_t best = 2 * i + 1;
+        if(best >= n){
+            return i;
+        }
+        if(best + 1 < n && compar(data + (best + 1) * slt, data + best * slt) > 0){
+            best++;
+        }
+        if(compar(data + best * slt, data + i * slt) <= 0){
+            return i;
+        }
+        _evselswap(data + i * slt, data + best * slt, slt);
+        i = best;
+    }
 }
 
+//Internal function, heap sort n items that are already a heap from
+//_evselmaxdown()
+static void _evselheapsort(char* data, size_t n, size_t slt,
+                           int (*compar)(const void* a, const void* b))
+{
+    while(n > 1){
+        n--;
+        _evselswap(data, data + n * slt, slt);
+        _evselmaxdown(data, n, slt, 0, compar);
+    }
+}
 
-size_t evomem(void* vec)
+//Internal function, select item k of n in O(n log k). Keep the k + 1 items
+//that sort first in a heap, then put its top (the last of them) in place.
+static void _evselheap(char* data, size_t n, size_t slt, size_t k,
+                       int (*compar)(const void* a, const void* b))
 {
-    ifp(!vec,
-        EV_FAIL("Cannot get size of a NULL vector\n");
-        return -1;
-    );
+    const size_t m = k + 1;
+    for(size_t i = m / 2; i-- > 0; ){
+        _evselmaxdown(data, m, slt, i, compar);
+    }
+    for(size_t i = m; i < n; i++){
+        if(compar(data + i * slt, data) < 0){
+            _evselswap(data + i * slt, data, slt);
+            _evselmaxdown(data, m, slt, 0, compar);
+        }
+    }
+    _evselswap(data, data + k * slt, slt);
+}
 
-    evhd_t *hdr = EV_HDR(vec);
-    ifp(_evhdrcheck(hdr),
-        EV_FAIL("Header sanity check failed\n");
-        return -1;
-    );
+//Internal function, introselect. Partition around the median of three until
+//the range holding k is small, or the pivots have been bad for too long.
+static void _evselect(char* data, size_t n, size_t slt, size_t k,
+                      int (*compar)(const void* a, const void* b))
+{
+    size_t lo = 0;
+    size_t hi = n;
+    size_t depth = _evseldepth(n);
+    while(hi - lo > EV_SELECT_SMALL){
+        if(!depth--){
+            _evselheap(data + lo * slt, hi - lo, slt, k - lo, compar);
+            return;
+        }
+
+        //Put the median of the first, middle and last items at lo as the pivot
+        char* a = data + lo * slt;
+        char* b = data + (lo + (hi - lo) / 2) * slt;
+        char* c = data + (hi - 1) * slt;
+        char* mid = compar(a, b) < 0 ?
+                    (compar(b, c) < 0 ? b : (compar(a, c) < 0 ? c : a)) :
+                    (compar(a, c) < 0 ? a : (compar(b, c) < 0 ? c : b));
+        _evselswap(data + lo * slt, mid, slt);
+        const char* pivot = data + lo * slt;
+
+        //Items equal to the pivot stop both scans, so they split evenly
+        size_t i = lo + 1;
+        size_t j = hi - 1;
+        for(;;){
+            while(i <= j && compar(data + i * slt, pivot) < 0){
+                i++;
+            }
+            while(i <= j && compar(data + j * slt, pivot) > 0){
+                j--;
+            }
+            if(i >= j){
+                break;
+            }
+            _evselswap(data + i * slt, data + j * slt, slt);
+            i++;
+            j--;
+        }
+        _evselswap(data + lo * slt, data + j * slt, slt);
+
+        if(k == j){
+            return;
+        }
+        if(k < j){
+            hi = j;
+        }
+        else{
+            lo = j + 1;
+        }
+    }
 
-    return hdr->obj_count * hdr->slt_size;
+    for(size_t i = lo + 1; i < hi; i++){
+        for(size_t j = i; j > lo && compar(data + j * slt, data + (j - 1) * slt) < 0; j--){
+            _evselswap(data + j * slt, data + (j - 1) * slt, slt);
+        }
+    }
 }
 
 
-size_t evtmem(void* vec)
+void evnth(void* vec, size_t k, int (*compar)(const void* a, const void* b))
 {
     ifp(!vec,
-        EV_FAIL("Cannot get size of a NULL vector\n");
-        return -1;
+        EV_FAIL("Cannot select from a NULL vector\n");
+        return;
     );
 
-    return evvmem(vec) + EV_HDR_BYTES;
-}
+    evhd_t* hdr = EV_HDR(vec);
+    char* data = _evseldata(vec, hdr);
+    if(!data){
+        return;
+    }
+    ifp(k >= (size_t)hdr->obj_count,
+        EV_FAIL("Index (%zu) is past the end of the vector (%" PRId64 " items)\n",
+                k, (int64_t)hdr->obj_count);
+        return;
+    );
 
-#endif
+    _evselect(data, hdr->obj_count, hdr->slt_size, k, compar);
+    _evincsync(hdr, vec, 0, hdr->obj_count);
+}
 
 
-#if defined EV_FSORT  | defined EV_FALL
-void evsort(void* vec, int (*compar)(const void* a, const void* b))
+void evpartial_sort(void* vec, size_t k, int (*compar)(const void* a, const void* b))
 {
     ifp(!vec,
         EV_FAIL("Cannot sort a NULL vector\n");
         return;
     );
 
-    evhd_t *hdr =  EV_HDR(vec);
-    ifp(_evhdrcheck(hdr),
-        EV_FAIL("Header sanity check failed\n");
+    evhd_t* hdr = EV_HDR(vec);
+    char* data = _evseldata(vec, hdr);
+    const size_t n = hdr->obj_count;
+    if(!data || !n || !k){
         return;
-    );
+    }
 
-    qsort(vec,hdr->obj_count,hdr->slt_size,compar);
+    //Select the last of the k, then sort the ones in front of it
+    k = k < n ? k : n;
+    if(k < n){
+        _evselect(data, n, hdr->slt_size, k - 1, compar);
+    }
+    qsort(data, k < n ? k - 1 : n, hdr->slt_size, compar);
+    _evincsync(hdr, vec, 0, n);
 }
-#endif
 
 
-#if defined EV_FCOPY  | defined EV_FALL
-void* evcpy(void* src)
+void* evtopk_push(void* vec, void* obj, size_t obj_size, size_t k, int (*compar)(const void* a, const void* b))
 {
-    ifp(!src,
-        EV_FAIL("Cannot copy a NULL vector\n");
+    void* result = vec;
+    if(!vec){
+        //Get some memory
+        result = evinisz(obj_size);
+    }
+
+    evhd_t* hdr = EV_HDR(result);
+    ifp(_evhdrcheck(hdr),
+        EV_FAIL("Header sanity check failed\n");
         return NULL;
     );
-    evhd_t *src_hdr = EV_HDR(src);
-    ifp(_evhdrcheck(src_hdr),
-        EV_FAIL("Header sanity check failed\n");
+
+    //Sanity check
+    ifp(obj_size > hdr->slt_size,
+        EV_FAIL("Object size (%" PRId64 ") is larger than there is space (%" PRId64 ")\n",
+                (int64_t)obj_size,
+                (int64_t)hdr->slt_size);
+                return NULL;
+    );
+    ifp((size_t)hdr->obj_count > k,
+        EV_FAIL("Top k vector holds %" PRId64 " items, more than k (%zu)\n",
+                (int64_t)hdr->obj_count, k);
         return NULL;
     );
 
+    const size_t slt = hdr->slt_size;
+    if((size_t)hdr->obj_count == k){
+        //Full, so only a value that sorts before the top can replace it
+        char* data = _evseldata(result, hdr);
+        if(!data || !k || compar(obj, data) >= 0){
+            return result;
+        }
+        memcpy(data, obj, obj_size);
+        memset(data + obj_size, 0, slt - obj_size);
+        _evincpath(hdr, result, _evselmaxdown(data, k, slt, 0, compar), 0, 2);
+        EV_STAT_ADD(hdr, pushes, 1);
+        return result;
+    }
 
-    void* result = NULL;
-    result = evini(src_hdr->slt_size, src_hdr->slt_count);
-    if(!result){
-        EV_FAIL("Could not create new vector memory to copy into\n");
+    //Enough space?
+    if(hdr->obj_count == hdr->slt_count){
+        result = _evgrow(result);
+        if(!result){
+            return NULL;
+        }
+        hdr = EV_HDR(result);
+    }
+
+    char* data = _evseldata(result, hdr);
+    if(!data){
         return NULL;
     }
-    evhd_t *res_hdr = EV_HDR(result);
 
-    memcpy(res_hdr,src_hdr,EV_HDR_BYTES + src_hdr->slt_size * src_hdr->obj_count);
+    //Add it at the bottom, then move it up past any parents that sort before it
+    size_t i = hdr->obj_count;
+    memcpy(data + i * slt, obj, obj_size);
+    memset(data + i * slt + obj_size, 0, slt - obj_size);
+    while(i > 0){
+        const size_t parent = (i - 1) / 2;
+        if(compar(data + i * slt, data + parent * slt) <= 0){
+            break;
+        }
+        _evselswap(data + i * slt, data + parent * slt, slt);
+        i = parent;
+    }
+    hdr->obj_count++;
+
+    EV_STAT_ADD(hdr, pushes, 1);
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count);
+    _evincpath(hdr, result, hdr->obj_count - 1, i, 2);
+    _evincpush(hdr, result, hdr->obj_count - 1);
 
     return result;
 }
+
+
+void evtopk_sort(void* vec, int (*compar)(const void* a, const void* b))
+{
+    ifp(!vec,
+        EV_FAIL("Cannot sort a NULL vector\n");
+        return;
+    );
+
+    evhd_t* hdr = EV_HDR(vec);
+    char* data = _evseldata(vec, hdr);
+    if(!data){
+        return;
+    }
+    _evselheapsort(data, hdr->obj_count, hdr->slt_size, compar);
+    _evincsync(hdr, vec, 0, hdr->obj_count);
+}
+
+//Internal macro, the typed selection. These follow the generic versions, but
+//hold the pivot (or the item being moved) in a local, and shift the others
+//over the hole it leaves rather than swapping.
+#define _EV_SELECT_IMPL(S, T, A) \
+static inline T* _evseldata_##S(T* vec) \
+{ \
+    evhd_t* hdr = EV_HDR(vec); \
+    ifp(hdr->slt_size != sizeof(T), \
+        EV_FAIL("Slot size (%" PRId64 ") does not match the vector type size (%zu)\n", \
+                (int64_t)hdr->slt_size, sizeof(T)); \
+        return NULL; \
+    ); \
+    return (T*)_evseldata(vec, hdr); \
+} \
+\
+static inline size_t _evselmaxdown_##S(T* a, size_t n, size_t i) \
+{ \
+    const T val = a[i]; \
+    for(;;){ \
+        size_t best = 2 * i + 1; \
+        if(best >= n){ \
+            break; \
+        } \
+        best += best + 1 < n && a[best] < a[best + 1]; \
+        if(!(val < a[best])){ \
+            break; \
+        } \
+        a[i] = a[best]; \
+        i = best; \
+    } \
+    a[i] = val; \
+    return i; \
+} \
+\
+static void _evselheapsort_##S(T* a, size_t n) \
+{ \
+    while(n > 1){ \
+        n--; \
+        const T top = a[0]; \
+        a[0] = a[n]; \
+        a[n] = top; \
+        _evselmaxdown_##S(a, n, 0); \
+    } \
+} \
+\
+static void _evselect_##S(T* a, size_t n, size_t k) \
+{ \
+    size_t lo = 0; \
+    size_t hi = n; \
+    size_t depth = _evseldepth(n); \
+    while(hi - lo > EV_SELECT_SMALL){ \
+        if(!depth--){ \
+            T* b = a + lo; \
+            const size_t m = k - lo + 1; \
+            for(size_t i = m / 2; i-- > 0; ){ \
+                _evselmaxdown_##S(b, m, i); \
+            } \
+            for(size_t i = m; i < hi - lo; i++){ \
+                if(b[i] < b[0]){ \
+                    const T val = b[i]; \
+                    b[i] = b[0]; \
+                    b[0] = val; \
+                    _evselmaxdown_##S(b, m, 0); \
+                } \
+            } \
+            const T top = b[0]; \
+            b[0] = b[m - 1]; \
+            b[m - 1] = top; \
+            return; \
+        } \
+\
+        const size_t m = lo + (hi - lo) / 2; \
+        const T x = a[lo], y = a[m], z = a[hi - 1]; \
+        const size_t mid = x < y ? (y < z ? m : (x < z ? hi - 1 : lo)) : \
+                                   (x < z ? lo : (y < z ? hi - 1 : m)); \
+        const T pivot = a[mid]; \
+        a[mid] = a[lo]; \
+        a[lo] = pivot; \
+\
+        size_t i = lo + 1; \
+        size_t j = hi - 1; \
+        for(;;){ \
+            while(i <= j && a[i] < pivot){ \
+                i++; \
+            } \
+            while(i <= j && pivot < a[j]){ \
+                j--; \
+            } \
+            if(i >= j){ \
+                break; \
+            } \
+            const T val = a[i]; \
+            a[i++] = a[j]; \
+            a[j--] = val; \
+        } \
+        a[lo] = a[j]; \
+        a[j] = pivot; \
+\
+        if(k == j){ \
+            return; \
+        } \
+        if(k < j){ \
+            hi = j; \
+        } \
+        else{ \
+            lo = j + 1; \
+        } \
+    } \
+\
+    for(size_t i = lo + 1; i < hi; i++){ \
+        const T val = a[i]; \
+        size_t j = i; \
+        for(; j > lo && val < a[j - 1]; j--){ \
+            a[j] = a[j - 1]; \
+        } \
+        a[j] = val; \
+    } \
+} \
+\
+void evnth_##S(T* vec, size_t k) \
+{ \
+    ifp(!vec, \
+        EV_FAIL("Cannot select from a NULL vector\n"); \
+        return; \
+    ); \
+\
+    T* a = _evseldata_##S(vec); \
+    evhd_t* hdr = EV_HDR(vec); \
+    if(!a){ \
+        return; \
+    } \
+    ifp(k >= (size_t)hdr->obj_count, \
+        EV_FAIL("Index (%zu) is past the end of the vector (%" PRId64 " items)\n", \
+                k, (int64_t)hdr->obj_count); \
+        return; \
+    ); \
+\
+    _evselect_##S(a, hdr->obj_count, k); \
+    _evincsync(hdr, vec, 0, hdr->obj_count); \
+} \
+\
+void evpartial_sort_##S(T* vec, size_t k) \
+{ \
+    ifp(!vec, \
+        EV_FAIL("Cannot sort a NULL vector\n"); \
+        return; \
+    ); \
+\
+    T* a = _evseldata_##S(vec); \
+    const size_t n = EV_HDR(vec)->obj_count; \
+    if(!a || !n || !k){ \
+        return; \
+    } \
+\
+    k = k < n ? k : n; \
+    if(k < n){ \
+        _evselect_##S(a, n, k - 1); \
+        k--; \
+    } \
+    for(size_t i = k / 2; i-- > 0; ){ \
+        _evselmaxdown_##S(a, k, i); \
+    } \
+    _evselheapsort_##S(a, k); \
+    _evincsync(EV_HDR(vec), vec, 0, n); \
+} \
+\
+T* evtopk_push_##S(T* vec, T value, size_t k) \
+{ \
+    if(!vec){ \
+        vec = evinisz(sizeof(T)); \
+    } \
+\
+    evhd_t* hdr = EV_HDR(vec); \
+    ifp(_evhdrcheck(hdr), \
+        EV_FAIL("Header sanity check failed\n"); \
+        return NULL; \
+    ); \
+    ifp((size_t)hdr->obj_count > k, \
+        EV_FAIL("Top k vector holds %" PRId64 " items, more than k (%zu)\n", \
+                (int64_t)hdr->obj_count, k); \
+        return NULL; \
+    ); \
+\
+    if((size_t)hdr->obj_count == k){ \
+        T* a = _evseldata_##S(vec); \
+        if(!a || !k || !(value < a[0])){ \
+            return vec; \
+        } \
+        a[0] = value; \
+        _evincpath(hdr, vec, _evselmaxdown_##S(a, k, 0), 0, 2); \
+        EV_STAT_ADD(hdr, pushes, 1); \
+        return vec; \
+    } \
+\
+    if(hdr->obj_count == hdr->slt_count){ \
+        vec = _evgrow(vec); \
+        if(!vec){ \
+            return NULL; \
+        } \
+        hdr = EV_HDR(vec); \
+    } \
+\
+    T* a = _evseldata_##S(vec); \
+    if(!a){ \
+        return NULL; \
+    } \
+    size_t i = hdr->obj_count; \
+    while(i > 0){ \
+        const size_t parent = (i - 1) / 2; \
+        if(!(a[parent] < value)){ \
+            break; \
+        } \
+        a[i] = a[parent]; \
+        i = parent; \
+    } \
+    a[i] = value; \
+    hdr->obj_count++; \
+\
+    EV_STAT_ADD(hdr, pushes, 1); \
+    EV_STAT_MAX(hdr, peak_objs, hdr->obj_count); \
+    _evincpath(hdr, vec, hdr->obj_count - 1, i, 2); \
+    _evincpush(hdr, vec, hdr->obj_count - 1); \
+\
+    return vec; \
+} \
+\
+void evtopk_sort_##S(T* vec) \
+{ \
+    ifp(!vec, \
+        EV_FAIL("Cannot sort a NULL vector\n"); \
+        return; \
+    ); \
+\
+    T* a = _evseldata_##S(vec); \
+    if(!a){ \
+        return; \
+    } \
+    _evselheapsort_##S(a, EV_HDR(vec)->obj_count); \
+    _evincsync(EV_HDR(vec), vec, 0, INT64_MAX); \
+}
+_EV_NUM_TYPES(_EV_SELECT_IMPL)
 #endif
 
 #endif /* EV_HONLY */
 
+#if EV_TRACE
+/*
+ * Tracing versions of the functions that make vectors. These come after the
+ * implementation so that only calls from user code are traced.
+ */
+#define evini(slt_size, count) _evtrsite(evini(slt_size, count), __FILE__, __LINE__)
+#define evpush(vec, obj, obj_size) _evtrpush(vec, obj, obj_size, __FILE__, __LINE__)
+#if defined EV_FALIGN || defined EV_FALL
+#define evini_aligned(slt_size, count, alignment) \
+    _evtrsite(evini_aligned(slt_size, count, alignment), __FILE__, __LINE__)
+#endif
+#if defined EV_FCOPY  | defined EV_FALL
+#define evcpy(src) _evtrsite(evcpy(src), __FILE__, __LINE__)
+#endif
+#if defined EV_FADOPT || defined EV_FALL
+#define evadopt(buf, slt_size, count, capacity) \
+    _evtrsite(evadopt(buf, slt_size, count, capacity), __FILE__, __LINE__)
+#endif
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* EVH_ */
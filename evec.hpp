@@ -0,0 +1,406 @@
+/*
+ * Easy Vector (EV) for C++
+ * ========================
+ * A header only C++ wrapper around EV. An ev::vector<T> keeps its items in a
+ * normal EV vector, with the same header layout, so that the storage can be
+ * passed to and from C code without copying.
+ *
+ * The EV implementation is C, not C++, so it must be compiled in one C file of
+ * the project, by including "evec.h" as normal. This header only includes the
+ * EV declarations (see EV_HONLY). Both must be built with the same EV_F* and
+ * EV_STATS / EV_TRACE options, so that they agree on the header layout.
+ *
+ * Documentation
+ * =============
+ * Please see README.md
+ *
+ * Legal Stuff
+ * ============
+ * Copyright (c) 2020, Matthew P. Grosvenor
+ * All rights reserved. See evec.h for the full license.
+ */
+
+#ifndef EVHPP_
+#define EVHPP_
+
+#ifndef EV_HONLY
+#define EV_HONLY
+#endif
+#include "evec.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace ev {
+
+template <typename T>
+class vector {
+    static_assert(alignof(T) <= alignof(align),
+                  "ev::vector slots are only aligned to alignof(max_align_t)");
+
+public:
+    using value_type             = T;
+    using size_type              = size_t;
+    using difference_type        = ptrdiff_t;
+    using reference              = T&;
+    using const_reference        = const T&;
+    using pointer                = T*;
+    using const_pointer          = const T*;
+    using iterator               = T*; //Plain pointers, so these are random access
+    using const_iterator         = const T*;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    //The slot size of the underlying EV vector
+    static constexpr size_type slot_size = sizeof(T);
+
+    vector() noexcept = default;
+
+    explicit vector(size_type count)
+    {
+        resize(count);
+    }
+
+    vector(size_type count, const T& value)
+    {
+        reserve(count);
+        for(size_type i = 0; i < count; i++){
+            push_back(value);
+        }
+    }
+
+    vector(std::initializer_list<T> init)
+    {
+        reserve(init.size());
+        for(const T& value : init){
+            push_back(value);
+        }
+    }
+
+    vector(const vector& other)
+    {
+        reserve(other.size());
+        for(const T& value : other){
+            push_back(value);
+        }
+    }
+
+    vector(vector&& other) noexcept : vec_(other.vec_)
+    {
+        other.vec_ = nullptr;
+    }
+
+    ~vector()
+    {
+        reset();
+    }
+
+    vector& operator=(const vector& other)
+    {
+        if(this != &other){
+            vector copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    vector& operator=(vector&& other) noexcept
+    {
+        if(this != &other){
+            reset();
+            vec_ = other.vec_;
+            other.vec_ = nullptr;
+        }
+        return *this;
+    }
+
+    /*
+     * Passing storage across the C/C++ boundary
+     */
+
+    //Take ownership of a vector made in C. It is freed when this is destroyed.
+    static vector adopt(T* vec)
+    {
+        vector result;
+        if(!vec){
+            return result;
+        }
+
+        if(EV_HDR(vec)->slt_size != (int64_t)slot_size){
+            throw std::invalid_argument("ev::vector::adopt() slot size does not match the type");
+        }
+
+#if defined EV_FINCR || defined EV_FALL
+        vec = static_cast<T*>(evincfin(vec));
+#endif
+        result.vec_ = vec;
+        return result;
+    }
+
+    //Give up ownership of the storage, which is then freed with evfree()
+    T* release() noexcept
+    {
+        T* vec = vec_;
+        vec_ = nullptr;
+        return vec;
+    }
+
+    //The underlying EV vector, for C functions that do not keep it
+    T* c_vec() const noexcept
+    {
+        return vec_;
+    }
+
+    /*
+     * Capacity
+     */
+
+    size_type size() const noexcept
+    {
+        return vec_ ? hdr()->obj_count : 0;
+    }
+
+    size_type capacity() const noexcept
+    {
+        return vec_ ? hdr()->slt_count : 0;
+    }
+
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    //Room for at least count items. The storage may grow by more than this.
+    void reserve(size_type count)
+    {
+        if(count > capacity()){
+            regrow(count, count);
+        }
+    }
+
+    /*
+     * Access
+     */
+
+    T& operator[](size_type idx) noexcept { return vec_[idx]; }
+    const T& operator[](size_type idx) const noexcept { return vec_[idx]; }
+
+    T& at(size_type idx)
+    {
+        check(idx);
+        return vec_[idx];
+    }
+
+    const T& at(size_type idx) const
+    {
+        check(idx);
+        return vec_[idx];
+    }
+
+    T& front() noexcept { return vec_[0]; }
+    const T& front() const noexcept { return vec_[0]; }
+    T& back() noexcept { return vec_[size() - 1]; }
+    const T& back() const noexcept { return vec_[size() - 1]; }
+    T* data() noexcept { return vec_; }
+    const T* data() const noexcept { return vec_; }
+
+    iterator begin() noexcept { return vec_; }
+    iterator end() noexcept { return vec_ + size(); }
+    const_iterator begin() const noexcept { return vec_; }
+    const_iterator end() const noexcept { return vec_ + size(); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+    reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+    reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+    /*
+     * Modifiers
+     */
+
+    void push_back(const T& value)
+    {
+        emplace_back(value);
+    }
+
+    void push_back(T&& value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        const size_type count = size();
+        if(count == capacity()){
+            //The arguments may refer to items that are about to move
+            T value(std::forward<Args>(args)...);
+            regrow(count + 1, grown());
+            return place(std::move(value));
+        }
+        return place(std::forward<Args>(args)...);
+    }
+
+    void pop_back() noexcept
+    {
+        vec_[size() - 1].~T();
+        hdr()->obj_count--;
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        iterator it = vec_ + (pos - vec_);
+        std::move(it + 1, end(), it);
+        pop_back();
+        return it;
+    }
+
+    void clear() noexcept
+    {
+        while(!empty()){
+            pop_back();
+        }
+    }
+
+    void resize(size_type count)
+    {
+        reserve(count);
+        while(size() < count){
+            emplace_back();
+        }
+        while(size() > count){
+            pop_back();
+        }
+    }
+
+    void swap(vector& other) noexcept
+    {
+        std::swap(vec_, other.vec_);
+    }
+
+private:
+    T* vec_ = nullptr;
+
+    evhd_t* hdr() const noexcept
+    {
+        return EV_HDR(vec_);
+    }
+
+    void check(size_type idx) const
+    {
+        if(idx >= size()){
+            throw std::out_of_range("ev::vector index out of range");
+        }
+    }
+
+    //The slot count to grow to when out of room, by the vector's growth policy
+    size_type grown() const noexcept
+    {
+        if(!vec_){
+            return EV_INIT_COUNT;
+        }
+#if defined EV_FGROW || defined EV_FALL
+        return evgrwslts(vec_);
+#else
+        return capacity() ? capacity() * EV_GROWTH_FACTOR : EV_INIT_COUNT;
+#endif
+    }
+
+    template <typename... Args>
+    T& place(Args&&... args)
+    {
+        T* slot = ::new (static_cast<void*>(vec_ + size())) T(std::forward<Args>(args)...);
+        hdr()->obj_count++;
+        return *slot;
+    }
+
+    //Grow to at least need slots (want slots if it has to move the items)
+    void regrow(size_type need, size_type want)
+    {
+        want = want > need ? want : need;
+        if(!vec_){
+            vec_ = static_cast<T*>(evini(slot_size, want));
+            if(!vec_){
+                throw std::bad_alloc();
+            }
+            return;
+        }
+
+        if(std::is_trivially_copyable<T>::value){
+            //Safe to move with realloc(), which keeps the header as it is
+            T* vec = static_cast<T*>(evrsv(vec_, need));
+            if(!vec){
+                throw std::bad_alloc();
+            }
+            vec_ = vec;
+            return;
+        }
+
+        //Everything else has to be moved item by item into new storage
+        evhd_t* old_hdr = hdr();
+        T* vec = nullptr;
+#if defined EV_FALIGN || defined EV_FALL
+        if(EV_ALIGN(old_hdr)){
+            vec = static_cast<T*>(evini_aligned(slot_size, want, EV_ALIGN(old_hdr)));
+        }
+        else
+#endif
+        vec = static_cast<T*>(evini(slot_size, want));
+        if(!vec){
+            throw std::bad_alloc();
+        }
+        if(evpolicy(vec, vec_)){
+            evfree(vec);
+            throw std::bad_alloc();
+        }
+
+        //Only touch the old items once every one has a new home, so that a
+        //throwing copy leaves this vector as it was
+        const size_type count = size();
+        size_type built = 0;
+        try{
+            for(; built < count; built++){
+                ::new (static_cast<void*>(vec + built)) T(std::move_if_noexcept(vec_[built]));
+            }
+        }
+        catch(...){
+            for(size_type i = 0; i < built; i++){
+                vec[i].~T();
+            }
+            evfree(vec);
+            throw;
+        }
+        for(size_type i = 0; i < count; i++){
+            vec_[i].~T();
+        }
+        EV_HDR(vec)->obj_count = count;
+        old_hdr->obj_count = 0;
+        evfree(vec_);
+        vec_ = vec;
+    }
+
+    void reset() noexcept
+    {
+        if(vec_){
+            clear();
+            vec_ = static_cast<T*>(evfree(vec_));
+        }
+    }
+};
+
+template <typename T>
+void swap(vector<T>& lhs, vector<T>& rhs) noexcept
+{
+    lhs.swap(rhs);
+}
+
+} //namespace ev
+
+#endif /* EVHPP_ */
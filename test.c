@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <sys/wait.h>
+#include <pthread.h>
 
 #define EV_FALL
 #include "evec.h"
@@ -369,6 +372,1457 @@ static int test12()
 }
 
 
+/* Test 13
+ * - Make a vector in stack storage with evinistk()
+ * - Push values until the stack storage is full, check that it stays put.
+ * - Push one more value, check that the vector moves to the heap intact.
+ * - Test that evfree() works (with valgrind).
+ * */
+static int test13()
+{
+    int* a = evinistk(int, 8);
+    int* const stk = a;
+    if(evcnt(a) != 0) return 0;
+    if(evvsz(a) != 8) return 0;
+
+    for(int i = 0; i < 8; i++){
+        evpsh(a,i);
+    }
+    if(a != stk) return 0;
+
+    evpsh(a,8);
+    if(a == stk) return 0;
+    if(evvsz(a) <= 8) return 0;
+
+    for(int i = 0; i < evcnt(a); i++){
+        if(a[i] != i) return 0;
+    }
+
+    a = evfree(a);
+
+    //Storage that is never outgrown is never allocated, or freed
+    int* b = evinistk(int, 4);
+    evpsh(b,1);
+    b = evfree(b);
+    return 1;
+}
+
+
+/* Test 14
+ * - Push 1000 ints into a segmented vector, keeping pointers to a few of them.
+ * - Test that the pointers do not move as the vector grows.
+ * - Test the evsgidx() function returns pointer to the right places.
+ * - Test that block wise iteration visits every item in order.
+ * - Test that evsgfree() works (with valgrind).
+ */
+static int test14()
+{
+    evsg_t* a = NULL;
+    int* first = NULL;
+    int* mid = NULL;
+    for(int i = 0; i < 1000; i++){
+        evsgpsh(a,i);
+        if(i == 0)   first = evsgidx(a,0);
+        if(i == 500) mid = evsgidx(a,500);
+    }
+
+    if(evsgcnt(a) != 1000) return 0;
+    if(first != evsgidx(a,0) || *first != 0) return 0;
+    if(mid != evsgidx(a,500) || *mid != 500) return 0;
+
+    for(int i = 0; i < 1000; i++){
+        int* ai = evsgidx(a,i);
+        if(*ai != i) return 0;
+    }
+
+    int next = 0;
+    for(size_t b = 0; b < evsgblks(a); b++){
+        size_t count = 0;
+        int* blk = evsgblk(a, b, &count);
+        for(size_t i = 0; i < count; i++){
+            if(blk[i] != next++) return 0;
+        }
+    }
+    if(next != 1000) return 0;
+
+    evsgpop(a);
+    if(evsgcnt(a) != 999) return 0;
+
+    a = evsgfree(a);
+    return 1;
+}
+
+
+/* Test 15
+ * - Set a fractional growth factor, with fixed steps above a limit.
+ * - Push ints and check that the vector grows by the policy.
+ * - Set the page rounding and allocator slack policy.
+ * - Check the vector grows to fill whole pages (at least).
+ * - Reserve space with evrsv() and check that the items are kept.
+ * - Copy the policy to another vector with evpolicy(), and check it grows the
+ *   same way.
+ * - Test that evfree() works (with valgrind).
+ */
+static int test15()
+{
+    int* a = evini(sizeof(int), 8);
+    evgrw(a, 1.5, 16, 100, 0);
+
+    const size_t sizes[] = { 8, 12, 18, 118, 218 };
+    for(int i = 0, s = 0; i < 200; i++){
+        if(evvsz(a) != sizes[s]){
+            if(evvsz(a) != sizes[++s]) return 0;
+        }
+        evpsh(a,i);
+    }
+
+    for(int i = 0; i < 200; i++){
+        if(a[i] != i) return 0;
+    }
+
+    int* c = evini(sizeof(int), 8);
+    if(evpolicy(c, a)) return 0;
+    for(int i = 0, s = 0; i < 200; i++){
+        if(evvsz(c) != sizes[s]){
+            if(evvsz(c) != sizes[++s]) return 0;
+        }
+        evpsh(c,i);
+    }
+    c = evfree(c);
+    a = evfree(a);
+
+    int* b = evini(sizeof(int), 8);
+    evgrw(b, 2.0, 0, 0, EV_FLAG_GRW_PAGE | EV_FLAG_GRW_USABLE);
+    for(int i = 0; i < 9; i++){
+        evpsh(b,i);
+    }
+
+    const size_t page = sysconf(_SC_PAGESIZE);
+    if(evtmem(b) < page - sizeof(int)) return 0;
+    for(int i = 0; i < 9; i++){
+        if(b[i] != i) return 0;
+    }
+
+    //Reserve grows once, to at least the count asked for
+    b = evrsv(b, 100000);
+    if(evvsz(b) < 100000 || evcnt(b) != 9 || b[8] != 8) return 0;
+
+    b = evfree(b);
+    return 1;
+}
+
+
+/* Test 16
+ * - Make a cache line aligned vector with evini_aligned().
+ * - Push 1000 ints and check the slots stay aligned as the vector grows.
+ * - Check that a copy made by evcpy() is aligned too.
+ * - Make a vector where every slot is aligned with evini_aligned_slots().
+ * - Test that evfree() works (with valgrind).
+ */
+static int test16()
+{
+    int* a = evini_aligned(sizeof(int), 4, EV_CACHE_LINE);
+    for(int i = 0; i < 1000; i++){
+        if((uintptr_t)a % EV_CACHE_LINE) return 0;
+        evpsh(a,i);
+    }
+
+    int* b = evcpy(a);
+    if((uintptr_t)b % EV_CACHE_LINE) return 0;
+    for(int i = 0; i < 1000; i++){
+        if(a[i] != i || b[i] != i) return 0;
+    }
+    a = evfree(a);
+    b = evfree(b);
+
+    int* c = evini_aligned_slots(sizeof(int) * 3, 4, EV_CACHE_LINE);
+    for(int i = 0; i < 100; i++){
+        evpsh(c,i);
+    }
+    for(int i = 0; i < 100; i++){
+        int* ci = evidx(c,i);
+        if((uintptr_t)ci % EV_CACHE_LINE) return 0;
+        if(*ci != i) return 0;
+    }
+    c = evfree(c);
+    return 1;
+}
+
+
+/* Test 17
+ * - Similar to test 7, but this time with a variable length vector.
+ * - Push 1000 strings of different lengths into the vector.
+ * - Test the evvridx() function returns the right records and sizes.
+ * - Test that iteration with evvreach() visits every record in order.
+ * - Push the same strings into an interning vector, check it uses less memory.
+ * - Push and pop many distinct strings through an interning vector, and check
+ *   that the intern table and pool do not grow, and that duplicates are still
+ *   found after pops.
+ * - Test that evvrfree() works (with valgrind).
+ */
+static int test17_churn()
+{
+    evvr_t* v = evvrini(EV_FLAG_VAR_INTERN);
+    char buf[32];
+    for(int i = 0; i < 64; i++){
+        snprintf(buf, sizeof(buf), "keep %i", i);
+        evvrpsh(v, buf);
+    }
+    const int64_t pool = v->pool_used;
+
+    size_t mem = 0;
+    for(int round = 0; round < 100; round++){
+        for(int i = 0; i < 32; i++){
+            snprintf(buf, sizeof(buf), "round %03i item %02i", round, i);
+            evvrpsh(v, buf);
+        }
+        for(int i = 0; i < 32; i++){
+            evvrpop(v);
+        }
+        mem = mem ? mem : evvrmem(v);
+    }
+    if(evvrmem(v) != mem || v->pool_used != pool || v->itab_used != 64) return 0;
+
+    //Pop half of the kept strings, then push all of them again
+    for(int i = 0; i < 32; i++){
+        evvrpop(v);
+    }
+    for(int i = 0; i < 64; i++){
+        snprintf(buf, sizeof(buf), "keep %i", i);
+        evvrpsh(v, buf);
+    }
+    if(v->pool_used != pool || v->itab_used != 64) return 0;
+    if(evvrcnt(v) != 96) return 0;
+    for(int i = 0; i < 96; i++){
+        snprintf(buf, sizeof(buf), "keep %i", i < 32 ? i : i - 32);
+        if(strcmp(evvridx(v, i, NULL), buf)) return 0;
+        if(i < 32 && evvridx(v, i, NULL) != evvridx(v, i + 32, NULL)) return 0;
+    }
+
+    v = evvrfree(v);
+    return 1;
+}
+
+static int test17()
+{
+    evvr_t* a = NULL;
+    evvr_t* b = evvrini(EV_FLAG_VAR_INTERN);
+    char* strs[] = {
+            "Test",
+            "Best",
+            "Rest",
+            "Vector",
+            "Victor",
+            0
+    };
+
+    for(int i = 0; i < 1000; i++){
+        evvrpsh(a, strs[i % 5]);
+        evvrpsh(b, strs[i % 5]);
+    }
+
+    if(evvrcnt(a) != 1000 || evvrcnt(b) != 1000) return 0;
+
+    for(int i = 0; i < 1000; i++){
+        size_t size = 0;
+        char* ai = evvridx(a, i, &size);
+        char* bi = evvridx(b, i, NULL);
+        if(strcmp(ai,strs[i % 5]) || size != strlen(strs[i % 5]) + 1) return 0;
+        if(strcmp(bi,strs[i % 5])) return 0;
+    }
+
+    int i = 0;
+    evvreach(a, ai){
+        if(strcmp(ai,strs[i++ % 5])) return 0;
+    }
+    if(i != 1000) return 0;
+
+    if(evvrmem(b) >= evvrmem(a)) return 0;
+
+    evvrpop(a);
+    evvrpop(b);
+    if(evvrcnt(a) != 999 || evvrcnt(b) != 999) return 0;
+    evvrpsh(b, "Victor");
+    if(strcmp(evvridx(b, 999, NULL), "Victor")) return 0;
+
+    a = evvrfree(a);
+    b = evvrfree(b);
+    return test17_churn();
+}
+
+
+/* Test 18
+ * - Make a columnar vector from a struct and a list of its fields.
+ * - Push 1000 records in reverse order.
+ * - Test that each column is a contiguous array of the right values.
+ * - Test that evclsort() sorts every column by the key column.
+ * - Test that evcldel() and evclpop() keep the columns in step.
+ * - Test that every column stays cache line aligned as it grows, and that
+ *   growth follows a policy with a limit and a step.
+ * - Test that evclfree() works (with valgrind).
+ */
+typedef struct {
+    char tag[3];
+    int32_t id;
+    double score;
+} rec_t;
+
+static int test18()
+{
+    evcl_t* a = evclinit(rec_t, id, score, tag);
+    for(int i = 0; i < 1000; i++){
+        rec_t r = { .tag = { 'a' + i % 26, 0, 0 }, .id = 999 - i, .score = (999 - i) * 0.5 };
+        evclpsh(a, r);
+    }
+
+    if(evclcnt(a) != 1000) return 0;
+
+    int32_t* ids = evclcol(a, 0);
+    double* scores = evclcol(a, 1);
+    for(int i = 0; i < 1000; i++){
+        if(ids[i] != 999 - i || scores[i] != ids[i] * 0.5) return 0;
+    }
+
+    evclsort(a, 0, compare);
+    ids = evclcol(a, 0);
+    scores = evclcol(a, 1);
+    for(int i = 0; i < 1000; i++){
+        rec_t r;
+        evclget(a, i, &r);
+        if(ids[i] != i || scores[i] != i * 0.5) return 0;
+        if(r.id != i || r.score != i * 0.5 || r.tag[0] != 'a' + (999 - i) % 26) return 0;
+    }
+
+    evcldel(a, 0);
+    evclpop(a);
+    if(evclcnt(a) != 998) return 0;
+    if(*(int32_t*)evclidx(a, 0, 0) != 1) return 0;
+    if(*(double*)evclidx(a, 1, 997) != 998 * 0.5) return 0;
+
+    a = evclfree(a);
+
+    //8 -> 12 -> 18 by the factor, then past the limit of 16 by steps of 4
+    evcl_t* b = evclinit(rec_t, tag, id);
+    evclgrw(b, 1.5, 16, 4);
+    for(int i = 0; i < 1000; i++){
+        rec_t r = { .tag = { 'a' + i % 26, 0, 0 }, .id = i };
+        if(evclpush(b, &r)) return 0;
+        if((uintptr_t)evclcol(b, 0) % EV_CACHE_LINE || (uintptr_t)evclcol(b, 1) % EV_CACHE_LINE) return 0;
+        if(i == 12 && b->slt_count != 18) return 0;
+        if(i == 18 && b->slt_count != 22) return 0;
+    }
+    if(*(int32_t*)evclidx(b, 1, 999) != 999 || ((char*)evclcol(b, 0))[3 * 27] != 'b') return 0;
+    b = evclfree(b);
+
+    return 1;
+}
+
+
+#if EV_STATS
+/* Test 19
+ * - Only built when EV_STATS is set.
+ * - Push 1000 ints into a vector, and delete some of them.
+ * - Test that the push, grow, delete and peak statistics add up.
+ * - Test that the vector is in the registry until it is freed.
+ * - Test that a stack vector left behind by a frame that has returned is not
+ *   in the registry.
+ */
+static void test19_stack()
+{
+    int* s = evinistk(int, 7);
+    evpsh(s, 1);
+    evpsh(s, 2);
+    evpsh(s, 3);
+}
+
+static int test19()
+{
+    evstats_t before;
+    evstats(NULL, &before);
+
+    int* a = evini(sizeof(int), 8);
+    for(int i = 0; i < 1000; i++){
+        evpsh(a,i);
+    }
+    evdel(a,0);
+    evdel(a,998);
+
+    evstats_t st;
+    evstats(a, &st);
+    if(st.pushes != 1000) return 0;
+    if(st.grows != 7) return 0; //8 -> 1024 slots
+    if(st.peak_objs != 1000 || st.peak_slots != 1024) return 0;
+    if(st.del_bytes != 999 * sizeof(int)) return 0;
+
+    evstats_t after;
+    evstats(NULL, &after);
+    if(after.pushes - before.pushes != 1000) return 0;
+
+    test19_stack();
+
+    char name[] = "/tmp/evstatsXXXXXX";
+    int fd = mkstemp(name);
+    unlink(name);
+    evstdump(fd, 1);
+    a = evfree(a);
+    evstdump(fd, 0);
+
+    char buff[64 * 1024] = {0};
+    lseek(fd, 0, SEEK_SET);
+    if(read(fd, buff, sizeof(buff) - 1) <= 0) return 0;
+    close(fd);
+
+    //The vector shows up in the JSON dump, but not in the text dump after free
+    if(!strstr(buff, "\"obj_count\": 998")) return 0;
+    if(strstr(buff, "obj_count: 998")) return 0;
+    if(strstr(buff, "\"obj_count\": 3, \"slt_count\": 7")) return 0;
+
+    return 1;
+}
+#endif
+
+
+#if EV_TRACE
+/* Test 20
+ * - Only built when EV_TRACE is set.
+ * - Make vectors at two different call sites, growing one of them.
+ * - Test that the call site report attributes vectors, bytes and grows to
+ *   the right lines.
+ * - Test that a stack vector left behind by a frame that has returned is not
+ *   reported, and that file names are escaped in the JSON report.
+ */
+static int test20_line;
+static void test20_stack()
+{
+    test20_line = __LINE__ + 1;
+    int* s = evinistk(int, 7);
+    evpsh(s, 1);
+}
+
+static int test20()
+{
+    int* a[4] = {0};
+    const int line_a = __LINE__ + 2;
+    for(int i = 0; i < 4; i++){
+        a[i] = evini(sizeof(int), 8);
+    }
+
+    int* b = NULL;
+    const int line_b = __LINE__ + 2;
+    for(int i = 0; i < 100; i++){
+        evpsh(b, i);
+    }
+
+    int* c = _evtrsite(evini(sizeof(int), 1), "dir\\\"odd\".c", 7);
+    test20_stack();
+
+    char name[] = "/tmp/evtraceXXXXXX";
+    int fd = mkstemp(name);
+    unlink(name);
+    evtrdump(fd, 1);
+
+    char buff[64 * 1024] = {0};
+    lseek(fd, 0, SEEK_SET);
+    if(read(fd, buff, sizeof(buff) - 1) <= 0) return 0;
+    close(fd);
+
+    char expect[256];
+    snprintf(expect, sizeof(expect), "\"line\": %i, \"vectors\": 4, \"live_bytes\": %zu, \"slack_bytes\": %zu, \"grows\": 0",
+             line_a, 4 * (EV_HDR_BYTES + 8 * sizeof(int)), 4 * 8 * sizeof(int));
+    if(!strstr(buff, expect)) return 0;
+
+    snprintf(expect, sizeof(expect), "\"line\": %i, \"vectors\": 1, \"live_bytes\": %zu, \"slack_bytes\": %zu, \"grows\": 4",
+             line_b, EV_HDR_BYTES + 128 * sizeof(int), 28 * sizeof(int));
+    if(!strstr(buff, expect)) return 0;
+
+    if(!strstr(buff, "\"file\": \"dir\\\\\\\"odd\\\".c\", \"line\": 7,")) return 0;
+
+    snprintf(expect, sizeof(expect), "\"line\": %i,", test20_line);
+    if(strstr(buff, expect)) return 0;
+
+    for(int i = 0; i < 4; i++){
+        evfree(a[i]);
+    }
+    evfree(b);
+    evfree(c);
+    return 1;
+}
+#endif
+
+
+/* Test 21
+ * - Push 10000 ints with incremental growth, copying at most 16B per push.
+ * - Test that array notation and evidx() reach every item, and that the
+ *   header never counts more items than the caller's storage holds.
+ * - Test evcpy(), evdel(), evsort() and evsum_i32() on a vector part way
+ *   through growing, and that reading does not copy anything.
+ * - Test that heap pushes and pops keep to the per push limit.
+ * - Test that evincfin() finishes growing, and that evfree() works mid growth.
+ * - Test that a growth step of 1 still leaves room to move 4 items per push.
+ */
+static int test21_moved(void* a)
+{
+    return (int)EV_EXTGET(EV_HDR(a), inc_moved);
+}
+
+static int test21()
+{
+    int* a = evini(sizeof(int), 8);
+    evinc(a, 16);
+
+    int grew = 0;
+    for(int i = 0; i < 10000; i++){
+        const void* before = a;
+        const int moved = test21_moved(a);
+        evpsh(a,i);
+        if(a == before && test21_moved(a) - moved > 4) return 0;
+        if(evcnt(a) > evvsz(a)) return 0;
+        if(a[i] != i || *(int*)evidx(a,i) != i) return 0;
+        if(a[i / 2] != i / 2) return 0;
+        grew |= EV_EXTGET(EV_HDR(a), inc_hdr) != NULL;
+    }
+    if(!grew) return 0;
+
+    //Stop part way through growing
+    while(!EV_EXTGET(EV_HDR(a), inc_hdr) || test21_moved(a) < 8){
+        evpsh(a,(int)evcnt(a));
+    }
+
+    const size_t count = evcnt(a);
+    int* b = evcpy(a);
+    if(evcnt(b) != count) return 0;
+    for(int i = 0; i < count; i++){
+        if(b[i] != i) return 0;
+    }
+    b = evfree(b);
+
+    const int moved = test21_moved(a);
+    if(evsum_i32(a) != (int32_t)((int64_t)count * (count - 1) / 2)) return 0;
+    if(test21_moved(a) != moved) return 0;
+
+    evdel(a,0);
+    if(evcnt(a) != count - 1) return 0;
+    if(a[0] != 1 || *(int*)evidx(a,0) != 1) return 0;
+    if(*(int*)evtail(a) != count - 1) return 0;
+
+    evscale_i32(a, -1);
+    evsort(a,compare);
+    if(!EV_EXTGET(EV_HDR(a), inc_hdr)) return 0;
+    if(a[0] != 1 - (int)count) return 0;
+    evscale_i32(a, -1);
+    evsort(a,compare);
+    evpsh(a,-1);
+    a = evincfin(a);
+    if(EV_EXTGET(EV_HDR(a), inc_hdr)) return 0;
+    for(int i = 0; i < count - 1; i++){
+        if(a[i] != i + 1) return 0;
+    }
+    if(a[count - 1] != -1) return 0;
+    a = evfree(a);
+
+    //Heap pushes and pops copy no more than plain pushes
+    int32_t* h = evini(sizeof(int32_t), 8);
+    evinc(h, 16);
+    for(int i = 0; i < 10000; i++){
+        const void* before = h;
+        const int moved = test21_moved(h);
+        h = evheap_push_i32(h, (int32_t)((i * 7919) % 10007));
+        if(h == before && test21_moved(h) - moved > 4) return 0;
+        if(i % 3 == 0){
+            const int still = test21_moved(h);
+            evheap_pop_i32(h);
+            if(test21_moved(h) != still) return 0;
+        }
+    }
+    h = evincfin(h);
+    int32_t last = INT32_MIN;
+    while(evcnt(h)){
+        const int32_t val = evheap_pop_i32(h);
+        if(val < last) return 0;
+        last = val;
+    }
+    h = evfree(h);
+
+    //Free while still growing
+    int* c = evini(sizeof(int), 1024);
+    evinc(c, 64);
+    for(int i = 0; i < 1000; i++){
+        evpsh(c,i);
+    }
+    if(!EV_EXTGET(EV_HDR(c), inc_hdr)) return 0;
+    c = evfree(c);
+
+    int* d = evini(sizeof(int), 1024);
+    evgrw(d, 1.5, 1, 1, 0);
+    evinc(d, 16);
+    for(int i = 0; i < 1025; i++){
+        evpsh(d,i);
+    }
+    if(evvsz(d) < 1024 + 1024 / 4) return 0;
+    for(int i = 0; i < 1025; i++){
+        if(d[i] != i) return 0;
+    }
+    d = evfree(d);
+
+    return 1;
+}
+
+/* Test 22
+ * - Fill an int32 and a double vector, and check each numeric kernel against
+ *   a plain loop.
+ * - Repeat with a vector big enough to be split over threads.
+ * - Test that evmap() pushes every mapped item, growing only once.
+ * - Test that evargmin() and evargmax() stay in bounds on NaNs.
+ */
+static void twice(void* out, const void* in, void* arg)
+{
+    *(int64_t*)out = *(const int32_t*)in * 2;
+}
+
+static int test22()
+{
+    int32_t* a = evini(sizeof(int32_t), 0);
+    double* d = evini(sizeof(double), 0);
+    for(int i = 0; i < 1001; i++){
+        evpsh(a,(int32_t)((i * 37) % 1001 - 500));
+        evpsh(d,(double)i / 4);
+    }
+
+    if(evsum_i32(a) != 0) return 0;
+    if(evmin_i32(a) != -500 || evmax_i32(a) != 500) return 0;
+    if(a[evargmin_i32(a)] != -500 || a[evargmax_i32(a)] != 500) return 0;
+    if(evsum_f64(d) != 1000.0 * 1001 / 8) return 0;
+    if(evargmax_f64(d) != 1000 || evmin_f64(d) != 0.0) return 0;
+
+    int64_t dot = 0;
+    for(int i = 0; i < 1001; i++){
+        dot += (int64_t)a[i] * a[i];
+    }
+    if(evdot_i32(a,a) != dot) return 0;
+
+    evscale_f64(d,4.0);
+    evadd_f64(d,d);
+    evprefix_f64(d);
+    if(d[1] != 2.0 || d[1000] != 1000.0 * 1001) return 0;
+
+    int64_t* m = evmap(NULL, a, sizeof(int64_t), twice, NULL);
+    m = evmap(m, a, sizeof(int64_t), twice, NULL);
+    if(evvsz(m) != 2002) return 0;
+    if(evcnt(m) != 2002 || m[0] != a[0] * 2 || m[2001] != a[1000] * 2) return 0;
+
+    a = evfree(a);
+    d = evfree(d);
+    m = evfree(m);
+
+    //Big enough to split over threads
+    const size_t big = EV_PAR_CUTOFF * 2 + 3;
+    int64_t* b = evini(sizeof(int64_t), big);
+    for(size_t i = 0; i < big; i++){
+        evpsh(b,(int64_t)1);
+    }
+    b[big - 2] = -1;
+    b[7] = 5;
+    if(evsum_i64(b) != big - 2 + 4) return 0;
+    if(evargmin_i64(b) != big - 2 || evargmax_i64(b) != 7) return 0;
+
+    b[big - 2] = 1;
+    b[7] = 1;
+    evprefix_i64(b);
+    for(size_t i = 0; i < big; i++){
+        if(b[i] != i + 1) return 0;
+    }
+    b = evfree(b);
+
+    double* nan = evini(sizeof(double), 0);
+    for(int i = 0; i < 4; i++){
+        evpsh(nan, (double)NAN);
+    }
+    if(evargmin_f64(nan) > 3 || evargmax_f64(nan) > 3) return 0;
+    nan[2] = -1.0;
+    if(evargmin_f64(nan) > 3) return 0;
+    nan = evfree(nan);
+
+    return 1;
+}
+
+/* Test 23
+ * - Check that there is at least one NUMA node.
+ * - Interleave a vector over every node, and push enough to grow it.
+ * - Check that the placement query finds the pages, and that they are all on
+ *   nodes that are online.
+ * - Bind the vector to node 0 and check that every page is then on node 0.
+ * - Check that a copy is placed on node 0 too, with its spare slots zeroed.
+ */
+static int test23()
+{
+    const int nodes = evnumanodes();
+    if(nodes < 1) return 0;
+
+    int* a = evini(sizeof(int), 1024);
+    if(evnuma(a, EV_NUMA_INTERLEAVE, 0)) return 0;
+    for(int i = 0; i < 1024 * 1024; i++){
+        evpsh(a,i);
+    }
+
+    size_t pages[64] = {0};
+    const int64_t total = evnumaplace(a, pages, 64);
+    if(total < evomem(a) / sysconf(_SC_PAGESIZE) - 1) return 0;
+    size_t on_nodes = 0;
+    for(int n = 0; n < 64; n++){
+        on_nodes += pages[n];
+    }
+    if(on_nodes != total) return 0;
+
+    if(evnuma(a, EV_NUMA_BIND, 0)) return 0;
+    if(evnumaplace(a, pages, 64) != total || pages[0] != total) return 0;
+
+    int* b = evcpy(a);
+    if(!b || evcnt(b) != evcnt(a) || b[12345] != 12345) return 0;
+    if(evvsz(b) > evcnt(b) && b[evcnt(b)] != 0) return 0;
+    const int64_t b_total = evnumaplace(b, pages, 64);
+    if(b_total < 1 || pages[0] != b_total) return 0;
+    b = evfree(b);
+
+    a = evfree(a);
+    return 1;
+}
+
+/* Test 24
+ * - Push 4M ints into a vector that uses huge pages above 4MB.
+ * - Check that the storage is aligned to a huge page, through every growth.
+ * - Check that the huge page count is sane, and that evcpy() works.
+ * - Ask for explicit huge pages, which falls back if none are reserved.
+ * - Grow incrementally into huge pages, and free part way through.
+ */
+static int test24()
+{
+    int* a = evini(sizeof(int), 8);
+    evhuge(a, 4 * 1024 * 1024, 0);
+    for(int i = 0; i < 4 * 1024 * 1024; i++){
+        evpsh(a,i);
+        if(evvmem(a) >= 4 * 1024 * 1024 && (uintptr_t)EV_HDR(a) % EV_HUGE_PAGE) return 0;
+    }
+    for(int i = 0; i < 4 * 1024 * 1024; i++){
+        if(a[i] != i) return 0;
+    }
+
+    const int64_t huge = evhugebytes(a);
+    if(huge < 0 || huge > evvmem(a)) return 0;
+
+    int* b = evcpy(a);
+    if(evcnt(b) != evcnt(a) || b[12345] != 12345) return 0;
+    b = evfree(b);
+    a = evfree(a);
+
+    int* c = evini(sizeof(int), 8);
+    evhuge(c, 1, EV_FLAG_HUGETLB);
+    evinc(c, 4096);
+    for(int i = 0; i < 1024 * 1024 + 1; i++){
+        evpsh(c,i);
+        if(*(int*)evidx(c,i / 3) != i / 3) return 0;
+    }
+    while(!EV_EXTGET(EV_HDR(c), inc_hdr)){
+        evpsh(c,(int)evcnt(c));
+    }
+    c = evfree(c);
+
+    return 1;
+}
+
+/* Test 25
+ * - Make a vector in shared memory, and attach to it read only.
+ * - Push enough to grow the segment, and check that the reader only sees what
+ *   it has mapped until it picks up the new generation.
+ * - Check that a copy of the vector lives on the heap.
+ * - Check that the vector can be read from another process.
+ */
+static int test25()
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/evtest.%i", (int)getpid());
+
+    evsh_t* w = evshini(name, sizeof(int), 16);
+    evsh_t* r = evshopen(name, 0);
+    if(!w || !r) return 0;
+    if(evshgen(r) != 0 || evshcnt(r) != 0) return 0;
+
+    for(int i = 0; i < 16; i++){
+        evshpsh(w,i);
+    }
+    int* a = evshvec(r);
+    if(evshcnt(r) != 16 || evcnt(a) != 16 || a[15] != 15) return 0;
+
+    const size_t slots = evvsz(a);
+    for(int i = 16; i < 100000; i++){
+        evshpsh(w,i);
+    }
+    if(evshgen(r) == 0 || evshcnt(r) != slots) return 0;
+    a = evshvec(r);
+    if(evshcnt(r) != 100000 || a[99999] != 99999) return 0;
+
+    int* b = evcpy(a);
+    if(evcnt(b) != 100000 || b[12345] != 12345) return 0;
+    b = evfree(b);
+
+    pid_t pid = fork();
+    if(pid == 0){
+        evsh_t* c = evshopen(name, 0);
+        int* v = evshvec(c);
+        for(int i = 0; i < 100000; i++){
+            if(v[i] != i) _exit(1);
+        }
+        _exit(evshcnt(c) == 100000 ? 0 : 1);
+    }
+    int status = 0;
+    if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status)) return 0;
+
+    r = evshfree(r);
+    w = evshfree(w);
+    if(evshunlink(name)) return 0;
+
+    return 1;
+}
+
+/* Test 26
+ * - Push 1M ints into an epoch vector while 4 threads read snapshots of it.
+ * - Check that every snapshot is complete, and that counts never go back.
+ * - Check that all the replaced storage is freed once the readers are done.
+ * - Check that each reader has a cache line to itself.
+ */
+typedef struct {
+    evrc_t* rc;
+    int* done;
+    int ok;
+} test26_t;
+
+static void* test26_reader(void* arg)
+{
+    test26_t* t = arg;
+    const int reader = evrcreg(t->rc);
+    size_t last = 0;
+    t->ok = reader >= 0;
+    while(t->ok && !__atomic_load_n(t->done, __ATOMIC_ACQUIRE)){
+        size_t count = 0;
+        int* v = evrcenter(t->rc, reader, &count);
+        if(count < last) t->ok = 0;
+        for(size_t i = last; i < count; i++){
+            if(v[i] != (int)i) t->ok = 0;
+        }
+        last = count;
+        evrcexit(t->rc, reader);
+    }
+    evrcunreg(t->rc, reader);
+    return NULL;
+}
+
+static int test26()
+{
+    evrc_t* rc = evrcini(sizeof(int), 0);
+    if((uintptr_t)&rc->readers[0] % 64 || (uintptr_t)&rc->readers[1] % 64) return 0;
+    int done = 0;
+    test26_t t[4];
+    pthread_t threads[4];
+    for(int i = 0; i < 4; i++){
+        t[i] = (test26_t){ rc, &done, 0 };
+        pthread_create(&threads[i], NULL, test26_reader, &t[i]);
+    }
+
+    for(int i = 0; i < 1024 * 1024; i++){
+        evrcpsh(rc,i);
+    }
+    int* a = rc->vec;
+    if(evcnt(a) != 1024 * 1024) return 0;
+
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    for(int i = 0; i < 4; i++){
+        pthread_join(threads[i], NULL);
+        if(!t[i].ok) return 0;
+    }
+
+    if(evrcsync(rc) != 0) return 0;
+    rc = evrcfree(rc);
+
+    return 1;
+}
+
+/* Test 27
+ * - Push 100k bits, every third one set, and check get and popcount.
+ * - Visit every set bit with find first set.
+ * - Set and clear bits, and combine two bit vectors with and, or and xor.
+ * - Check that the bits take one word per 64.
+ */
+static int test27()
+{
+    uint64_t* a = NULL;
+    uint64_t* b = evbitsini(100000);
+    for(int i = 0; i < 100000; i++){
+        a = evbitspush(a, i % 3 == 0);
+        b = evbitspush(b, i % 2 == 0);
+    }
+    if(evbitscnt(a) != 100000 || evcnt(a) != (100000 + 63) / 64) return 0;
+    if(evbitsget(a, 3) != 1 || evbitsget(a, 4) != 0) return 0;
+    if(evbitspopcnt(a) != 33334) return 0;
+
+    int64_t seen = 0;
+    for(int64_t i = evbitsffs(a, 0); i >= 0; i = evbitsffs(a, i + 1)){
+        if(i % 3) return 0;
+        seen++;
+    }
+    if(seen != 33334) return 0;
+
+    evbitsclr(a, 99999);
+    evbitsset(a, 99998);
+    if(evbitsget(a, 99999) != 0 || evbitsget(a, 99998) != 1) return 0;
+    if(evbitsffs(a, 99997) != 99998 || evbitsffs(a, 99999) != -1) return 0;
+    evbitsclr(a, 99998);
+    evbitsset(a, 99999);
+
+    uint64_t* c = evcpy(a);
+    evbitsand(c, b); //Multiples of 6
+    if(evbitspopcnt(c) != 16667) return 0;
+    evbitsor(c, b);  //Multiples of 2
+    if(evbitspopcnt(c) != 50000) return 0;
+    evbitsxor(c, a); //Multiples of 2 or 3, but not 6
+    if(evbitspopcnt(c) != 50000 + 33334 - 2 * 16667) return 0;
+
+    a = evfree(a);
+    b = evfree(b);
+    c = evfree(c);
+    return 1;
+}
+
+/* Test 28
+ * - Push 100k sorted IDs with small gaps into a packed integer vector, and
+ *   check that it takes less than a quarter of the memory of a plain vector.
+ * - Check random access and decoding runs that start part way into a block.
+ * - Push values that need all 64 bits, and a constant stride that needs none.
+ */
+static int test28()
+{
+    const size_t n = 100000;
+    int64_t* plain = evini(sizeof(int64_t), n);
+    evpk_t* pk = evpkini();
+    int64_t id = 1000000;
+    srand(28);
+    for(size_t i = 0; i < n; i++){
+        id += rand() % 200;
+        evpsh(plain,id);
+        if(evpkpush(pk, id)) return 0;
+    }
+    if(evpkcnt(pk) != n) return 0;
+    if(evpkmem(pk) * 4 > n * sizeof(int64_t)) return 0;
+
+    for(size_t i = 0; i < n; i += 997){
+        if(evpkget(pk, i) != plain[i]) return 0;
+    }
+    if(evpkget(pk, n - 1) != plain[n - 1]) return 0;
+
+    int64_t* out = malloc(n * sizeof(int64_t));
+    if(evpkdecode(pk, 0, out, n) != n) return 0;
+    if(memcmp(out, plain, n * sizeof(int64_t))) return 0;
+    if(evpkdecode(pk, 1000, out, 300) != 300 || out[0] != plain[1000] || out[299] != plain[1299]) return 0;
+    if(evpkdecode(pk, n - 10, out, 300) != 10 || out[9] != plain[n - 1]) return 0;
+    pk = evpkfree(pk);
+
+    pk = evpkini();
+    const int64_t wide[] = { INT64_MIN, INT64_MAX, 0, -1, 1, INT64_MAX, INT64_MIN };
+    for(size_t i = 0; i < 1000; i++){
+        evpkpush(pk, wide[i % 7]);
+    }
+    if(evpkdecode(pk, 0, out, 1000) != 1000) return 0;
+    for(size_t i = 0; i < 1000; i++){
+        if(evpkget(pk, i) != wide[i % 7] || out[i] != wide[i % 7]) return 0;
+    }
+    pk = evpkfree(pk);
+
+    pk = evpkini();
+    for(size_t i = 0; i < 1000; i++){
+        evpkpush(pk, 7 * i - 300);
+    }
+    if(evcnt(pk->words) != 0) return 0;
+    if(evpkdecode(pk, 0, out, 1000) != 1000 || out[999] != 7 * 999 - 300) return 0;
+    pk = evpkfree(pk);
+
+    free(out);
+    plain = evfree(plain);
+    return 1;
+}
+
+/*
+ * Test 29
+ * - Push random ints onto generic and typed heaps, with 2 and 4 children per
+ *   item, and check that they pop in sorted order.
+ * - Test that evheapify() and evheapify_i64() work on unordered vectors.
+ */
+static int test29()
+{
+    const int n = 5000;
+    for(int arity = 2; arity <= 4; arity += 2){
+        int* a = evini(sizeof(int), 0);
+        int64_t* b = evini(sizeof(int64_t), 0);
+        evheap_arity(a, arity);
+        evheap_arity(b, arity);
+        srand(29);
+        for(int i = 0; i < n; i++){
+            int val = rand() % 1000;
+            a = evheap_push(a, &val, sizeof(val), compare);
+            b = evheap_push_i64(b, val);
+        }
+        if(evcnt(a) != n || evcnt(b) != n) return 0;
+
+        int last = -1;
+        for(int i = 0; i < n; i++){
+            const int top = *(int*)evheap_top(a);
+            int val;
+            evheap_pop(a, &val, compare);
+            if(val != top || val < last) return 0;
+            if(evheap_pop_i64(b) != val) return 0;
+            last = val;
+        }
+        if(evheap_top(a) != NULL || evcnt(b) != 0) return 0;
+        a = evfree(a);
+
+        //Heapify then pop
+        double* c = evini(sizeof(double), 0);
+        evheap_arity(c, arity);
+        for(int i = 0; i < n; i++){
+            evpsh(b, (int64_t)(rand() % 1000));
+            evpsh(c, (double)(n - i));
+        }
+        evheapify_i64(b);
+        evheapify_f64(c);
+        int64_t prev = INT64_MIN;
+        for(int i = 0; i < n; i++){
+            const int64_t val = evheap_pop_i64(b);
+            if(val < prev) return 0;
+            prev = val;
+            if(evheap_pop_f64(c) != i + 1) return 0;
+        }
+        b = evfree(b);
+        c = evfree(c);
+    }
+
+    return 1;
+}
+
+
+/*
+ * Test 30
+ * - Make sorted sets of ints of similar and very different sizes, and check
+ *   evmerge(), evunion(), evinter() and evdiff() and their typed versions
+ *   against a simple count of which items are in each set.
+ * - Test that the results are pushed after the items already in dst.
+ * - Test that evmerge() puts equal items of a before those of b, both when the
+ *   sizes are similar and when one side is searched.
+ */
+typedef struct { int key; int from_b; } test30_t;
+
+static int test30_compare(const void* x, const void* y)
+{
+    return compare(&((const test30_t*)x)->key, &((const test30_t*)y)->key);
+}
+
+static int test30_stable()
+{
+    const int sizes[][2] = { {400, 400}, {4, 2000}, {2000, 4} };
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+        test30_t* a = evini(sizeof(test30_t), 0);
+        test30_t* b = evini(sizeof(test30_t), 0);
+        for(int i = 0; i < sizes[s][0]; i++){
+            test30_t item = { i * 8 / sizes[s][0], 0 };
+            a = evpush(a, &item, sizeof(item));
+        }
+        for(int i = 0; i < sizes[s][1]; i++){
+            test30_t item = { i * 8 / sizes[s][1], 1 };
+            b = evpush(b, &item, sizeof(item));
+        }
+
+        test30_t* m = evmerge(NULL, a, b, test30_compare);
+        if(evcnt(m) != evcnt(a) + evcnt(b)) return 0;
+        for(size_t i = 1; i < evcnt(m); i++){
+            if(m[i].key < m[i - 1].key) return 0;
+            if(m[i].key == m[i - 1].key && m[i].from_b < m[i - 1].from_b) return 0;
+        }
+        m = evfree(m);
+        a = evfree(a);
+        b = evfree(b);
+
+        //The typed versions, with -0.0 in a and 0.0 in b
+        double* x = NULL;
+        double* y = NULL;
+        for(int i = 0; i < sizes[s][0]; i++){
+            evpsh(x, -0.0);
+        }
+        for(int i = 0; i < sizes[s][1]; i++){
+            evpsh(y, 0.0);
+        }
+        double* z = evmerge_f64(NULL, x, y);
+        if(evcnt(z) != evcnt(x) + evcnt(y)) return 0;
+        for(size_t i = 0; i < evcnt(z); i++){
+            if(!signbit(z[i]) != (i >= evcnt(x))) return 0;
+        }
+        z = evfree(z);
+        x = evfree(x);
+        y = evfree(y);
+    }
+    return 1;
+}
+
+static int test30()
+{
+    const int range = 20000;
+    const int sizes[][2] = { {0, 100}, {3000, 5000}, {100, 9000}, {9000, 50}, {5, 0} };
+    char* in_a = calloc(range, 1);
+    char* in_b = calloc(range, 1);
+
+    srand(30);
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+        memset(in_a, 0, range);
+        memset(in_b, 0, range);
+        int* a = evini(sizeof(int), 0);
+        int* b = evini(sizeof(int), 0);
+        for(int i = 0; i < sizes[s][0]; i++){
+            in_a[rand() % range] = 1;
+        }
+        for(int i = 0; i < sizes[s][1]; i++){
+            in_b[rand() % range] = 1;
+        }
+        for(int i = 0; i < range; i++){
+            if(in_a[i]) evpsh(a, i);
+            if(in_b[i]) evpsh(b, i);
+        }
+
+        for(int op = 0; op < 4; op++){
+            int* dst = evini(sizeof(int), 0);
+            evpsh(dst, -1);
+            int* typed = NULL;
+            switch(op){
+            case 0: dst = evmerge(dst, a, b, compare); typed = evmerge_i32(NULL, a, b); break;
+            case 1: dst = evunion(dst, a, b, compare); typed = evunion_i32(NULL, a, b); break;
+            case 2: dst = evinter(dst, a, b, compare); typed = evinter_i32(NULL, a, b); break;
+            case 3: dst = evdiff(dst, a, b, compare);  typed = evdiff_i32(NULL, a, b);  break;
+            }
+
+            size_t n = 1;
+            if(dst[0] != -1) return 0;
+            for(int i = 0; i < range; i++){
+                const int times = op == 0 ? in_a[i] + in_b[i] :
+                                  op == 1 ? (in_a[i] | in_b[i]) :
+                                  op == 2 ? (in_a[i] & in_b[i]) :
+                                  (in_a[i] & !in_b[i]);
+                for(int t = 0; t < times; t++, n++){
+                    if(n >= evcnt(dst) || dst[n] != i) return 0;
+                }
+            }
+            if(evcnt(dst) != n) return 0;
+            if(!typed || evcnt(typed) != n - 1) return 0;
+            if(memcmp(typed, dst + 1, (n - 1) * sizeof(int))) return 0;
+            dst = evfree(dst);
+            typed = evfree(typed);
+        }
+        a = evfree(a);
+        b = evfree(b);
+    }
+    free(in_a);
+    free(in_b);
+
+    //Typed versions of the other types
+    double* x = NULL;
+    double* y = NULL;
+    for(int i = 0; i < 100; i++){
+        evpsh(x, i * 0.5);
+        evpsh(y, i * 0.25);
+    }
+    double* u = evunion_f64(NULL, x, y);
+    if(evcnt(u) != 150 || u[149] != 49.5) return 0;
+    u = evfree(u);
+    u = evinter_f64(NULL, x, y);
+    if(evcnt(u) != 50 || u[49] != 24.5) return 0;
+    u = evfree(u);
+    x = evfree(x);
+    y = evfree(y);
+
+    return test30_stable();
+}
+
+
+/*
+ * Test 31
+ * - Gather a vector through a random permutation, scatter it back through the
+ *   same permutation, and check that it comes back the same.
+ * - Test an odd slot size, and that gather pushes after the items in dst.
+ */
+static int test31()
+{
+    const size_t n = 10000;
+    int64_t* a = evini(sizeof(int64_t), n);
+    size_t* perm = malloc(n * sizeof(size_t));
+    for(size_t i = 0; i < n; i++){
+        evpsh(a, (int64_t)i * 3);
+        perm[i] = i;
+    }
+    srand(31);
+    for(size_t i = n - 1; i > 0; i--){
+        const size_t j = rand() % (i + 1);
+        const size_t t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+    }
+
+    int64_t* g = evgather(NULL, a, perm, n);
+    if(evcnt(g) != n) return 0;
+    for(size_t i = 0; i < n; i++){
+        if(g[i] != (int64_t)perm[i] * 3) return 0;
+    }
+
+    int64_t* b = evini(sizeof(int64_t), n);
+    for(size_t i = 0; i < n; i++){
+        evpsh(b, (int64_t)-1);
+    }
+    if(evscatter(b, perm, g, n)) return 0;
+    if(memcmp(a, b, n * sizeof(int64_t))) return 0;
+
+    //Odd slot size, gathered onto the end of a vector
+    typedef struct { char c[7]; } odd_t;
+    odd_t* o = NULL;
+    for(int i = 0; i < 100; i++){
+        odd_t x;
+        memset(&x, i, sizeof(x));
+        evpsh(o, x);
+    }
+    const size_t idx[] = { 99, 0, 50, 50 };
+    odd_t* og = evini(sizeof(odd_t), 0);
+    odd_t first = { {1} };
+    evpsh(og, first);
+    og = evgather(og, o, idx, 4);
+    if(evcnt(og) != 5 || og[0].c[0] != 1) return 0;
+    if(og[1].c[6] != 99 || og[2].c[0] != 0 || og[3].c[3] != 50 || og[4].c[0] != 50) return 0;
+
+    free(perm);
+    evfree(a);
+    evfree(b);
+    evfree(g);
+    evfree(o);
+    evfree(og);
+    return 1;
+}
+
+
+/*
+ * Test 32
+ * - Test that evlayout() finds the full header of a normal vector.
+ * - Test that it spots a compact header, as made by an EV_COMPACT build.
+ * - Test that the full header is the same size whatever options are built in.
+ */
+static int test32()
+{
+    if(EV_HDR_BYTES != 64) return 0;
+
+    int* a = NULL;
+    evpsh(a, 1);
+    if(evlayout(a) != EV_LAYOUT_FULL) return 0;
+    a = evfree(a);
+
+    //A compact header is 16 bytes, with its magic next to the first slot
+    align buf[4] = {{0}};
+    const uint16_t magic = EV_MAGIC_COMPACT;
+    memcpy((char*)buf + 16 - sizeof(magic), &magic, sizeof(magic));
+    if(evlayout((char*)buf + 16) != EV_LAYOUT_COMPACT) return 0;
+
+    return 1;
+}
+
+
+/*
+ * Test 33
+ * - Turn on the block cache, and check that freed blocks are handed back out
+ *   to new vectors and to vectors that grow.
+ * - Test the limits, the counters, and that evcache_flush() empties it.
+ * - Check that the block of a vector with a NUMA policy is not cached.
+ */
+static void* test33_thread(void* arg)
+{
+    (void)arg;
+    evcache_limits(4, 1 << 20);
+    int* a = NULL;
+    for(int i = 0; i < 100; i++){
+        evpsh(a, i);
+    }
+    evfree(a); //Left in the cache, to be flushed as the thread exits
+    return NULL;
+}
+
+static int test33()
+{
+    evcache_stats_t st;
+    evcache_limits(2, 1 << 20);
+
+    //Blocks are rounded up to their size class, and the vector gets the rest
+    int* a = evini(sizeof(int), 10);
+    const size_t bytes = EV_HDR_BYTES + 10 * sizeof(int);
+    size_t class_bytes = 1;
+    while(class_bytes < bytes){
+        class_bytes *= 2;
+    }
+    if(evvsz(a) != (class_bytes - EV_HDR_BYTES) / sizeof(int)) return 0;
+
+    //Free then make the same shape again
+    void* first = EV_HDR(a);
+    evfree(a);
+    a = evini(sizeof(int), 10);
+    if(EV_HDR(a) != first) return 0;
+    evcache_stats(&st);
+    if(st.hits != 1 || st.misses != 1 || st.puts != 1 || st.blocks != 0) return 0;
+
+    //Growing swaps blocks with the cache
+    int* b = evini(sizeof(int), evvsz(a) * 2);
+    void* bigger = EV_HDR(b);
+    evfree(b);
+    const size_t slots = evvsz(a);
+    for(size_t i = 0; i <= slots; i++){
+        evpsh(a, (int)i);
+    }
+    if(EV_HDR(a) != bigger || a[7] != 7) return 0;
+    evcache_stats(&st);
+    if(st.hits != 2 || st.blocks != 1 || st.bytes != class_bytes) return 0;
+
+    //At most 2 blocks in each class
+    void* v[4];
+    for(int i = 0; i < 4; i++){
+        v[i] = evini(sizeof(int), 10);
+    }
+    for(int i = 0; i < 4; i++){
+        evfree(v[i]);
+    }
+    evcache_stats(&st);
+    if(st.blocks != 2 || st.drops != 2) return 0;
+
+    if(evcache_flush() != 2 * class_bytes) return 0;
+    evcache_stats(&st);
+    if(st.blocks != 0 || st.bytes != 0) return 0;
+
+    int* c = evini(sizeof(int), 10);
+    if(evnuma(c, EV_NUMA_BIND, 0)) return 0;
+    evfree(c);
+    evcache_stats(&st);
+    if(st.blocks != 0) return 0;
+
+    pthread_t t;
+    pthread_create(&t, NULL, test33_thread, NULL);
+    pthread_join(t, NULL);
+
+    evfree(a);
+    evcache_limits(0, 0);
+    evcache_stats(&st);
+    if(st.blocks != 0) return 0;
+    return 1;
+}
+
+
+/*
+ * Test 34
+ * - Adopt a heap buffer with evadopt(), and check the items were not copied.
+ * - Push past the end of the buffer so that it grows.
+ * - Release the items with evrelease() and free() them directly.
+ */
+static int test34()
+{
+    char* buf = malloc(EV_BUF_BYTES(sizeof(int), 16));
+    int* items = EV_ADOPT_ITEMS(buf);
+    for(int i = 0; i < 10; i++){
+        items[i] = i;
+    }
+
+    int* a = evadopt(buf, sizeof(int), 10, 16);
+    if(a != items || evcnt(a) != 10 || evvsz(a) != 16) return 0;
+    for(int i = 10; i < 100; i++){
+        evpsh(a, i);
+    }
+    if(evcnt(a) != 100) return 0;
+
+    const size_t count = evcnt(a);
+    int* out = evrelease(a);
+    for(size_t i = 0; i < count; i++){
+        if(out[i] != (int)i) return 0;
+    }
+    free(out);
+
+    //Vectors in caller storage are copied out
+    int* b = evinistk(int, 8);
+    evpsh(b, 7);
+    out = evrelease(b);
+    if(out == b || out[0] != 7) return 0;
+    free(out);
+    return 1;
+}
+
+
+/*
+ * Test 35
+ * - Test evnth() and evnth_i32() against a sorted copy, with many duplicates.
+ * - Test that evpartial_sort() and evpartial_sort_f64() sort the first k.
+ * - Offer random values to top k accumulators and check they keep the first k.
+ */
+static int test35()
+{
+    const int n = 5000;
+    const size_t k = 100;
+    int* a = NULL;
+    srand(35);
+    for(int i = 0; i < n; i++){
+        evpsh(a, rand() % 1000);
+    }
+    int* sorted = evcpy(a);
+    evsort(sorted, compare);
+
+    const size_t idx[] = { 0, 1, k, n / 2, n - 1 };
+    for(size_t i = 0; i < sizeof(idx) / sizeof(idx[0]); i++){
+        int* b = evcpy(a);
+        int32_t* c = evcpy(a);
+        evnth(b, idx[i], compare);
+        evnth_i32(c, idx[i]);
+        if(b[idx[i]] != sorted[idx[i]] || c[idx[i]] != sorted[idx[i]]) return 0;
+        for(size_t j = 0; j < (size_t)n; j++){
+            if(j < idx[i] && (b[j] > b[idx[i]] || c[j] > c[idx[i]])) return 0;
+            if(j > idx[i] && (b[j] < b[idx[i]] || c[j] < c[idx[i]])) return 0;
+        }
+        evfree(b);
+        evfree(c);
+    }
+
+    double* d = NULL;
+    int* topk = NULL;
+    int64_t* topk64 = NULL;
+    for(int i = 0; i < n; i++){
+        evpsh(d, (double)a[i]);
+        topk = evtopk_push(topk, &a[i], sizeof(int), k, compare);
+        topk64 = evtopk_push_i64(topk64, a[i], k);
+    }
+    evpartial_sort(a, k, compare);
+    evpartial_sort_f64(d, k);
+    if(evcnt(topk) != k || evcnt(topk64) != k) return 0;
+    evtopk_sort(topk, compare);
+    evtopk_sort_i64(topk64);
+    for(size_t i = 0; i < k; i++){
+        if(a[i] != sorted[i] || d[i] != sorted[i]) return 0;
+        if(topk[i] != sorted[i] || topk64[i] != sorted[i]) return 0;
+    }
+
+    //Asking for more than there is sorts everything
+    evpartial_sort_f64(d, n + 1);
+    for(int i = 0; i < n; i++){
+        if(d[i] != sorted[i]) return 0;
+    }
+
+    evfree(a);
+    evfree(d);
+    evfree(topk);
+    evfree(topk64);
+    evfree(sorted);
+    return 1;
+}
+
+
 typedef int (*test_fn)();
 typedef struct {
     char* name;
@@ -389,6 +1843,33 @@ Test tests[] = {
     {"evpsh pop",       test10},
     {"evpsh copy",      test11},
     {"evpsh zero first each",      test12},
+    {"evinistk",        test13},
+    {"evsgpsh",         test14},
+    {"evgrw",           test15},
+    {"evini_aligned",   test16},
+    {"evvrpsh",         test17},
+    {"evclpsh",         test18},
+#if EV_STATS
+    {"evstats",         test19},
+#endif
+#if EV_TRACE
+    {"evtrdump",        test20},
+#endif
+    {"evinc",           test21},
+    {"evsum",           test22},
+    {"evnuma",          test23},
+    {"evhuge",          test24},
+    {"evshm",           test25},
+    {"evrcpsh",         test26},
+    {"evbitspush",      test27},
+    {"evpkpush",        test28},
+    {"evheap",          test29},
+    {"evset",           test30},
+    {"evgather",        test31},
+    {"evlayout",        test32},
+    {"evcache",         test33},
+    {"evadopt",         test34},
+    {"evselect",        test35},
     {0}
 };
 
@@ -0,0 +1,122 @@
+/*
+ * Tests for compact headers (EV_COMPACT). These have no room for the features
+ * that keep state in the header, so they cannot be run from test.c, which is
+ * built with EV_FALL.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EV_COMPACT 1
+#define EV_HARD_EXIT 0
+#define EV_FPOP
+#define EV_FDEL
+#define EV_FMEMSZ
+#define EV_FSORT
+#define EV_FCOPY
+#define EV_FBUF
+#define EV_FHEAP
+#include "evec.h"
+
+static int compare(const void* lhs, const void* rhs)
+{
+    int* a = (int*)lhs;
+    int* b = (int*)rhs;
+    return *a - *b;
+}
+
+/* Test 1
+ * - Test that the header is 16 bytes, and that the vector says it is compact.
+ * - Push, sort, delete, pop, copy and iterate with eveach().
+ */
+static int test1()
+{
+    if(EV_HDR_BYTES != 16) return 0;
+
+    int* a = NULL;
+    for(int i = 0; i < 1000; i++){
+        evpsh(a, 999 - i);
+    }
+    if(evlayout(a) != EV_LAYOUT_COMPACT) return 0;
+    if(evcnt(a) != 1000 || evtmem(a) != EV_HDR_BYTES + evvmem(a)) return 0;
+
+    evsort(a, compare);
+    evdel(a, 0);
+    evpop(a);
+    if(evcnt(a) != 998 || a[0] != 1 || *(int*)evtail(a) != 998) return 0;
+
+    int* b = evcpy(a);
+    int sum = 0, n = 0;
+    eveach(b, bi){
+        sum += *bi;
+        n++;
+    }
+    if(n != 998 || sum != 998 * 999 / 2) return 0;
+
+    int* c = evinistk(int, 4);
+    if(evlayout(c) != EV_LAYOUT_COMPACT || evvsz(c) != 4) return 0;
+    for(int i = 0; i < 8; i++){
+        c = evheap_push(c, &i, sizeof(i), compare);
+    }
+    if(*(int*)evheap_top(c) != 0) return 0;
+
+    evfree(a);
+    evfree(b);
+    evfree(c);
+    return 1;
+}
+
+/* Test 2
+ * - Make a million tiny vectors, and check the memory they use.
+ * - Test that vectors over EV_COMPACT_MAX bytes are refused.
+ */
+static int test2()
+{
+    const size_t n = 1000000;
+    int64_t** vecs = malloc(n * sizeof(int64_t*));
+    size_t bytes = 0;
+    for(size_t i = 0; i < n; i++){
+        vecs[i] = evini(sizeof(int64_t), 2);
+        evpsh(vecs[i], (int64_t)i);
+        evpsh(vecs[i], (int64_t)i + 1);
+        bytes += evtmem(vecs[i]);
+    }
+    if(bytes != n * (16 + 2 * sizeof(int64_t))) return 0;
+    for(size_t i = 0; i < n; i++){
+        if(vecs[i][1] != (int64_t)i + 1) return 0;
+        evfree(vecs[i]);
+    }
+    free(vecs);
+
+    if(evini(1024, EV_COMPACT_MAX / 1024 + 1) != NULL) return 0;
+    return 1;
+}
+
+
+typedef int (*test_fn)();
+typedef struct {
+    const char* name;
+    test_fn run;
+} Test;
+
+
+Test tests[] = {
+    {"compact evpsh",   test1},
+    {"compact tiny",    test2},
+    {0}
+};
+
+
+int main(void)
+{
+
+    for(int i = 0; tests[i].name != 0; i++){
+        printf("Running test %i: %s ...", i+1, tests[i].name);
+        int result = tests[i].run();
+        printf("%s\n", result ? "Success" : "Fail");
+        if(!result){
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * Tests for the C++ wrapper, ev::vector<T>. The EV implementation itself is
+ * compiled separately, as C (see the Makefile).
+ */
+#include <cstdio>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+#define EV_FALL
+#include "evec.hpp"
+
+/* Test 1
+ * - Push, index and iterate over a vector of ints.
+ * - Test that it works with <algorithm>.
+ * - Test that the storage is a normal EV vector.
+ */
+static int test1()
+{
+    ev::vector<int> a;
+    static_assert(ev::vector<int>::slot_size == sizeof(int), "slot size");
+    for(int i = 0; i < 100; i++){
+        a.push_back(99 - i);
+    }
+    if(a.size() != 100 || a[0] != 99 || a.back() != 0) return 0;
+
+    std::sort(a.begin(), a.end());
+    if(!std::is_sorted(a.begin(), a.end())) return 0;
+    if(std::accumulate(a.begin(), a.end(), 0) != 4950) return 0;
+    if(a.end() - a.begin() != 100) return 0;
+
+    if(evcnt(a.c_vec()) != 100) return 0;
+    if(*(int*)evidx(a.c_vec(), 42) != 42) return 0;
+
+    a.erase(a.begin());
+    if(a.size() != 99 || a.front() != 1) return 0;
+
+    try{
+        a.at(99);
+        return 0;
+    }
+    catch(const std::out_of_range&){
+    }
+
+    return 1;
+}
+
+/* Test 2
+ * - Hand vectors across the C/C++ boundary both ways, without copying.
+ */
+static int test2()
+{
+    int* c = (int*)evini(sizeof(int), 0);
+    for(int i = 0; i < 10; i++){
+        evpsh(c, i);
+    }
+
+    ev::vector<int> a = ev::vector<int>::adopt(c);
+    if(a.data() != c || a.size() != 10 || a[9] != 9) return 0;
+    a.push_back(10);
+
+    int* back = a.release();
+    if(!a.empty() || evcnt(back) != 11 || back[10] != 10) return 0;
+    evfree(back);
+
+    return 1;
+}
+
+/* Test 3
+ * - Store types that are not trivially copyable, and move only types.
+ * - Test that copy and move construction and assignment work.
+ */
+static int test3()
+{
+    ev::vector<std::string> s;
+    for(int i = 0; i < 100; i++){
+        s.emplace_back(50, 'a' + i % 26);
+    }
+    s.push_back(s[0]); //Refers to an item that moves when the vector grows
+    if(s.size() != 101 || s[100] != s[0] || s[25] != std::string(50, 'z')) return 0;
+
+    ev::vector<std::string> t = s;
+    ev::vector<std::string> u = std::move(s);
+    if(!s.empty() || t.size() != 101 || u[1] != t[1]) return 0;
+    s = u;
+    if(s.size() != 101) return 0;
+
+    ev::vector<std::unique_ptr<int>> p;
+    for(int i = 0; i < 20; i++){
+        p.emplace_back(new int(i));
+    }
+    p.pop_back();
+    if(p.size() != 19 || *p[18] != 18) return 0;
+
+    ev::vector<int> r = { 3, 1, 2 };
+    r.resize(5);
+    if(r.size() != 5 || r[0] != 3 || r[4] != 0) return 0;
+
+    return 1;
+}
+
+/* Test 4
+ * - Set policies on a vector of strings, and check that they survive the
+ *   vector growing into new storage.
+ * - Test that growth follows a policy with a limit and a step.
+ */
+static int test4()
+{
+    ev::vector<std::string> s;
+    s.reserve(8);
+    evgrw(s.c_vec(), 1.5, 0, 0, 0);
+    evinc(s.c_vec(), 4096);
+    evheap_arity(s.c_vec(), 4);
+    for(int i = 0; i < 9; i++){
+        s.emplace_back(20, 'a' + i);
+    }
+
+    const evhd_t* hdr = EV_HDR(s.c_vec());
+    if(s.capacity() != 12 || s[8] != std::string(20, 'i')) return 0;
+    if(EV_EXTGET(hdr, grw_factor) != 1.5 || EV_EXTGET(hdr, inc_bytes) != 4096) return 0;
+    if(!(hdr->flags & EV_FLAG_HEAP4)) return 0;
+
+    //8 -> 12 -> 18 by the factor, then past the limit of 16 by steps of 4
+    ev::vector<std::string> t;
+    t.reserve(8);
+    evgrw(t.c_vec(), 1.5, 16, 4, 0);
+    for(int i = 0; i < 19; i++){
+        t.emplace_back(20, 'a' + i);
+        if(i == 12 && t.capacity() != 18) return 0;
+    }
+    if(t.capacity() != 22 || t[18] != std::string(20, 'a' + 18)) return 0;
+
+    return 1;
+}
+
+/* Test 5
+ * - Throw from a copy while the vector grows, and check that the vector is
+ *   left as it was, with every item destroyed exactly once.
+ */
+struct Fragile {
+    static int live;
+    static int copies_left;
+    int val;
+
+    Fragile(int v) : val(v) { live++; }
+    Fragile(const Fragile& other) : val(other.val)
+    {
+        if(!copies_left--){
+            throw std::runtime_error("copy failed");
+        }
+        live++;
+    }
+    //Not noexcept, so growing copies rather than moves
+    Fragile(Fragile&& other) : val(other.val) { live++; }
+    ~Fragile() { live--; }
+};
+int Fragile::live = 0;
+int Fragile::copies_left = 0;
+
+static int test5()
+{
+    {
+        ev::vector<Fragile> f;
+        f.reserve(8);
+        for(int i = 0; i < 8; i++){
+            f.emplace_back(i);
+        }
+
+        Fragile::copies_left = 3;
+        try{
+            f.emplace_back(8);
+            return 0;
+        }
+        catch(const std::runtime_error&){
+        }
+        if(f.size() != 8 || f.capacity() != 8 || Fragile::live != 8) return 0;
+        for(int i = 0; i < 8; i++){
+            if(f[i].val != i) return 0;
+        }
+
+        Fragile::copies_left = 1000;
+        f.emplace_back(8);
+        if(f.size() != 9 || f[8].val != 8 || f[0].val != 0 || Fragile::live != 9) return 0;
+    }
+
+    return Fragile::live == 0;
+}
+
+
+typedef int (*test_fn)();
+typedef struct {
+    const char* name;
+    test_fn run;
+} Test;
+
+
+Test tests[] = {
+    {"vector int",      test1},
+    {"adopt release",   test2},
+    {"vector string",   test3},
+    {"policy",          test4},
+    {"regrow throws",   test5},
+    {0}
+};
+
+
+int main(void)
+{
+
+    for(int i = 0; tests[i].name != 0; i++){
+        printf("Running test %i: %s ...", i+1, tests[i].name);
+        int result = tests[i].run();
+        printf("%s\n", result ? "Success" : "Fail");
+        if(!result){
+            return -1;
+        }
+    }
+
+    return 0;
+}